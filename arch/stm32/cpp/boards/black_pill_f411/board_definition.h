@@ -41,4 +41,10 @@ extern uint8_t boardButtons_count;
 extern BoardButton boardButtons[1];
 
 
+// --- PIN TYPES ---
+
+// Compile-time pin types for the LEDs and buttons above (see gpio_pin.h).
+typedef Pin<GPIO_PORT_C, 13> BoardLEDPin0;
+typedef Pin<GPIO_PORT_A, 0> BoardButtonPin0;
+
 #endif
@@ -44,4 +44,10 @@ extern BoardLED boardLEDs[];
 extern uint8_t boardButtons_count;
 extern BoardButton boardButtons[];
 
+
+// --- PIN TYPES ---
+
+// Compile-time pin types for the LEDs and buttons above (see gpio_pin.h).
+typedef Pin<GPIO_PORT_C, 13> BoardLEDPin0;
+
 #endif
@@ -9,6 +9,7 @@
 #define BOARD_TYPES_H
 
 #include <gpio.h>
+#include <gpio_pin.h>
 
 #include <cstdint>
 
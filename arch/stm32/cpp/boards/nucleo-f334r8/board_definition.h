@@ -44,4 +44,11 @@ extern BoardLED boardLEDs[1];
 extern uint8_t boardButtons_count;
 extern BoardButton boardButtons[1];
 
+
+// --- PIN TYPES ---
+
+// Compile-time pin types for the LEDs and buttons above (see gpio_pin.h).
+typedef Pin<GPIO_PORT_A, 5> BoardLEDPin0;
+typedef Pin<GPIO_PORT_C, 13> BoardButtonPin0;
+
 #endif
@@ -42,6 +42,16 @@ extern BoardLED boardLEDs[3];
 extern uint8_t boardButtons_count;
 extern BoardButton boardButtons[1];
 
+
+// --- PIN TYPES ---
+
+// Compile-time pin types for the LEDs and buttons above (see gpio_pin.h).
+typedef Pin<GPIO_PORT_B, 0> BoardLEDPin0;
+typedef Pin<GPIO_PORT_B, 7> BoardLEDPin1;
+typedef Pin<GPIO_PORT_B, 14> BoardLEDPin2;
+typedef Pin<GPIO_PORT_C, 13> BoardButtonPin0;
+
+
 // --- INCLUDES ---
 #include <lan8742a/phy_definition.h>
 
@@ -44,4 +44,10 @@ extern BoardLED boardLEDs[1];
 extern uint8_t boardButtons_count;
 extern BoardButton boardButtons[1];
 
+
+// --- PIN TYPES ---
+
+// Compile-time pin types for the LEDs and buttons above (see gpio_pin.h).
+typedef Pin<GPIO_PORT_B, 3> BoardLEDPin0;
+
 #endif
@@ -42,4 +42,12 @@ extern BoardLED boardLEDs[2];
 extern uint8_t boardButtons_count;
 extern BoardButton boardButtons[1];
 
+
+// --- PIN TYPES ---
+
+// Compile-time pin types for the LEDs and buttons above (see gpio_pin.h).
+typedef Pin<GPIO_PORT_C, 9> BoardLEDPin0;
+typedef Pin<GPIO_PORT_C, 8> BoardLEDPin1;
+typedef Pin<GPIO_PORT_A, 0> BoardButtonPin0;
+
 #endif
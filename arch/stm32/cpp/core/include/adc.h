@@ -56,6 +56,11 @@ struct ADC_channel {
 typedef void (*ADC_cb)();
 
 
+// Called with a completed half of the scan buffer: 'frames' frames, each with one sample per
+// channel in sequence order.
+typedef void (*ADC_scan_cb)(const uint16_t* samples, uint16_t frames);
+
+
 struct ADC_interrupts {
 	ADC_cb watchdog = 0;	// Analogue watchdog
 	ADC_cb overrun = 0;		// Overrun event.
@@ -66,6 +71,14 @@ struct ADC_interrupts {
 };
 
 
+// Achieved timing of a timer-triggered ADC.
+struct ADC_rate {
+	uint32_t frequency = 0;	// Trigger (frame) rate in Hz, rounded to the nearest.
+	int32_t error = 0;		// Deviation from the requested rate in ppm.
+	uint32_t jitter = 0;	// Maximum trigger to sampling jitter in ns.
+};
+
+
 struct ADC_device {
 	bool active = false;
 	bool sampling = false;
@@ -74,8 +87,22 @@ struct ADC_device {
 	RccPeripheral per;
 	IRQn_Type irqType;
 	uint8_t conversions = 0;
+	uint16_t ovsRatio = 1;		// Software oversampling ratio, 1 if off or done in hardware.
+	uint8_t ovsShift = 0;
 	//std::function<void(uint8_t)> callback;
 	ADC_interrupts cbs;
+#ifdef NODATE_DMA_ENABLED
+	DMA_assignment dma;
+	uint16_t* scanBuffer = 0;
+	uint16_t scanFrames = 0;
+	uint8_t scanChannels = 0;
+	ADC_scan_cb scanHalf = 0;
+	ADC_scan_cb scanFull = 0;
+#endif
+#ifdef NODATE_TIMER_ENABLED
+	bool timerTrigger = false;
+	TimerDevice timer = TIMER_1;
+#endif
 };
 
 
@@ -88,11 +115,20 @@ public:
 	static bool channel(ADC_devices device, uint8_t channel, GPIO_ports port, uint8_t pin, uint8_t time = 0);
 	static bool channel(ADC_devices device, ADC_internal channel, uint8_t time = 0);
 	static bool finishChannelConfig(ADC_devices device);
+	static bool setOversampling(ADC_devices device, uint16_t ratio, uint8_t shift);
 	static bool enableInterrupt(ADC_devices device, ADC_interrupts isr);
 	static bool disableInterrupts(ADC_devices device);
 #ifdef NODATE_DMA_ENABLED
 	static bool configureDMA(ADC_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb);
 	static bool stopDMA(ADC_devices device);
+	static bool startScan(ADC_devices device, uint16_t* buffer, uint16_t frames, ADC_scan_cb half,
+																			ADC_scan_cb full);
+	static bool stopScan(ADC_devices device);
+#endif
+#ifdef NODATE_TIMER_ENABLED
+	static bool setTimerTrigger(ADC_devices device, TimerDevice timer, uint32_t rate, 
+																			ADC_rate &achieved);
+	static bool clearTimerTrigger(ADC_devices device);
 #endif
 	static bool start(ADC_devices device);
 	static bool startSampling(ADC_devices device);
@@ -0,0 +1,91 @@
+/*
+	bus.h - Header for the shared bus module.
+	
+	Features:
+			- Shares SPI & I2C buses between multiple slave devices and callers.
+			- Handles chip select & bus settings (speed, mode) per SPI device.
+			- Queues transactions per bus and executes them back to back.
+			
+	Notes:
+			- Without an RTOS, a transaction submitted while the bus is in use (e.g. from an
+			  interrupt) is queued and executed by the caller currently using the bus.
+			- With the CMSIS-RTOS library, each bus is protected by a mutex instead, and callers
+			  block until their transaction has completed. Do not submit from an interrupt then.
+*/
+
+
+#ifndef NODATE_BUS_H
+#define NODATE_BUS_H
+
+
+#include <common.h>
+#include <gpio.h>
+#include <spi.h>
+#include <i2c.h>
+
+
+const uint8_t bus_device_max = 8;	// Maximum number of registered devices.
+const uint8_t bus_queue_size = 8;	// Maximum number of queued transactions per bus.
+
+
+enum Bus_type {
+	BUS_SPI = 0,
+	BUS_I2C
+};
+
+
+enum Bus_op {
+	BUS_WRITE = 0,	// Send 'len' bytes.
+	BUS_READ		// Receive 'len' bytes.
+};
+
+
+// A single transfer within a transaction. For SPI, chip select stays low between the steps. For
+// I2C, a write followed by a read is done as one transfer with a repeated START.
+struct Bus_step {
+	Bus_op op;
+	uint8_t* data;
+	uint16_t len;
+};
+
+
+struct Bus_transaction;
+typedef void (*Bus_cb)(Bus_transaction* transaction);
+
+
+struct Bus_transaction {
+	uint8_t device = 0;		// Handle returned by Bus::addSpiDevice() or Bus::addI2cDevice().
+	Bus_step* steps = 0;
+	uint8_t count = 0;		// Number of steps.
+	Bus_cb cb = 0;			// Called once the transaction has been executed.
+	volatile bool done = false;
+	volatile bool ok = false;
+};
+
+
+struct Bus_device {
+	bool active = false;
+	Bus_type type = BUS_SPI;
+	uint8_t bus = 0;
+	SPI_devices spi;
+	SPI_config config;
+	GpioPinDef cs;
+	I2C_devices i2c;
+	uint8_t address = 0;
+};
+
+
+class Bus {
+	static void execute(Bus_transaction &transaction);
+	
+public:
+	static bool addSpiDevice(SPI_devices device, GpioPinDef cs, SPI_config config, uint8_t &handle);
+	static bool addI2cDevice(I2C_devices device, uint8_t address, uint8_t &handle);
+	static bool submit(Bus_transaction &transaction);
+	static bool transact(Bus_transaction &transaction);
+	static bool writeRead(uint8_t handle, uint8_t* txdata, uint16_t txlen, 
+														uint8_t* rxdata, uint16_t rxlen);
+};
+
+
+#endif
@@ -15,13 +15,48 @@ class McuCore {
 	static bool systick_active;
 	static uint32_t uwTickPrio;
 	static uint32_t uwTickFreq;
+	static uint32_t cyclesHigh;
+	static uint32_t cyclesLast;
 	
 public:
 	static __IO uint32_t uwTick;
+	static __IO uint32_t uwTickWraps;
 	
 	static bool initSysTick(uint32_t tickPriority = 0x0F);
 	static bool stopSysTick();
 	static uint32_t getSysTick();
+	static bool setTickless(bool enable);
+	static void requestTick(uint32_t tick);
+	static void sleep(uint32_t ms);
+	static void idle();
+	static void setTickCallback(void (*cb)());
+	
+	static uint64_t getCycles();
+	static uint64_t getNanoseconds();
+	static uint64_t cyclesToNs(uint64_t cycles);
+	static void delayCycles(uint32_t cycles);
+	static void delayUs(uint32_t us);
+};
+
+
+// --- STOPWATCH ---
+// Measures core clock cycles from construction. With a result variable the cycles are stored in
+// it on destruction, to time a scope: '{ McuStopwatch sw(cycles); work(); }'.
+class McuStopwatch {
+	uint64_t start;
+	uint64_t* result;
+	
+public:
+	McuStopwatch() : start(McuCore::getCycles()), result(0) { }
+	explicit McuStopwatch(uint64_t &cycles) : start(McuCore::getCycles()), result(&cycles) { }
+	~McuStopwatch() { if (result) { *result = elapsedCycles(); } }
+	
+	McuStopwatch(const McuStopwatch&) = delete;
+	McuStopwatch& operator=(const McuStopwatch&) = delete;
+	
+	void restart() { start = McuCore::getCycles(); }
+	uint64_t elapsedCycles() const { return McuCore::getCycles() - start; }
+	uint64_t elapsedNs() const { return McuCore::cyclesToNs(elapsedCycles()); }
 };
 
 
@@ -1,12 +1,12 @@
 /*
-	adc.h - Header file for the ADC module.
+	dac.h - Header file for the DAC module.
 	
 	2021/04/26, Maya Posch
 */
 
 
-#ifndef NODATE_ADC_H
-#define NODATE_ADC_H
+#ifndef NODATE_DAC_H
+#define NODATE_DAC_H
 
 #include <common.h>
 #include <nodate.h>
@@ -48,7 +48,7 @@ enum DAC_wave {
 
 struct DAC_ch_cfg {
 	DAC_trigger	triggerSource = DAC_TRIG_SOFTWARE;
-	uint32_t 	trigger;	// Set if EXT or TIMER
+	uint32_t 	trigger;	// TSEL value, set if EXT or TIMER
 	bool 		waveGen = false;
 	DAC_wave 	waveGenCfg = DAC_WAVE_NOISE;
 	uint32_t 	outputBuffer;
@@ -56,14 +56,38 @@ struct DAC_ch_cfg {
 };
 
 
+// Called with the part of the stream buffer which DMA just finished sending, and which can now be
+// refilled: 'count' samples starting at index 'first'.
+typedef void (*DAC_stream_cb)(uint16_t first, uint16_t count);
+
+
+struct DAC_stream {
+	TimerDevice timer = TIMER_6;	// Timer whose update event paces the samples.
+	uint32_t rate = 0;				// Sample rate in Hz.
+	DAC_stream_cb half = 0;			// First half of the buffer sent.
+	DAC_stream_cb full = 0;			// Second half of the buffer sent.
+};
+
+
+// Only MCUs with a DAC have its register definitions.
+#ifdef DAC1
 struct DAC_device {
 	bool active = false;
 	bool ch1_active = false;
 	bool ch2_active = false;
-	SPI_TypeDef* regs;
+	DAC_TypeDef* regs = 0;
 	RccPeripheral per;
 	//IRQn_Type irqType;
 	//std::function<void(uint8_t)> callback;
+#if defined NODATE_DMA_ENABLED && defined NODATE_TIMER_ENABLED
+	bool streaming = false;
+	uint32_t streamBits = 0;	// CR bits of the streaming channel(s).
+	uint16_t streamCount = 0;
+	DAC_stream_cb streamHalf = 0;
+	DAC_stream_cb streamFull = 0;
+	TimerDevice timer = TIMER_6;
+	DMA_assignment dma;
+#endif
 };
 
 
@@ -71,8 +95,17 @@ class DAC {
 	//
 	
 public:
-	bool start(DAC_devices device, DAC_channel ch, DAC_ch_cfg ch_cfg);
-	bool write(DAC_devices device, uint16_t data);
+	static bool start(DAC_devices device, DAC_channel ch, DAC_ch_cfg ch_cfg);
+	static bool write(DAC_devices device, uint16_t data, DAC_channel ch = DAC_CH_1);
+#if defined NODATE_DMA_ENABLED && defined NODATE_TIMER_ENABLED
+	static bool startStream(DAC_devices device, DAC_channel ch, const uint16_t* buffer,
+															uint16_t count, DAC_stream stream);
+	static bool startStreamDual(DAC_devices device, const uint32_t* buffer, uint16_t count,
+																			DAC_stream stream);
+	static bool stopStream(DAC_devices device);
+#endif
 };
 
 #endif
+
+#endif
@@ -13,6 +13,12 @@
 #include <rcc.h>
 
 
+// F4 & F7 have a stream-based DMA controller, with channels as request selection per stream.
+#if defined __stm32f4 || defined __stm32f7
+#define NODATE_DMA_STREAMS
+#endif
+
+
 enum DMA_devices {
 	DMA_1,
 	DMA_2
@@ -27,8 +33,44 @@ enum DMA_priority {
 };
 
 
+enum DMA_direction {
+	DMA_PER_TO_MEM = 0,
+	DMA_MEM_TO_PER,
+	DMA_MEM_TO_MEM
+};
+
+
+// Direction of a peripheral's DMA request: RX for peripheral-to-memory, TX for memory-to-peripheral.
+enum DMA_request_dir {
+	DMA_DIR_RX = 0,
+	DMA_DIR_TX
+};
+
+
+// A channel (F0/F1) or stream with channel selection (F4/F7) assigned to a peripheral request.
+struct DMA_assignment {
+	bool valid = false;
+	DMA_devices device = DMA_1;
+	uint8_t channel = 0;
+	uint8_t request = 0;
+};
+
+
+// FIFO mode of a stream (F4/F7). Direct mode passes each element straight through, otherwise the
+// FIFO is used with the given threshold.
+enum DMA_fifo {
+	DMA_FIFO_DIRECT = 0,
+	DMA_FIFO_1_4,
+	DMA_FIFO_1_2,
+	DMA_FIFO_3_4,
+	DMA_FIFO_FULL
+};
+
+
 struct DMA_config {
-	uint8_t channel;
+	uint8_t channel;	// Channel (1-7) on F0/F1, stream (0-7) on F4/F7.
+	uint8_t request = 0;	// Channel selection for the stream on F4/F7, CSELR on F030xC/F09x.
+	DMA_direction dir = DMA_PER_TO_MEM;
 	uint32_t* source;
 	uint32_t* target;
 	DMA_priority prio;	// Channel priority.
@@ -38,39 +80,43 @@ struct DMA_config {
 	bool circular;		// Enable circular mode.
 	bool src_incr;		// Source pointer increment.
 	bool des_incr;		// Destination pointer increment.
+	DMA_fifo fifo = DMA_FIFO_DIRECT;	// FIFO mode (F4/F7).
+	uint8_t mem_burst = 1;	// Memory burst length in beats: 1, 4, 8 or 16 (F4/F7, FIFO mode).
+	uint8_t per_burst = 1;	// Peripheral burst length in beats: 1, 4, 8 or 16 (F4/F7, FIFO mode).
+	uint32_t* target2 = 0;	// Second memory buffer, enables double-buffer mode (F4/F7).
 };
 
 
-typedef void (*DMA_cb)();
+typedef void (*DMA_cb)(void* ctx);
 
 
 struct DMA_callbacks {
 	DMA_cb half = 0;
 	DMA_cb filled = 0;
 	DMA_cb error = 0;
+	void* ctx = 0;		// Passed to the callbacks.
 };
 
 
 struct DMA_channel {
-#ifdef __stm32f4
-	DMA_Stream_TypeDef* regs;
+#ifdef NODATE_DMA_STREAMS
+	DMA_Stream_TypeDef* regs = 0;
 #else
-	DMA_Channel_TypeDef* regs;
+	DMA_Channel_TypeDef* regs = 0;
 #endif
 	IRQn_Type irqType;
 	DMA_config config;
 	DMA_callbacks cb;
 	bool active = false;
+	bool claimed = false;
 };
 
 
 struct DMA_device {
 	bool active = false;
-	DMA_TypeDef* regs;
+	DMA_TypeDef* regs = 0;
 	RccPeripheral per;
-#ifdef __stm32f0
-	DMA_channel channels[7];
-#endif
+	DMA_channel channels[8];	// Channels 1-7 at index 0-6 on F0/F1, streams 0-7 on F4/F7.
 };
 
 
@@ -79,7 +125,15 @@ class DMA {
 	
 public:
 	static bool start(DMA_devices device);
+	static bool claim(DMA_devices device, uint8_t channel);
+	static bool release(DMA_devices device, uint8_t channel);
+	static bool acquire(RccPeripheral per, DMA_request_dir dir, DMA_assignment &dma);
+	static bool release(DMA_assignment &dma);
 	static bool configureChannel(DMA_devices device, DMA_config config, DMA_callbacks cb);
+	static bool transfer(DMA_devices device, uint8_t channel, uint32_t* memory, uint16_t count);
+	static uint16_t remaining(DMA_devices device, uint8_t channel);
+	static uint8_t currentMemory(DMA_devices device, uint8_t channel);
+	static bool setMemory(DMA_devices device, uint8_t channel, uint8_t memory, uint32_t* address);
 	static bool abort(DMA_devices device, uint8_t channel);
 };
 
@@ -113,6 +113,7 @@ public:
 	static bool write(GPIO_ports port, uint8_t pin, GPIO_level level);
 	static bool write(GpioPinDef def, GPIO_level level);
 	static bool write(GPIO_ports port, uint8_t pin, uint32_t level);
+	static bool writePort(GPIO_ports port, uint16_t setMask, uint16_t clearMask = 0);
 	static uint8_t read(GPIO_ports port, uint8_t pin);
 	static uint32_t readAnalog(GPIO_ports port, uint8_t pin);
 };
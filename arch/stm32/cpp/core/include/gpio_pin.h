@@ -0,0 +1,93 @@
+/*
+	gpio_pin.h - Header-only, compile-time GPIO pin types.
+
+	A pin is a type, e.g. 'typedef Pin<GPIO_PORT_B, 3> Led;', with the port registers and pin
+	mask resolved at compile time. Led::set() compiles to a single store to BSRR.
+
+	Configuration is a one-time operation and is passed on to the GPIO class, which handles
+	enabling the port clock and the family-specific registers (CRL/CRH on F1, MODER & co. on
+	the other families).
+
+*/
+
+
+#ifndef GPIO_PIN_H
+#define GPIO_PIN_H
+
+
+#include "gpio.h"
+
+
+// --- PORT REGISTERS ---
+// Maps a GPIO port to its register block. Only ports which exist on the MCU are specialised.
+template <GPIO_ports Port>
+struct GpioPortRegs {
+	static_assert(Port != Port, "GPIO port does not exist on this MCU.");
+};
+
+#if defined RCC_AHBENR_GPIOAEN || defined RCC_AHB1ENR_GPIOAEN || defined RCC_APB2ENR_IOPAEN || RCC_AHB2ENR_GPIOAEN
+template <> struct GpioPortRegs<GPIO_PORT_A> { static GPIO_TypeDef* regs() { return GPIOA; } };
+#endif
+
+#if defined RCC_AHBENR_GPIOBEN || defined RCC_AHB1ENR_GPIOBEN || defined RCC_APB2ENR_IOPBEN || RCC_AHB2ENR_GPIOBEN
+template <> struct GpioPortRegs<GPIO_PORT_B> { static GPIO_TypeDef* regs() { return GPIOB; } };
+#endif
+
+#if defined RCC_AHBENR_GPIOCEN || defined RCC_AHB1ENR_GPIOCEN || defined RCC_APB2ENR_IOPCEN || RCC_AHB2ENR_GPIOCEN
+template <> struct GpioPortRegs<GPIO_PORT_C> { static GPIO_TypeDef* regs() { return GPIOC; } };
+#endif
+
+#if defined RCC_AHBENR_GPIODEN || defined RCC_AHB1ENR_GPIODEN || defined RCC_APB2ENR_IOPDEN || RCC_AHB2ENR_GPIODEN
+template <> struct GpioPortRegs<GPIO_PORT_D> { static GPIO_TypeDef* regs() { return GPIOD; } };
+#endif
+
+#if defined RCC_AHBENR_GPIOEEN || defined RCC_AHB1ENR_GPIOEEN || defined RCC_APB2ENR_IOPEEN || RCC_AHB2ENR_GPIOEEN
+template <> struct GpioPortRegs<GPIO_PORT_E> { static GPIO_TypeDef* regs() { return GPIOE; } };
+#endif
+
+#if defined RCC_AHBENR_GPIOFEN || defined RCC_AHB1ENR_GPIOFEN || defined RCC_APB2ENR_IOPFEN  || RCC_AHB2ENR_GPIOFEN
+template <> struct GpioPortRegs<GPIO_PORT_F> { static GPIO_TypeDef* regs() { return GPIOF; } };
+#endif
+
+#if defined RCC_AHBENR_GPIOGEN || defined RCC_AHB1ENR_GPIOGEN || defined RCC_APB2ENR_IOPGEN  || RCC_AHB2ENR_GPIOGEN
+template <> struct GpioPortRegs<GPIO_PORT_G> { static GPIO_TypeDef* regs() { return GPIOG; } };
+#endif
+
+#if defined RCC_AHBENR_GPIOHEN || defined RCC_AHB1ENR_GPIOHEN || defined RCC_APB2ENR_IOPHEN  || RCC_AHB2ENR_GPIOHEN
+template <> struct GpioPortRegs<GPIO_PORT_H> { static GPIO_TypeDef* regs() { return GPIOH; } };
+#endif
+
+
+// --- PIN ---
+template <GPIO_ports Port, uint8_t N>
+class Pin {
+	static_assert(N < 16, "GPIO pin number must be 0 - 15.");
+
+public:
+	static const GPIO_ports port = Port;
+	static const uint8_t pin = N;
+	static const uint32_t mask = (1UL << N);
+
+	static GPIO_TypeDef* regs() { return GpioPortRegs<Port>::regs(); }
+	static GpioPinDef def(uint8_t af = 0) { GpioPinDef d = { Port, N, af }; return d; }
+
+	// --- CONFIGURATION ---
+	static bool input(GPIO_pupd pupd = GPIO_FLOATING) { return GPIO::set_input(Port, N, pupd); }
+	static bool output(GPIO_pupd pupd = GPIO_FLOATING, GPIO_out_type type = GPIO_PUSH_PULL,
+							GPIO_out_speed speed = GPIO_LOW) {
+		return GPIO::set_output(Port, N, pupd, type, speed);
+	}
+
+	static bool af(uint8_t af) { return GPIO::set_af(Port, N, af); }
+	static bool analog() { return GPIO::set_analog(Port, N); }
+
+	// --- ACCESS ---
+	// The port has to be configured via one of the above functions first.
+	static void set() { regs()->BSRR = mask; }
+	static void clear() { regs()->BSRR = (mask << 16); }
+	static void write(bool high) { regs()->BSRR = high ? mask : (mask << 16); }
+	static void toggle() { regs()->BSRR = (regs()->ODR & mask) ? (mask << 16) : mask; }
+	static bool read() { return (regs()->IDR & mask) != 0; }
+};
+
+#endif
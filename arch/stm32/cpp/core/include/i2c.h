@@ -8,7 +8,13 @@
 #define I2C_H
 
 #include <common.h>
-#include <nodate.h>
+#include <core.h>
+#include <gpio.h>
+#include <rcc.h>
+#include <i2c_timing.h>
+#ifdef NODATE_DMA_ENABLED
+#include <dma.h>
+#endif
 
 #include <functional>
 
@@ -28,6 +34,21 @@ enum I2C_modes {
 };
 
 
+typedef void (*I2C_done_cb)();
+
+
+const uint8_t i2c_register_write_max = 32;	// Maximum data length for I2C::writeRegisters().
+
+
+// Phase of an asynchronous master transfer.
+enum I2C_xfer_state {
+	I2C_XFER_IDLE = 0,
+	I2C_XFER_WRITE,
+	I2C_XFER_READ,
+	I2C_XFER_STOP
+};
+
+
 struct I2C_device {
 	bool active = false;
 	bool master = false;
@@ -35,7 +56,27 @@ struct I2C_device {
 	I2C_TypeDef* regs;
 	RccPeripheral per;
 	IRQn_Type irqType;
+	IRQn_Type irqErrType;	// Separate error interrupt, except on F0.
 	std::function<void(uint8_t)> callback;
+	uint32_t riseTime = i2c_rise_time_default;	// SCL/SDA rise time in ns.
+	uint32_t fallTime = i2c_fall_time_default;	// SCL/SDA fall time in ns.
+	
+	// Asynchronous transfer.
+	volatile I2C_xfer_state xferState = I2C_XFER_IDLE;
+	volatile bool xferError = false;
+	uint8_t xferAddress = 0;
+	const uint8_t* txData = 0;
+	uint16_t txLen = 0;
+	uint8_t* rxData = 0;
+	uint16_t rxLen = 0;
+	volatile uint16_t xferPos = 0;
+	uint16_t xferLeft = 0;		// Bytes left to program in NBYTES (F0/F7/L4).
+	I2C_done_cb xferCallback = 0;
+#ifdef NODATE_DMA_ENABLED
+	DMA_assignment dmaTx;
+	DMA_assignment dmaRx;
+	bool dmaActive = false;
+#endif
 };
 
 
@@ -45,6 +86,7 @@ class I2C {
 public:
 	static bool startI2C(I2C_devices device, GPIO_ports scl_port, uint8_t scl_pin, uint8_t scl_af,
 											GPIO_ports sda_port, uint8_t sda_pin, uint8_t sda_af);
+	static bool setBusTimes(I2C_devices device, uint32_t rise, uint32_t fall);
 	static bool startMaster(I2C_devices device, I2C_modes mode, 
 											std::function<void(uint8_t)> callback);
 	static bool setSlaveTarget(I2C_devices device, uint8_t slave);
@@ -58,6 +100,17 @@ public:
 	static bool receiveFromSlave(I2C_devices device, uint32_t count, uint8_t* buffer);
     static bool receiveFromSlave(I2C_devices device, uint8_t len);
 	static bool receiveFromMaster(I2C_devices device, uint32_t count, uint8_t* buffer);
+	static bool writeRead(I2C_devices device, uint8_t address, const uint8_t* txdata, uint16_t txlen,
+											uint8_t* rxdata, uint16_t rxlen, I2C_done_cb cb = 0);
+	static bool transfer(I2C_devices device, uint8_t address, const uint8_t* txdata, uint16_t txlen,
+											uint8_t* rxdata, uint16_t rxlen);
+	static bool transferBusy(I2C_devices device);
+	static bool transferFailed(I2C_devices device);
+	static bool abort(I2C_devices device);
+	static bool readRegisters(I2C_devices device, uint8_t address, uint8_t reg, uint8_t* data, 
+																			uint16_t len);
+	static bool writeRegisters(I2C_devices device, uint8_t address, uint8_t reg, 
+															const uint8_t* data, uint16_t len);
 	static bool stop(I2C_devices device);
 };
 
@@ -0,0 +1,224 @@
+/*
+	i2c_timing.h - Header-only, compile-time I2C bus timing calculation.
+
+	Computes the TIMINGR value (F0/F3/F7/L4 I2C peripheral) or the CR2 FREQ, CCR and TRISE values
+	(F1/F4 I2C peripheral) for a given I2C kernel clock, target SCL frequency and SCL/SDA rise &
+	fall times. The timing limits follow the I2C specification (UM10204) for Standard-mode
+	(<= 100 kHz), Fast-mode (<= 400 kHz) and Fast-mode Plus (<= 1 MHz).
+
+	All functions are constexpr, so that with a known clock the register values are resolved at
+	compile time, e.g.:
+
+		static_assert(I2C_timing::timingr(48000000, 400000) != 0, "No valid I2C timing.");
+
+	The resulting SCL frequency never exceeds the target frequency. Since the peripheral counts
+	the high and low periods from the moment it sees the SCL edge, the given rise & fall times
+	are part of the SCL period. Rise & fall times which are lower than on the actual bus thus
+	result in a slower bus, never a faster one.
+
+*/
+
+
+#ifndef I2C_TIMING_H
+#define I2C_TIMING_H
+
+
+#include <stdint.h>
+
+
+const uint32_t i2c_rise_time_default = 100;	// SCL/SDA rise time in ns.
+const uint32_t i2c_fall_time_default = 10;	// SCL/SDA fall time in ns.
+
+
+class I2C_timing {
+	// --- BUS CHARACTERISTICS ---
+	// Limits in ns per speed class.
+	static constexpr uint32_t lowMin(uint32_t freq) {
+		return freq <= 100000 ? 4700 : (freq <= 400000 ? 1300 : 500);
+	}
+
+	static constexpr uint32_t highMin(uint32_t freq) {
+		return freq <= 100000 ? 4000 : (freq <= 400000 ? 600 : 260);
+	}
+
+	static constexpr uint32_t setupMin(uint32_t freq) {
+		return freq <= 100000 ? 250 : (freq <= 400000 ? 100 : 50);
+	}
+
+	static constexpr uint32_t holdMax(uint32_t freq) {
+		return freq <= 100000 ? 3450 : (freq <= 400000 ? 900 : 450);
+	}
+
+	// Analog noise filter delay in ns.
+	static constexpr uint32_t filterMin() { return 50; }
+	static constexpr uint32_t filterMax() { return 260; }
+
+	// --- HELPERS ---
+	static constexpr uint64_t divUp(uint64_t a, uint64_t b) { return (a + b - 1) / b; }
+	static constexpr uint64_t sub(uint64_t a, uint64_t b) { return a > b ? a - b : 0; }
+	static constexpr uint64_t max(uint64_t a, uint64_t b) { return a > b ? a : b; }
+
+	// Converts a time in ns to clock cycles, rounding up or down.
+	static constexpr uint64_t cyclesUp(uint64_t ns, uint32_t clock) {
+		return divUp(ns * clock, 1000000000ULL);
+	}
+
+	static constexpr uint64_t cyclesDown(uint64_t ns, uint32_t clock) {
+		return (ns * clock) / 1000000000ULL;
+	}
+
+	// --- TIMINGR ---
+	// SCL synchronisation delay: analog filter plus two kernel clock cycles.
+	static constexpr uint64_t sync(uint32_t clock) { return cyclesDown(filterMin(), clock) + 2; }
+
+	// Cycles of the SCL period spent outside of SCLL & SCLH.
+	static constexpr uint64_t fixed(uint32_t clock, uint32_t rise, uint32_t fall) {
+		return 2 * sync(clock) + cyclesDown(rise + fall, clock);
+	}
+
+	static constexpr uint64_t scldel(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t div) {
+		return sub(divUp(cyclesUp(rise + setupMin(freq), clock), div), 1);
+	}
+
+	static constexpr uint64_t sdadel(uint32_t clock, uint32_t fall, uint32_t div) {
+		return divUp(sub(cyclesUp(sub(fall, filterMin()), clock), 3), div);
+	}
+
+	// The data hold time may not exceed the maximum, unless no extra SDA delay is used at all.
+	static constexpr bool sdadelValid(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return sdadel(clock, fall, div) <= 15 && (sdadel(clock, fall, div) == 0 ||
+					sdadel(clock, fall, div) * div <=
+					sub(cyclesDown(sub(holdMax(freq), rise + filterMax()), clock), 4));
+	}
+
+	// Minimum SCLL + 1 and SCLH + 1 for the low & high periods.
+	static constexpr uint64_t low(uint32_t clock, uint32_t freq, uint32_t div) {
+		return max(divUp(sub(cyclesUp(lowMin(freq), clock), sync(clock)), div), 1);
+	}
+
+	static constexpr uint64_t high(uint32_t clock, uint32_t freq, uint32_t div) {
+		return max(divUp(sub(cyclesUp(highMin(freq), clock), sync(clock)), div), 1);
+	}
+
+	// SCLL + SCLH + 2: the shortest period which does not exceed the target frequency.
+	static constexpr uint64_t total(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return max(divUp(sub(divUp(clock, freq), fixed(clock, rise, fall)), div),
+					low(clock, freq, div) + high(clock, freq, div));
+	}
+
+	// Any cycles beyond the minimum low & high periods are split evenly between both.
+	static constexpr uint64_t extra(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return total(clock, freq, rise, fall, div) - low(clock, freq, div) - high(clock, freq, div);
+	}
+
+	static constexpr uint64_t scll(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return low(clock, freq, div) + extra(clock, freq, rise, fall, div) -
+					extra(clock, freq, rise, fall, div) / 2 - 1;
+	}
+
+	static constexpr uint64_t sclh(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return high(clock, freq, div) + extra(clock, freq, rise, fall, div) / 2 - 1;
+	}
+
+	static constexpr bool valid(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return scldel(clock, freq, rise, div) <= 15 && sdadelValid(clock, freq, rise, fall, div) &&
+					scll(clock, freq, rise, fall, div) <= 255 &&
+					sclh(clock, freq, rise, fall, div) <= 255;
+	}
+
+	// SCL period in excess of the target period, in kernel clock cycles. Invalid settings return
+	// the maximum error.
+	static constexpr uint64_t error(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+																			uint32_t div) {
+		return !valid(clock, freq, rise, fall, div) ? UINT64_MAX :
+					sub(total(clock, freq, rise, fall, div) * div + fixed(clock, rise, fall),
+						divUp(clock, freq));
+	}
+
+	// Finds the prescaler (1 - 16) with the lowest error, preferring the lowest prescaler.
+	static constexpr uint32_t bestDiv(uint32_t clock, uint32_t freq, uint32_t rise, uint32_t fall,
+															uint32_t div, uint32_t best) {
+		return div > 16 ? best : bestDiv(clock, freq, rise, fall, div + 1,
+					error(clock, freq, rise, fall, div) < error(clock, freq, rise, fall, best) ?
+					div : best);
+	}
+
+	static constexpr uint32_t timingrFor(uint32_t clock, uint32_t freq, uint32_t rise,
+															uint32_t fall, uint32_t div) {
+		return !valid(clock, freq, rise, fall, div) ? 0 :
+					((div - 1) << 28) |
+					(uint32_t) (scldel(clock, freq, rise, div) << 20) |
+					(uint32_t) (sdadel(clock, fall, div) << 16) |
+					(uint32_t) (sclh(clock, freq, rise, fall, div) << 8) |
+					(uint32_t) scll(clock, freq, rise, fall, div);
+	}
+
+	// --- CCR ---
+	// Standard-mode: high & low period are both CCR cycles.
+	static constexpr uint32_t ccrStandard(uint32_t pclk, uint32_t freq, uint32_t rise) {
+		return (uint32_t) max(max(divUp(sub(divUp(pclk, freq), cyclesDown(rise, pclk)), 2),
+					cyclesUp(lowMin(freq), pclk)), 4);
+	}
+
+	// Fast-mode: low/high is 2/1 times CCR, or 16/9 times CCR with DUTY set.
+	static constexpr uint32_t ccrFast(uint32_t pclk, uint32_t freq, uint32_t rise, bool duty) {
+		return (uint32_t) max(max(max(divUp(sub(divUp(pclk, freq), cyclesDown(rise, pclk)),
+													duty ? 25 : 3),
+					divUp(cyclesUp(lowMin(freq), pclk), duty ? 16 : 2)),
+					divUp(cyclesUp(highMin(freq), pclk), duty ? 9 : 1)), 1);
+	}
+
+	static constexpr bool ccrDuty(uint32_t pclk, uint32_t freq, uint32_t rise) {
+		return 25 * ccrFast(pclk, freq, rise, true) < 3 * ccrFast(pclk, freq, rise, false);
+	}
+
+	static constexpr uint32_t ccrFor(uint32_t value, uint32_t bits) {
+		return value > 0xFFF ? 0 : (bits | value);
+	}
+
+public:
+	// --- NEW PERIPHERAL (F0/F3/F7/L4) ---
+	// Returns the TIMINGR value for the I2C kernel clock and target SCL frequency in Hz, with the
+	// analog filter enabled and the digital filter disabled. Returns 0 if no valid timing exists.
+	static constexpr uint32_t timingr(uint32_t clock, uint32_t freq,
+												uint32_t rise = i2c_rise_time_default,
+												uint32_t fall = i2c_fall_time_default) {
+		return (clock == 0 || freq == 0 || freq > 1000000) ? 0 :
+					timingrFor(clock, freq, rise, fall, bestDiv(clock, freq, rise, fall, 2, 1));
+	}
+
+	// Returns the SCL frequency in Hz resulting from a TIMINGR value.
+	static constexpr uint32_t frequency(uint32_t clock, uint32_t timing,
+												uint32_t rise = i2c_rise_time_default,
+												uint32_t fall = i2c_fall_time_default) {
+		return (uint32_t) (clock / ((((timing & 0xFF) + 1) + (((timing >> 8) & 0xFF) + 1)) *
+					((timing >> 28) + 1) + fixed(clock, rise, fall)));
+	}
+
+	// --- LEGACY PERIPHERAL (F1/F4) ---
+	// Returns the CR2 FREQ value (PCLK1 in MHz). Valid values are 2 - 50.
+	static constexpr uint32_t cr2Freq(uint32_t pclk) { return pclk / 1000000; }
+
+	// Returns the CCR value including the F/S (bit 15) & DUTY (bit 14) bits. Fast-mode Plus is
+	// not supported. Returns 0 if no valid timing exists.
+	static constexpr uint32_t ccr(uint32_t pclk, uint32_t freq,
+												uint32_t rise = i2c_rise_time_default) {
+		return (pclk == 0 || freq == 0 || freq > 400000) ? 0 :
+					freq <= 100000 ? ccrFor(ccrStandard(pclk, freq, rise), 0) :
+					ccrFor(ccrFast(pclk, freq, rise, ccrDuty(pclk, freq, rise)),
+						(1UL << 15) | (ccrDuty(pclk, freq, rise) ? (1UL << 14) : 0));
+	}
+
+	// Returns the TRISE value: the maximum rise time of the speed class in PCLK1 cycles, plus 1.
+	static constexpr uint32_t trise(uint32_t pclk, uint32_t freq) {
+		return (pclk / 1000000) * (freq <= 100000 ? 1000 : 300) / 1000 + 1;
+	}
+};
+
+#endif
@@ -32,6 +32,7 @@
 #include <common.h>
 #include <ethernet.h>
 #include <gpio.h>
+#include <gpio_pin.h>
 #include <i2c.h>
 #include <interrupts.h>
 #include <io.h>
@@ -41,7 +42,9 @@
 #include <usart.h>
 #include <adc.h>
 #include <spi.h>
+#include <bus.h>
 #include <dac.h>
+#include <timer_wheel.h>
 
 #include <board_definition.h>
 
@@ -58,7 +58,9 @@ enum RccPeripheral {
 	RCC_CEC,
 	RCC_SPI3,
 	RCC_SPI4,
-	RCC_SPI5
+	RCC_SPI5,
+	RCC_TIM5,
+	RCC_TIM8
 };
 
 
@@ -8,7 +8,12 @@
 #define SPI_H
 
 #include <common.h>
-#include <nodate.h>
+#include <core.h>
+#include <gpio.h>
+#include <rcc.h>
+#ifdef NODATE_DMA_ENABLED
+#include <dma.h>
+#endif
 
 #include <functional>
 
@@ -38,6 +43,34 @@ struct I2S_pins {
 };
 
 
+enum SPI_frame_size {
+	SPI_FRAME_8BIT = 0,
+	SPI_FRAME_16BIT
+};
+
+
+// Clock polarity & phase: mode = (CPOL << 1) | CPHA.
+enum SPI_mode {
+	SPI_MODE_0 = 0,
+	SPI_MODE_1,
+	SPI_MODE_2,
+	SPI_MODE_3
+};
+
+
+// Bus settings for one slave device. Applied with SPI::configure() before each transaction when
+// slaves with different requirements share the bus.
+struct SPI_config {
+	uint32_t frequency = 1000000;	// Maximum SCK frequency in Hz.
+	SPI_mode mode = SPI_MODE_0;
+	SPI_frame_size frameSize = SPI_FRAME_8BIT;
+	bool lsbFirst = false;
+};
+
+
+typedef void (*SPI_done_cb)();
+
+
 struct SPI_device {
 	bool active = false;
 	bool master = false;
@@ -46,6 +79,15 @@ struct SPI_device {
 	RccPeripheral per;
 	IRQn_Type irqType;
 	std::function<void(uint8_t)> callback;
+	SPI_frame_size frameSize = SPI_FRAME_8BIT;
+	uint32_t frequency = 0;	// Actual SCK frequency in Hz.
+#ifdef NODATE_DMA_ENABLED
+	DMA_assignment dmaTx;
+	DMA_assignment dmaRx;
+	SPI_done_cb dmaCallback = 0;
+	volatile bool dmaBusy = false;
+	volatile bool dmaError = false;
+#endif
 };
 
 
@@ -53,7 +95,7 @@ class SPI {
 	//
 	
 public:
-	static bool startSPIMaster(SPI_devices device, SPI_pins pins);
+	static bool startSPIMaster(SPI_devices device, SPI_pins pins, SPI_config config = SPI_config());
 	static bool startI2SMaster(SPI_devices device, I2S_pins pins);
 	static bool startSPISlave(SPI_devices device, SPI_pins pins);
 	static bool startI2SSlave(SPI_devices device, I2S_pins pins);
@@ -61,6 +103,9 @@ public:
 		//									std::function<void(uint8_t)> callback);
 	//static bool setSlaveTarget(I2C_devices device, uint8_t slave);
 	//static bool startSlave(I2C_devices device, uint8_t address);
+	static bool configure(SPI_devices device, const SPI_config &config);
+	static uint32_t getFrequency(SPI_devices device);
+	static bool setFrameSize(SPI_devices device, SPI_frame_size size);
 	static bool sendData(SPI_devices device, uint8_t* data, uint16_t len);
 	static bool receiveData(SPI_devices device, uint8_t* data, uint16_t count);
 	static bool transceiveData(SPI_devices device, uint8_t* txdata, uint16_t txcount,
@@ -73,6 +118,12 @@ public:
 	//static bool receiveFromSlave(I2C_devices device, uint32_t count, uint8_t* buffer);
     //static bool receiveFromSlave(I2C_devices device, uint8_t len);
 	//static bool receiveFromMaster(I2C_devices device, uint32_t count, uint8_t* buffer);
+#ifdef NODATE_DMA_ENABLED
+	static bool transferDMA(SPI_devices device, const void* txdata, void* rxdata, uint16_t count, 
+																		SPI_done_cb cb = 0);
+	static bool transferBusy(SPI_devices device);
+	static bool transferFailed(SPI_devices device);
+#endif
 	static bool stop(SPI_devices device);
 };
 
@@ -13,6 +13,12 @@
 
 
 #include "common.h"
+#include "rcc.h"
+#include "gpio.h"
+
+#ifdef NODATE_DMA_ENABLED
+#include "dma.h"
+#endif
 
 
 enum TimerDevice {
@@ -27,6 +33,46 @@ enum TimerDevice {
 };
 
 
+// Trigger output (TRGO) source, as used to trigger other peripherals such as the ADC and DAC.
+enum Timer_trigger {
+	TIMER_TRGO_RESET = 0,	// UG bit.
+	TIMER_TRGO_ENABLE,		// Counter enable.
+	TIMER_TRGO_UPDATE		// Update event (counter overflow).
+};
+
+
+enum Timer_channel {
+	TIMER_CH_1 = 0,
+	TIMER_CH_2,
+	TIMER_CH_3,
+	TIMER_CH_4
+};
+
+
+// Input capture edge.
+enum Timer_edge {
+	TIMER_EDGE_RISING = 0,
+	TIMER_EDGE_FALLING,
+	TIMER_EDGE_BOTH			// Not on F1.
+};
+
+
+struct Timer_device {
+	bool active = false;
+	TIM_TypeDef* regs = 0;
+	RccPeripheral per;
+	bool apb2 = false;		// Clocked from APB2 instead of APB1.
+	bool wide = false;		// 32-bit counter.
+	bool advanced = false;	// Advanced-control timer, with main output enable (MOE).
+	uint8_t channels = 0;	// Capture/compare channels.
+	uint32_t prescaler = 0;	// PSC + 1.
+	uint32_t reload = 0;	// ARR.
+#ifdef NODATE_DMA_ENABLED
+	DMA_assignment dma[4];	// Input capture DMA per channel.
+#endif
+};
+
+
 class Timer {
 	//
 	
@@ -35,7 +81,31 @@ public:
 	~Timer();
 
 	static void delay(uint32_t ms);
-	//bool startPWM(TimerDevice device, 
+	
+	static uint32_t clock(TimerDevice device);
+	static bool setFrequency(TimerDevice device, uint32_t frequency);
+	static uint64_t getPeriod(TimerDevice device);
+	static uint32_t getFrequency(TimerDevice device);
+	static bool setTrigger(TimerDevice device, Timer_trigger trigger);
+	static bool start(TimerDevice device);
+	static bool stop(TimerDevice device);
+	static uint32_t tickRate(TimerDevice device);
+	static uint32_t getCount(TimerDevice device);
+	
+	static bool startPWM(TimerDevice device, Timer_channel ch, GpioPinDef pin, uint32_t frequency,
+																			uint16_t duty);
+	static bool setDuty(TimerDevice device, Timer_channel ch, uint16_t duty);
+	static bool stopPWM(TimerDevice device, Timer_channel ch);
+#ifdef NODATE_DMA_ENABLED
+	static bool startCapture(TimerDevice device, Timer_channel ch, GpioPinDef pin, Timer_edge edge,
+								uint32_t rate, uint32_t* buffer, uint16_t count, DMA_callbacks cb);
+	static bool stopCapture(TimerDevice device, Timer_channel ch);
+#endif
+	static uint32_t captureTicks(TimerDevice device, uint32_t from, uint32_t to);
+	static bool setOnePulse(TimerDevice device, Timer_channel ch, GpioPinDef pin, uint32_t delay,
+																			uint32_t width);
+	static bool firePulse(TimerDevice device);
+	static bool startEncoder(TimerDevice device, GpioPinDef a, GpioPinDef b, uint8_t filter = 0);
 };
 
 #endif
@@ -0,0 +1,52 @@
+/*
+	timer_wheel.h - Software timers on a hierarchical timer wheel.
+
+	Features:
+			- One-shot & periodic callbacks with millisecond (SysTick) resolution.
+			- O(1) start & cancel, from a statically allocated pool of timers.
+			- Callbacks run from the SysTick interrupt or from a deferred-work loop calling run() and
+			  idle().
+			- Requests the next SysTick in tickless mode.
+
+	Notes:
+			- The pool size is set with NODATE_WHEEL_TIMERS (default: 32).
+			- Delays are limited to 2^31 ticks.
+*/
+
+
+#ifndef NODATE_TIMER_WHEEL_H
+#define NODATE_TIMER_WHEEL_H
+
+#include <common.h>
+
+
+#ifndef NODATE_WHEEL_TIMERS
+#define NODATE_WHEEL_TIMERS 32
+#endif
+
+
+typedef void (*TimerWheel_cb)(void* arg);
+
+
+enum TimerWheel_mode {
+	WHEEL_RUN_SYSTICK,		// Callbacks run in the SysTick interrupt.
+	WHEEL_RUN_DEFERRED		// Callbacks run in run(), e.g. from the main loop.
+};
+
+
+class TimerWheel {
+	//
+
+public:
+	static bool init(TimerWheel_mode mode = WHEEL_RUN_DEFERRED);
+	static bool start(uint32_t ms, TimerWheel_cb cb, bool periodic, uint32_t &handle,
+																		void* arg = 0);
+	static bool cancel(uint32_t handle);
+	static bool active(uint32_t handle);
+	static uint32_t remaining(uint32_t handle);
+	static void run();
+	static void idle();
+};
+
+
+#endif
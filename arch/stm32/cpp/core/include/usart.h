@@ -28,6 +28,17 @@ enum USART_devices {
 };
 
 
+typedef void (*USART_rx_cb)(uint16_t available);
+typedef void (*USART_span_cb)(uint8_t* data, uint16_t len);
+typedef void (*USART_tx_cb)(const uint8_t* data, uint16_t len);
+
+
+struct USART_tx_desc {
+	const uint8_t* data;
+	uint16_t len;
+};
+
+
 struct USART_device {
 	bool active = false;
 	USART_TypeDef* regs;
@@ -41,6 +52,32 @@ struct USART_device {
 	RccPeripheral per;
 	IRQn_Type irqType;
 	std::function<void(char)> callback;
+	uint8_t* txBuffer = 0;
+	uint16_t txSize = 0;
+	volatile uint16_t txHead = 0;	// End of the data committed for the interrupt handler.
+	volatile uint16_t txTail = 0;
+	volatile uint16_t txReserve = 0;	// End of the space reserved by write().
+	volatile uint8_t txWriters = 0;	// write() calls copying into reserved space.
+	volatile uint32_t txDropped = 0;	// Bytes dropped by sendUart() with nothing left to send.
+	uint8_t* volatile rxBuffer = 0;
+	uint16_t rxSize = 0;
+	volatile uint16_t rxHead = 0;
+	volatile uint16_t rxTail = 0;
+	uint16_t rxWatermark = 0;
+	USART_rx_cb rxNotify = 0;
+	volatile uint32_t rxDropped = 0;	// Bytes dropped because the RX buffer was full.
+	DMA_assignment dmaRx;
+	DMA_assignment dmaTx;
+	uint8_t* dmaRxBuffer = 0;
+	uint16_t dmaRxSize = 0;
+	uint16_t dmaRxPos = 0;
+	USART_span_cb dmaRxCallback = 0;
+	USART_tx_desc* dmaTxQueue = 0;
+	uint8_t dmaTxSize = 0;
+	volatile uint8_t dmaTxHead = 0;
+	volatile uint8_t dmaTxTail = 0;
+	volatile bool dmaTxBusy = false;
+	USART_tx_cb dmaTxCallback = 0;
 };
 
 
@@ -60,7 +97,22 @@ public:
 #ifdef NODATE_DMA_ENABLED
 	static bool configureDMAT(USART_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb);
 	static bool configureDMAR(USART_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb);
+	static bool startRxDMA(USART_devices device, uint8_t* buffer, uint16_t size, USART_span_cb cb);
+	static bool stopRxDMA(USART_devices device);
+	static bool startTxDMA(USART_devices device, USART_tx_desc* queue, uint8_t size, 
+																		USART_tx_cb cb = 0);
+	static bool queueTxDMA(USART_devices device, const uint8_t* data, uint16_t len);
+	static bool stopTxDMA(USART_devices device);
 #endif
+	static bool setRxBuffer(USART_devices device, uint8_t* buffer, uint16_t size, 
+											uint16_t watermark = 0, USART_rx_cb notify = 0);
+	static uint16_t read(USART_devices device, char* buffer, uint16_t max);
+	static uint16_t available(USART_devices device);
+	static uint32_t rxDropped(USART_devices device);
+	static bool setTxBuffer(USART_devices device, uint8_t* buffer, uint16_t size);
+	static uint16_t write(USART_devices device, const char* buffer, uint16_t len);
+	static uint32_t txDropped(USART_devices device);
+	static bool flush(USART_devices device);
 	static bool sendUart(USART_devices device, char &ch);
 	static bool stopUart(USART_devices device);
 };
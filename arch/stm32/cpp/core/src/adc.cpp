@@ -109,6 +109,40 @@ extern "C" {
 #endif
 
 
+// --- SAMPLE TIME ---
+// Set the sampling time (SMP bits) of a channel. On F0 there is a single sampling time for all
+// channels.
+static bool adcSampleTime(ADC_device &instance, uint8_t channel, uint8_t time) {
+	if (time > 7) { return false; } // three bits value.
+	
+#if defined __stm32f0
+	instance.regs->SMPR = time;
+#elif defined __stm32f3
+	// SMPR1 holds channels 0 - 9, SMPR2 channels 10 - 18.
+	if (channel < 10) {
+		instance.regs->SMPR1 = (instance.regs->SMPR1 & ~(7UL << (3 * channel))) | 
+															(time << (3 * channel));
+	}
+	else {
+		instance.regs->SMPR2 = (instance.regs->SMPR2 & ~(7UL << (3 * (channel - 10)))) | 
+															(time << (3 * (channel - 10)));
+	}
+#elif defined __stm32f4 || defined __stm32f1
+	// SMPR2 holds channels 0 - 9, SMPR1 channels 10 - 18.
+	if (channel < 10) {
+		instance.regs->SMPR2 = (instance.regs->SMPR2 & ~(7UL << (3 * channel))) | 
+															(time << (3 * channel));
+	}
+	else {
+		instance.regs->SMPR1 = (instance.regs->SMPR1 & ~(7UL << (3 * (channel - 10)))) | 
+															(time << (3 * (channel - 10)));
+	}
+#endif
+	
+	return true;
+}
+
+
 bool ADC::calibrate(ADC_devices device) {
 	ADC_device &instance = adcList[device];
 #ifdef __stm32f0
@@ -275,6 +309,9 @@ bool ADC::configure(ADC_devices device, ADC_modes mode) {
 		instance.regs->CR2 |= ADC_CR2_CONT;
 	}
 	
+	// Conversions are started with SWSTART, which has to be selected as the external trigger.
+	instance.regs->CR2 |= ADC_CR2_EXTSEL | ADC_CR2_EXTTRIG;
+	
 	instance.active = true;
 	
 	return true;
@@ -328,20 +365,20 @@ bool ADC::channel(ADC_devices device, uint8_t channel, GPIO_ports port, uint8_t
 	if (instance.sampling) { return false; } // Can't change channels while sampling.
 	
 #if defined __stm32f0
-	if (pin > 18) { return false; } // Only 19 channels available.
+	if (channel > 18) { return false; } // Only 19 channels available.
+	
+	// Set the sampling time. On F0 this is the same for all channels.
+	if (!adcSampleTime(instance, channel, time)) { return false; }
 	
 	// Set the target pin to analogue mode.
 	GPIO::set_analog(port, pin);
 
 	// Select the channel as active.
-	instance.regs->CHSELR |= (1 << pin);
-	
-	// Set the sampling time. On F0 this is the same for all channels.
-	if (time > 7) { return false; } // three bits value.
-	instance.regs->SMPR = time;
+	instance.regs->CHSELR |= (1 << channel);
 #elif defined __stm32f3
 	// F334 has 14 (ADC1) and 17 (ADC2) channels.
 	if (pin > 16) { return false; }
+	if (!adcSampleTime(instance, channel, time)) { return false; }
 	
 	// Set the target pin to analogue mode.
 	GPIO::set_analog(port, pin);
@@ -364,9 +401,6 @@ bool ADC::channel(ADC_devices device, uint8_t channel, GPIO_ports port, uint8_t
 		return false;
 	}
 	
-	// TODO: Set sample rate.
-	
-	
 	// Increase registered number of conversions.
 	instance.conversions++;
 	
@@ -374,6 +408,7 @@ bool ADC::channel(ADC_devices device, uint8_t channel, GPIO_ports port, uint8_t
 #elif defined __stm32f4 || defined __stm32f1
 	// F334 has 14 (ADC1) and 17 (ADC2) channels.
 	if (pin > 16) { return false; }
+	if (!adcSampleTime(instance, channel, time)) { return false; }
 	
 	// Set the target pin to analogue mode.
 	GPIO::set_analog(port, pin);
@@ -391,9 +426,6 @@ bool ADC::channel(ADC_devices device, uint8_t channel, GPIO_ports port, uint8_t
 		return false;
 	}
 	
-	// TODO: Set sample rate.
-	
-	
 	// Increase registered number of conversions.
 	instance.conversions++;
 	
@@ -633,11 +665,55 @@ bool ADC::finishChannelConfig(ADC_devices device) {
 	// SQR1 L[3:0] -> Number of items in the total sequence (SQR 1-4).
 	// Update SQR_L by L + 1
 	instance.regs->SQR1 |= (instance.conversions - 1) << (4 * 5);
+	
+	// Scan mode converts the whole sequence, instead of only the first channel.
+	if (instance.conversions > 1) {
+		instance.regs->CR1 |= ADC_CR1_SCAN;
+	}
 #endif
 	return true;
 }
 
 
+// --- SET OVERSAMPLING ---
+// Average 'ratio' conversions of each channel into one sample, shifted right by 'shift' bits.
+// E.g. a ratio of 16 with a shift of 2 gives 14-bit samples. Hardware oversampling (L4) requires
+// a power of two ratio (2 - 256) and a shift of up to 8 bits. Otherwise the frames of a scan are
+// decimated in software, before they're passed on to the scan callbacks. A ratio of 1 disables
+// oversampling.
+bool ADC::setOversampling(ADC_devices device, uint16_t ratio, uint8_t shift) {
+	ADC_device &instance = adcList[device];
+	if (instance.sampling) { return false; } // Can't change oversampling while sampling.
+	if (ratio == 0) { return false; }
+	
+#if defined ADC_CFGR2_ROVSE
+	if (ratio == 1) {
+		instance.regs->CFGR2 &= ~ADC_CFGR2_ROVSE;
+		instance.ovsRatio = 1;
+		return true;
+	}
+	
+	// OVSR is log2(ratio) - 1.
+	uint32_t ovsr = 0;
+	while ((2U << ovsr) < ratio) { ovsr++; }
+	if ((2U << ovsr) != ratio || ovsr > 7 || shift > 8) { return false; }
+	
+	instance.regs->CFGR2 = (instance.regs->CFGR2 & ~(ADC_CFGR2_OVSR | ADC_CFGR2_OVSS)) |
+							(ovsr << ADC_CFGR2_OVSR_Pos) | ((uint32_t) shift << ADC_CFGR2_OVSS_Pos) |
+							ADC_CFGR2_ROVSE;
+	instance.ovsRatio = 1;
+#else
+	// The sum of 'ratio' 12-bit samples has to fit in 16 bits after the shift.
+	if (ratio > 4096 || ((4095UL * ratio) >> shift) > 0xFFFF) { return false; }
+	
+	instance.ovsRatio = ratio;
+	instance.ovsShift = shift;
+#endif
+	
+	return true;
+}
+
+
 // --- ENABLE INTERRUPT ---
 //
 bool ADC::enableInterrupt(ADC_devices device, ADC_interrupts isr) {
@@ -698,6 +774,141 @@ bool ADC::disableInterrupts(ADC_devices device) {
 }
 	
 
+#ifdef NODATE_TIMER_ENABLED
+
+// --- TIMER TRIGGERS ---
+// The external trigger (EXTSEL) values selecting the TRGO output of a timer, per family.
+struct ADC_trigger_mapping {
+	ADC_devices device;
+	TimerDevice timer;
+	uint8_t extsel;
+};
+
+static const ADC_trigger_mapping adcTriggerMappings[] = {
+#if defined __stm32f0
+	{ ADC_1, TIMER_1, 0 },
+	{ ADC_1, TIMER_2, 2 },
+	{ ADC_1, TIMER_3, 3 },
+#elif defined __stm32f1
+	{ ADC_1, TIMER_3, 4 },
+	{ ADC_2, TIMER_3, 4 },
+	{ ADC_3, TIMER_8, 4 },
+#elif defined __stm32f4
+	{ ADC_1, TIMER_2, 6 },
+	{ ADC_1, TIMER_3, 8 },
+	{ ADC_1, TIMER_8, 14 },
+	{ ADC_2, TIMER_2, 6 },
+	{ ADC_2, TIMER_3, 8 },
+	{ ADC_2, TIMER_8, 14 },
+	{ ADC_3, TIMER_2, 6 },
+	{ ADC_3, TIMER_3, 8 },
+	{ ADC_3, TIMER_8, 14 },
+#endif
+	{ ADC_1, TIMER_1, 0xFF }	// End of table.
+};
+
+
+#if defined __stm32f1 || defined __stm32f4
+// Returns the ADC clock: PCLK2 divided by the ADCPRE prescaler (2, 4, 6 or 8).
+static uint32_t adcClock() {
+	uint32_t presc = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE2_Msk) >> RCC_CFGR_PPRE2_Pos)];
+	uint32_t pclk2 = Clock::currentSysClock() >> presc;
+#if defined __stm32f1
+	uint32_t adcpre = (RCC->CFGR & RCC_CFGR_ADCPRE_Msk) >> RCC_CFGR_ADCPRE_Pos;
+#else
+	ADC_Common_TypeDef* regs = (ADC_Common_TypeDef*) ADC_BASE;
+	uint32_t adcpre = (regs->CCR & ADC_CCR_ADCPRE_Msk) >> ADC_CCR_ADCPRE_Pos;
+#endif
+	
+	return pclk2 / ((adcpre + 1) * 2);
+}
+#endif
+
+
+// --- SET TIMER TRIGGER ---
+// Trigger conversions from the update event of a timer, running at 'rate' Hz. Each trigger
+// converts one frame (the whole sequence in scan mode), so continuous mode is disabled. The timer
+// is started by startSampling() or startScan(), and stopped by stop(). The achieved rate and the
+// jitter of the sampling instant are returned in 'achieved': up to one ADC clock cycle, as the
+// trigger is synchronised to the ADC clock. On F1/F4 it is zero if the trigger period is a whole
+// number of ADC clock cycles, as the sampling instant then keeps a fixed offset.
+bool ADC::setTimerTrigger(ADC_devices device, TimerDevice timer, uint32_t rate, 
+																	ADC_rate &achieved) {
+	ADC_device &instance = adcList[device];
+	if (!instance.active) { return false; }
+	if (instance.sampling) { return false; }
+	
+	const ADC_trigger_mapping* m = adcTriggerMappings;
+	for (; m->extsel != 0xFF; ++m) {
+		if (m->device == device && m->timer == timer) { break; }
+	}
+	
+	if (m->extsel == 0xFF) { return false; } // Timer can't trigger this ADC.
+	
+	if (!Timer::setFrequency(timer, rate)) { return false; }
+	if (!Timer::setTrigger(timer, TIMER_TRGO_UPDATE)) { return false; }
+	
+#if defined __stm32f0
+	// Rising edge of the selected trigger.
+	instance.regs->CFGR1 &= ~(ADC_CFGR1_CONT | ADC_CFGR1_EXTSEL | ADC_CFGR1_EXTEN);
+	instance.regs->CFGR1 |= ((uint32_t) m->extsel << ADC_CFGR1_EXTSEL_Pos) | ADC_CFGR1_EXTEN_0;
+	achieved.jitter = (1000000000 + 13999999) / 14000000;
+#elif defined __stm32f1
+	instance.regs->CR2 &= ~(ADC_CR2_CONT | ADC_CR2_EXTSEL);
+	instance.regs->CR2 |= ((uint32_t) m->extsel << ADC_CR2_EXTSEL_Pos) | ADC_CR2_EXTTRIG;
+#elif defined __stm32f4
+	// Rising edge of the selected trigger.
+	instance.regs->CR2 &= ~(ADC_CR2_CONT | ADC_CR2_EXTSEL | ADC_CR2_EXTEN);
+	instance.regs->CR2 |= ((uint32_t) m->extsel << ADC_CR2_EXTSEL_Pos) | ADC_CR2_EXTEN_0;
+#endif
+	
+#if defined __stm32f1 || defined __stm32f4
+	// The timer clock can run at twice PCLK2, or from PCLK1, so the ADC clock phase at each
+	// trigger only repeats if the period is a whole number of ADC clock cycles.
+	uint32_t adcClk = adcClock();
+	if ((Timer::getPeriod(timer) * adcClk) % Timer::clock(timer) == 0) { achieved.jitter = 0; }
+	else { achieved.jitter = (1000000000 + adcClk - 1) / adcClk; }
+#endif
+	
+	// Achieved rate in µHz, for the deviation in ppm.
+	uint64_t period = Timer::getPeriod(timer);
+	uint64_t actual = ((uint64_t) Timer::clock(timer) * 1000000 + period / 2) / period;
+	achieved.frequency = Timer::getFrequency(timer);
+	achieved.error = (int32_t) (((int64_t) actual - (int64_t) rate * 1000000) / (int64_t) rate);
+	
+	instance.timer = timer;
+	instance.timerTrigger = true;
+	
+	return true;
+}
+
+
+// --- CLEAR TIMER TRIGGER ---
+// Return to conversions started by software, in single mode.
+bool ADC::clearTimerTrigger(ADC_devices device) {
+	ADC_device &instance = adcList[device];
+	if (!instance.active) { return false; }
+	if (instance.sampling) { return false; }
+	if (!instance.timerTrigger) { return true; }
+	
+	Timer::stop(instance.timer);
+	
+#if defined __stm32f0
+	instance.regs->CFGR1 &= ~(ADC_CFGR1_EXTSEL | ADC_CFGR1_EXTEN);
+#elif defined __stm32f1
+	instance.regs->CR2 |= ADC_CR2_EXTSEL | ADC_CR2_EXTTRIG;
+#elif defined __stm32f4
+	instance.regs->CR2 &= ~(ADC_CR2_EXTSEL | ADC_CR2_EXTEN);
+#endif
+	
+	instance.timerTrigger = false;
+	
+	return true;
+}
+
+#endif
+
+
 // --- START ---
 // Start the ADC device.
 bool ADC::start(ADC_devices device) {
@@ -741,22 +952,33 @@ bool ADC::startSampling(ADC_devices device) {
 	if (!instance.calibrated) { return false; }
 	
 #if defined __stm32f0 || defined __stm32f3
-	// Start sampling.
+	// Start sampling. With a hardware trigger this arms the ADC instead.
 	instance.regs->CR |= ADC_CR_ADSTART;
 	
 	instance.sampling = true;
-	
-	return true;
 #elif defined __stm32f4 || defined __stm32f1
-	// Start sampling.
+	// Start sampling. With a hardware trigger the ADC is already waiting for it.
+#ifdef NODATE_TIMER_ENABLED
+	if (!instance.timerTrigger) {
+		instance.regs->CR2 |= ADC_CR2_SWSTART;
+	}
+#else
 	instance.regs->CR2 |= ADC_CR2_SWSTART;
+#endif
 	
 	instance.sampling = true;
-	
-	return true;
 #else
 	return false;
 #endif
+	
+#ifdef NODATE_TIMER_ENABLED
+	// Start triggering once the ADC is ready for it.
+	if (instance.timerTrigger) {
+		if (!Timer::start(instance.timer)) { return false; }
+	}
+#endif
+	
+	return true;
 }
 
 
@@ -811,6 +1033,12 @@ bool ADC::stop(ADC_devices device) {
 	if (!instance.active) { return false; }
 	if (!instance.calibrated) { return false; }
 	
+#ifdef NODATE_TIMER_ENABLED
+	if (instance.timerTrigger) {
+		Timer::stop(instance.timer);
+	}
+#endif
+	
 #if defined __stm32f0 || defined __stm32f3
 	instance.regs->CR |= ADC_CR_ADSTP;
 	uint32_t timeout = 400; // TODO: make configurable.
@@ -846,30 +1074,50 @@ bool ADC::stop(ADC_devices device) {
 
 #ifdef NODATE_DMA_ENABLED
 
-// --- CONFIGURE DMA ---
-bool ADC::configureDMA(ADC_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb) {
-	ADC_device &instance = adcList[device];
-	if (!instance.active) { return false; }
-	if (!instance.calibrated) { return false; }
-	
-#ifdef __stm32f0
-	// Enable DMA transfer on ADC and circular mode.
-	instance.regs->CFGR1 |= ADC_CFGR1_DMAEN | ADC_CFGR1_DMACFG;
+// --- SEQUENCE LENGTH ---
+// Returns the number of channels in the regular sequence.
+static uint8_t adcSequenceLength(ADC_device &instance) {
+#if defined __stm32f0
+	return __builtin_popcount(instance.regs->CHSELR & 0x7FFFF);
+#else
+	return instance.conversions;
+#endif
+}
+
+
+// --- DMA START ---
+// Acquire a DMA channel and configure it for a circular transfer of 'count' samples from the data
+// register into 'buffer', then enable the DMA requests of the ADC in circular mode.
+static bool adcDmaStart(ADC_device &instance, uint16_t* buffer, uint16_t count, DMA_callbacks cb) {
+#if defined __stm32f0 || defined __stm32f1 || defined __stm32f4
+	if (!DMA::acquire(instance.per, DMA_DIR_RX, instance.dma)) { return false; }
 	
 	DMA_config cfg;
-	cfg.channel = 1;
+	cfg.channel = instance.dma.channel;
+	cfg.request = instance.dma.request;
 	cfg.source = (uint32_t*) &(instance.regs->DR);
-	cfg.target = buffer;
+	cfg.target = (uint32_t*) buffer;
 	cfg.prio = DMA_PRIO_MEDIUM;
 	cfg.count = count;
 	cfg.src_size = 2;
 	cfg.des_size = 2;
 	cfg.circular = true;
 	cfg.src_incr = false;
-	cfg.des_incr = false;
-	DMA::configureChannel(DMA_1, cfg, cb);
+	cfg.des_incr = true;
+	if (!DMA::configureChannel(instance.dma.device, cfg, cb)) {
+		DMA::release(instance.dma);
+		return false;
+	}
 	
-	DMA::start(DMA_1);
+#if defined __stm32f0
+	// Enable DMA transfer on ADC and circular mode.
+	instance.regs->CFGR1 |= ADC_CFGR1_DMAEN | ADC_CFGR1_DMACFG;
+#elif defined __stm32f1
+	instance.regs->CR2 |= ADC_CR2_DMA;
+#else
+	// DDS keeps the DMA requests going after the last transfer, for circular mode.
+	instance.regs->CR2 |= ADC_CR2_DMA | ADC_CR2_DDS;
+#endif
 	
 	return true;
 #else
@@ -878,20 +1126,140 @@ bool ADC::configureDMA(ADC_devices device, uint32_t* buffer, uint16_t count, DMA
 }
 
 
+// --- CONFIGURE DMA ---
+bool ADC::configureDMA(ADC_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb) {
+	ADC_device &instance = adcList[device];
+	if (!instance.active) { return false; }
+	if (!instance.calibrated) { return false; }
+	
+	return adcDmaStart(instance, (uint16_t*) buffer, count, cb);
+}
+
+
 // --- STOP DMA ---
 // Terminate DMA transfer.
 bool ADC::stopDMA(ADC_devices device) {
 	ADC_device &instance = adcList[device];
 	if (!instance.active) { return false; }
+	if (!instance.dma.valid) { return false; }
 	
-#ifdef __stm32f0
+#if defined __stm32f0
 	instance.regs->CFGR1 &= ~ADC_CFGR1_DMAEN;
-	DMA::abort(DMA_1, 1);
+#elif defined __stm32f1
+	instance.regs->CR2 &= ~ADC_CR2_DMA;
+#elif defined __stm32f4
+	instance.regs->CR2 &= ~(ADC_CR2_DMA | ADC_CR2_DDS);
+#endif
+	DMA::abort(instance.dma.device, instance.dma.channel);
+	DMA::release(instance.dma);
+	
+	return true;
+}
+
+
+// --- DECIMATE ---
+// Sums each group of 'ratio' frames per channel (boxcar filter) and shifts the sums into one
+// output frame. The output frames are written in place, at the start of 'samples'. Returns the
+// number of output frames.
+static uint16_t adcDecimate(uint16_t* samples, uint16_t frames, uint8_t channels, uint16_t ratio,
+																			uint8_t shift) {
+	uint32_t acc[19];
+	const uint16_t* in = samples;
+	uint16_t* out = samples;
+	uint16_t outFrames = frames / ratio;
+	for (uint16_t i = 0; i < outFrames; ++i) {
+		for (uint8_t c = 0; c < channels; ++c) { acc[c] = *in++; }
+		for (uint16_t j = 1; j < ratio; ++j) {
+			for (uint8_t c = 0; c < channels; ++c) { acc[c] += *in++; }
+		}
+		
+		// The input of this group has been read completely, so overwriting it is safe.
+		for (uint8_t c = 0; c < channels; ++c) { *out++ = (uint16_t) (acc[c] >> shift); }
+	}
+	
+	return outFrames;
+}
+
+
+// --- SCAN CALLBACKS ---
+// Passes the half of the scan buffer which DMA just finished on to the application, after
+// software oversampling if enabled.
+static void adcScanDone(ADC_device &instance, uint16_t* samples, ADC_scan_cb cb) {
+	if (!cb) { return; }
+	
+	uint16_t frames = instance.scanFrames / 2;
+	if (instance.ovsRatio > 1) {
+		frames = adcDecimate(samples, frames, instance.scanChannels, instance.ovsRatio,
+															instance.ovsShift);
+	}
+	
+	cb(samples, frames);
+}
+
+// DMA callbacks, with the ADC as context.
+static void adcScanHalf(void* ctx) {
+	ADC_device &instance = *((ADC_device*) ctx);
+	adcScanDone(instance, instance.scanBuffer, instance.scanHalf);
+}
+
+static void adcScanFull(void* ctx) {
+	ADC_device &instance = *((ADC_device*) ctx);
+	uint16_t half = instance.scanFrames / 2;
+	adcScanDone(instance, instance.scanBuffer + (half * instance.scanChannels), instance.scanFull);
+}
+
+
+// --- START SCAN ---
+// Start converting the channel sequence into the circular 'buffer' of 'frames' frames, with one
+// sample per channel per frame (frames * channels samples). 'half' is called once the first half
+// of the frames has been filled and 'full' for the second half, while DMA continues in the other
+// half. In continuous mode the scans run back-to-back, in single mode each startSampling() call
+// converts one frame. With software oversampling each half is decimated first, and has to hold a
+// multiple of the oversampling ratio in frames. The ADC has to be started with start() first.
+bool ADC::startScan(ADC_devices device, uint16_t* buffer, uint16_t frames, ADC_scan_cb half,
+																			ADC_scan_cb full) {
+	ADC_device &instance = adcList[device];
+	if (!instance.active) { return false; }
+	if (!instance.calibrated) { return false; }
+	if (instance.sampling) { return false; }
+	
+	// An even number of frames keeps both halves frame-aligned.
+	uint8_t channels = adcSequenceLength(instance);
+	if (channels == 0 || frames < 2 || (frames & 1) != 0) { return false; }
+	if ((uint32_t) frames * channels > 0xFFFF) { return false; }
+	if (((frames / 2) % instance.ovsRatio) != 0) { return false; }
+	
+	instance.scanBuffer = buffer;
+	instance.scanFrames = frames;
+	instance.scanChannels = channels;
+	instance.scanHalf = half;
+	instance.scanFull = full;
+	
+	DMA_callbacks cb;
+	cb.half = adcScanHalf;
+	cb.filled = adcScanFull;
+	cb.ctx = &instance;
+	if (!adcDmaStart(instance, buffer, frames * channels, cb)) { return false; }
+	
+	return startSampling(device);
+}
+
+
+// --- STOP SCAN ---
+// Stop the scan and its DMA transfer. This stops the ADC, which has to be started again with
+// start() before the next conversion.
+bool ADC::stopScan(ADC_devices device) {
+	ADC_device &instance = adcList[device];
+	if (!instance.active) { return false; }
+	
+	if (!stop(device)) { return false; }
+	stopDMA(device);
+	
+	instance.sampling = false;
+	instance.scanHalf = 0;
+	instance.scanFull = 0;
 	
 	return true;
-#else
-	return false;
-#endif
 }
 
 #endif
@@ -0,0 +1,239 @@
+/*
+	bus.cpp - Implementation of the shared bus module.
+*/
+
+
+#ifdef NODATE_BUS_ENABLED
+
+
+#include <bus.h>
+
+#ifdef NODATE_CMSIS_RTOS_ENABLED
+#include <cmsis_os.h>
+#endif
+
+
+// Physical buses: SPI_1 - SPI_5, followed by I2C_1 - I2C_3.
+const uint8_t bus_count = 8;
+const uint8_t bus_i2c_first = 5;
+
+
+struct Bus_state {
+	Bus_transaction* queue[bus_queue_size];
+	uint8_t head = 0;
+	uint8_t tail = 0;
+	volatile bool busy = false;
+#ifdef NODATE_CMSIS_RTOS_ENABLED
+	osMutexId mutex = 0;
+#endif
+};
+
+
+static Bus_device busDevices[bus_device_max];
+static Bus_state busStates[bus_count];
+
+#ifdef NODATE_CMSIS_RTOS_ENABLED
+osMutexDef(BusMutex);
+#endif
+
+
+// --- ADD DEVICE ---
+// Registers the device on its bus. Returns the handle of the new device in 'handle'.
+static bool busAddDevice(Bus_device &device, uint8_t &handle) {
+	for (uint8_t i = 0; i < bus_device_max; ++i) {
+		if (busDevices[i].active) { continue; }
+		
+#ifdef NODATE_CMSIS_RTOS_ENABLED
+		// Create the bus mutex with the first device, as this is not allowed from an interrupt.
+		Bus_state &state = busStates[device.bus];
+		if (state.mutex == 0) {
+			state.mutex = osMutexCreate(osMutex(BusMutex));
+			if (state.mutex == 0) { return false; }
+		}
+#endif
+		
+		device.active = true;
+		busDevices[i] = device;
+		handle = i;
+		return true;
+	}
+	
+	return false;
+}
+
+
+// --- ADD SPI DEVICE ---
+// Registers a slave on an SPI bus which has been started with SPI::startSPIMaster(). The bus
+// settings in 'config' are applied before each transaction with this device. The chip select
+// pin is configured as output and set high (inactive).
+bool Bus::addSpiDevice(SPI_devices device, GpioPinDef cs, SPI_config config, uint8_t &handle) {
+	if (!GPIO::set_output(cs, GPIO_PULL_UP, GPIO_PUSH_PULL, GPIO_HIGH)) { return false; }
+	if (!GPIO::write(cs, GPIO_LEVEL_HIGH)) { return false; }
+	
+	Bus_device item;
+	item.type = BUS_SPI;
+	item.bus = (uint8_t) device;
+	item.spi = device;
+	item.config = config;
+	item.cs = cs;
+	
+	return busAddDevice(item, handle);
+}
+
+
+// --- ADD I2C DEVICE ---
+// Registers a slave with the given 7-bit address on an I2C bus which has been started in master
+// mode.
+bool Bus::addI2cDevice(I2C_devices device, uint8_t address, uint8_t &handle) {
+	Bus_device item;
+	item.type = BUS_I2C;
+	item.bus = bus_i2c_first + (uint8_t) device;
+	item.i2c = device;
+	item.address = address;
+	
+	return busAddDevice(item, handle);
+}
+
+
+// --- EXECUTE ---
+// Performs all steps of the transaction, then calls the callback. The caller owns the bus.
+void Bus::execute(Bus_transaction &transaction) {
+	Bus_device &device = busDevices[transaction.device];
+	bool ok = true;
+	if (device.type == BUS_SPI) {
+#ifdef NODATE_SPI_ENABLED
+		ok = SPI::configure(device.spi, device.config);
+		if (ok) { GPIO::write(device.cs, GPIO_LEVEL_LOW); }
+		for (uint8_t i = 0; ok && i < transaction.count; ++i) {
+			Bus_step &step = transaction.steps[i];
+			if (step.op == BUS_WRITE) 	{ ok = SPI::sendData(device.spi, step.data, step.len); }
+			else 						{ ok = SPI::receiveData(device.spi, step.data, step.len); }
+		}
+		
+		GPIO::write(device.cs, GPIO_LEVEL_HIGH);
+#else
+		ok = false;
+#endif
+	}
+	else {
+#ifdef NODATE_I2C_ENABLED
+		ok = I2C::setSlaveTarget(device.i2c, device.address);
+		for (uint8_t i = 0; ok && i < transaction.count; ++i) {
+			Bus_step &step = transaction.steps[i];
+			if (step.op == BUS_WRITE && (i + 1) < transaction.count && 
+											transaction.steps[i + 1].op == BUS_READ) {
+				// Use a repeated START between a write and a read, as devices may reset their
+				// register pointer on STOP.
+				Bus_step &read = transaction.steps[++i];
+				ok = I2C::transfer(device.i2c, device.address, step.data, step.len, read.data, 
+																				read.len);
+			}
+			else if (step.op == BUS_WRITE) 	{ ok = I2C::sendToSlave(device.i2c, step.data, step.len); }
+			else 							{ ok = I2C::receiveFromSlave(device.i2c, step.len, step.data); }
+		}
+#else
+		ok = false;
+#endif
+	}
+	
+	transaction.ok = ok;
+	transaction.done = true;
+	if (transaction.cb) { transaction.cb(&transaction); }
+}
+
+
+// --- SUBMIT ---
+// Submits the transaction for execution. Returns false if the transaction is invalid or the
+// queue is full.
+// Without an RTOS, the transaction is executed right away if the bus is free, along with any
+// transactions which get queued in the meantime. Otherwise it is queued, and executed once the
+// current user of the bus is done. Check 'done' or use the callback to find out when.
+// With the CMSIS-RTOS library, this blocks until the bus is free and the transaction is done.
+bool Bus::submit(Bus_transaction &transaction) {
+	if (transaction.device >= bus_device_max) { return false; }
+	Bus_device &device = busDevices[transaction.device];
+	if (!device.active) { return false; }
+	
+	Bus_state &state = busStates[device.bus];
+	transaction.done = false;
+	transaction.ok = false;
+	
+#ifdef NODATE_CMSIS_RTOS_ENABLED
+	if (osMutexWait(state.mutex, osWaitForever) != osOK) { return false; }
+	execute(transaction);
+	osMutexRelease(state.mutex);
+	
+	return true;
+#else
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint8_t tail = (state.tail + 1) % bus_queue_size;
+	if (tail == state.head) {
+		__set_PRIMASK(primask);
+		return false;
+	}
+	
+	state.queue[state.tail] = &transaction;
+	state.tail = tail;
+	if (state.busy) {
+		// Queued. The current user of the bus will execute it.
+		__set_PRIMASK(primask);
+		return true;
+	}
+	
+	state.busy = true;
+	__set_PRIMASK(primask);
+	
+	// Execute queued transactions back to back, until the queue is empty.
+	while (true) {
+		primask = __get_PRIMASK();
+		__disable_irq();
+		if (state.head == state.tail) {
+			state.busy = false;
+			__set_PRIMASK(primask);
+			break;
+		}
+		
+		Bus_transaction* queued = state.queue[state.head];
+		state.head = (state.head + 1) % bus_queue_size;
+		__set_PRIMASK(primask);
+		
+		execute(*queued);
+	}
+	
+	return true;
+#endif
+}
+
+
+// --- TRANSACT ---
+// Submits the transaction and waits for it to complete. Returns true if all steps succeeded.
+// Do not call this from an interrupt.
+bool Bus::transact(Bus_transaction &transaction) {
+	if (!submit(transaction)) { return false; }
+	while (!transaction.done) { }
+	
+	return transaction.ok;
+}
+
+
+// --- WRITE READ ---
+// Sends 'txlen' bytes (e.g. a register address), then receives 'rxlen' bytes, as one
+// transaction. Either length can be zero.
+bool Bus::writeRead(uint8_t handle, uint8_t* txdata, uint16_t txlen, 
+														uint8_t* rxdata, uint16_t rxlen) {
+	Bus_step steps[2];
+	uint8_t count = 0;
+	if (txlen > 0) 	{ steps[count].op = BUS_WRITE; steps[count].data = txdata; steps[count++].len = txlen; }
+	if (rxlen > 0) 	{ steps[count].op = BUS_READ; steps[count].data = rxdata; steps[count++].len = rxlen; }
+	
+	Bus_transaction transaction;
+	transaction.device = handle;
+	transaction.steps = steps;
+	transaction.count = count;
+	
+	return transact(transaction);
+}
+
+
+#endif
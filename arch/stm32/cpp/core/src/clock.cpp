@@ -450,6 +450,13 @@ bool Clock::enableMaxClock() {
 }
 
 
+// --- CURRENT SYSCLOCK ---
+// Returns the current core (AHB) clock frequency in Hz.
+uint32_t Clock::currentSysClock() {
+	return SystemCoreClock;
+}
+
+
 // --- ENABLE LSE ---
 // Switch from LSI to LSE if available.
 bool Clock::enableLSE() {
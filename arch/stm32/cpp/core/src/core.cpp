@@ -14,6 +14,114 @@ bool McuCore::systick_active = false;
 __IO uint32_t McuCore::uwTick;
 uint32_t McuCore::uwTickPrio = (1UL << __NVIC_PRIO_BITS);
 uint32_t McuCore::uwTickFreq = 1; // 1 KHz
+__IO uint32_t McuCore::uwTickWraps = 0;
+uint32_t McuCore::cyclesHigh = 0;
+uint32_t McuCore::cyclesLast = 0;
+
+
+// --- TICKLESS ---
+// In tickless mode the SysTick period is stretched to the next deadline (or its maximum while
+// idle), instead of interrupting every tick. The tick count is then advanced by the whole period
+// in the interrupt, and in between derived from the SysTick counter value.
+static bool tickless = false;
+static bool sleeping = false;		// In sleep() or idle().
+static bool deadlineSet = false;
+static uint32_t tickDeadline = 0;
+static uint32_t tickCycles = 0;		// SysTick cycles per tick.
+static uint32_t tickMax = 1;		// Longest SysTick period in ticks.
+static uint32_t tickPeriod = 1;		// Ticks in the running SysTick period.
+static uint32_t tickNext = 1;		// Ticks in the period after, as set in LOAD.
+
+static uint32_t sysTickMargin = 1024;	// Cycles needed to reprogram the counter before it reloads.
+
+static void (*tickCallback)() = 0;		// Called at the end of each SysTick interrupt.
+
+
+// Advance the tick count by 'ticks', counting wraps of the 32-bit count.
+static void tickAdvance(uint32_t ticks) {
+	uint32_t before = McuCore::uwTick;
+	McuCore::uwTick = before + ticks;
+	if (McuCore::uwTick < before) { McuCore::uwTickWraps++; }
+}
+
+
+// Returns the 64-bit tick count at the start of the running SysTick period and the cycles since
+// in 'elapsed'. A period which ended before the interrupt ran is accounted for. Interrupts have to
+// be disabled.
+static uint64_t sysTickNow(uint32_t &elapsed) {
+	uint64_t ticks = ((uint64_t) McuCore::uwTickWraps << 32) | McuCore::uwTick;
+	bool before = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+	uint32_t val = SysTick->VAL;
+	bool after = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+	if (!after) {
+		elapsed = tickPeriod * tickCycles - 1 - val;
+		return ticks;
+	}
+	
+	// The counter reloaded, either before reading it or just after.
+	if (!before) { val = SysTick->VAL; }
+	elapsed = SysTick->LOAD - val;
+	
+	return ticks + tickPeriod;
+}
+
+
+// Returns the length of the period following the running one, in ticks. While sleeping that's up
+// to the deadline or the longest period, otherwise a single tick.
+static uint32_t sysTickNextPeriod() {
+	if (!tickless) { return 1; }
+	
+	uint32_t end = McuCore::uwTick + tickPeriod;
+	if (deadlineSet) {
+		int32_t left = (int32_t) (tickDeadline - end);
+		if (left < 1) { return 1; }
+		
+		return ((uint32_t) left < tickMax) ? (uint32_t) left : tickMax;
+	}
+	
+	return sleeping ? tickMax : 1;
+}
+
+
+// Restart the running SysTick period if it has to end at another tick: at the deadline, at the
+// longest period while sleeping, or after the current tick outside of tickless mode. Then set the
+// length of the next period. Interrupts have to be disabled.
+static void sysTickSchedule() {
+	uint32_t val = SysTick->VAL;
+	if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0 || val < sysTickMargin) {
+		return; // The period ends right away, the interrupt schedules again.
+	}
+	
+	uint32_t elapsed = tickPeriod * tickCycles - 1 - val;
+	uint32_t done = elapsed / tickCycles;
+	uint32_t offset = elapsed - (done * tickCycles);
+	
+	// Ticks from the current tick until the running period ends, and until it has to end.
+	uint32_t left = tickPeriod - done;
+	uint32_t target = left;
+	if (!tickless) { target = 1; }
+	else {
+		if (sleeping) { target = tickMax; }
+		if (deadlineSet) {
+			int32_t d = (int32_t) (tickDeadline - (McuCore::uwTick + done));
+			if (d < (int32_t) target) { target = (d < 1) ? 1 : (uint32_t) d; }
+		}
+	}
+	
+	if (target == 1 && (tickCycles - offset) < sysTickMargin) { target = 2; }
+	
+	if (target != left) {
+		// Restart the counter for the remaining cycles. It reloads from LOAD after writing VAL.
+		tickAdvance(done);
+		tickPeriod = target;
+		SysTick->LOAD = (target * tickCycles) - 1 - offset;
+		SysTick->VAL = 0;
+		while (SysTick->VAL == 0) { }
+	}
+	
+	tickNext = sysTickNextPeriod();
+	SysTick->LOAD = (tickNext * tickCycles) - 1;
+}
 
 
 // SysTick interrupt handler
@@ -22,7 +130,17 @@ extern "C" {
 }
 
 void SysTick_Handler() {
-	McuCore::uwTick++;
+	tickAdvance(tickPeriod);
+	tickPeriod = tickNext;
+	if (deadlineSet && (int32_t) (McuCore::uwTick - tickDeadline) >= 0) { deadlineSet = false; }
+	if (tickless || tickPeriod != 1 || tickNext != 1) { sysTickSchedule(); }
+	
+#if (__CORTEX_M >= 3)
+	// Reading the cycle counter every tick ensures that no wrap of CYCCNT is missed.
+	McuCore::getCycles();
+#endif
+	
+	if (tickCallback) { tickCallback(); }
 }
 
 
@@ -36,6 +154,12 @@ bool McuCore::initSysTick(uint32_t tickPriority) {
 		return false; // Reload value impossible.
 	}
 
+	tickCycles = ticks;
+	tickMax = (SysTick_LOAD_RELOAD_Msk + 1) / ticks;
+	sysTickMargin = (ticks / 4 < 1024) ? ticks / 4 : 1024;
+	tickPeriod = 1;
+	tickNext = 1;
+	
 	SysTick->LOAD  = (uint32_t) (ticks - 1UL);			// set reload register
 	NVIC_SetPriority (SysTick_IRQn, (1UL << __NVIC_PRIO_BITS) - 1UL); // set Priority for Systick interrupt
 	SysTick->VAL   = 0UL;                                             // Load the SysTick Counter Value
@@ -53,6 +177,24 @@ bool McuCore::initSysTick(uint32_t tickPriority) {
 		return false;
 	}
 	
+#if (__CORTEX_M >= 3)
+	// Start the DWT cycle counter for the timestamps.
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if (__CORTEX_M == 7)
+	DWT->LAR = 0xC5ACCE55;	// Unlock the DWT registers.
+#endif
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	
+	// CYCCNT runs on the core clock, which is gated in Sleep mode. Keep the core clock running
+	// during WFI in sleep() and idle(), so that the timestamps keep tracking real time. This costs
+	// some power in Sleep mode, but keeps the cycle count exact, where resyncing it from the
+	// tick count after each wake-up would not.
+	DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP;
+	cyclesHigh = 0;
+	cyclesLast = 0;
+#endif
+	
 	systick_active = true;
 
 	return true;
@@ -68,6 +210,187 @@ bool McuCore::stopSysTick() {
 }
 
 
+// --- GET SYSTICK ---
+// Returns the tick count. In tickless mode it's derived from the SysTick counter, as the tick count
+// is only advanced at the end of each period.
 uint32_t McuCore::getSysTick() {
-	return uwTick;
+	if (!tickless) { return uwTick; }
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	uint32_t elapsed;
+	uint32_t ticks = (uint32_t) sysTickNow(elapsed);
+	
+	__set_PRIMASK(primask);
+	
+	return ticks + (elapsed / tickCycles);
+}
+
+
+// --- SET TICKLESS ---
+// Enable or disable tickless mode. Outside of tickless mode SysTick interrupts every tick.
+bool McuCore::setTickless(bool enable) {
+	if (!systick_active) { return false; }
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	tickless = enable;
+	sysTickSchedule();
+	
+	__set_PRIMASK(primask);
+	
+	return true;
+}
+
+
+// --- REQUEST TICK ---
+// In tickless mode, ensure a SysTick interrupt at the given tick, e.g. to wake up the core. Only
+// the earliest requested tick is kept until it has passed.
+void McuCore::requestTick(uint32_t tick) {
+	if (!tickless) { return; }
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if (!deadlineSet || (int32_t) (tick - tickDeadline) < 0) {
+		tickDeadline = tick;
+		deadlineSet = true;
+		sysTickSchedule();
+	}
+	
+	__set_PRIMASK(primask);
+}
+
+
+// Busy-wait for the given number of ticks by following the SysTick counter, for when interrupts
+// are disabled and the tick count doesn't advance.
+static void sysTickSpin(uint32_t ticks) {
+	uint64_t left = (uint64_t) ticks * tickCycles;
+	uint32_t last = SysTick->VAL;
+	while (left > 0) {
+		uint32_t val = SysTick->VAL;
+		uint32_t passed = (val <= last) ? last - val : last + (SysTick->LOAD + 1) - val;
+		last = val;
+		left = (passed < left) ? left - passed : 0;
+	}
+}
+
+
+// --- SLEEP ---
+// Sleep (WFI) for the given number of ticks (ms). Other interrupts are handled in between. In
+// tickless mode SysTick only wakes the core up at the end. Called with interrupts disabled, it
+// busy-waits instead and leaves them disabled.
+void McuCore::sleep(uint32_t ms) {
+	uint32_t primask = __get_PRIMASK();
+	if (primask != 0) {
+		sysTickSpin(ms);
+		return;
+	}
+	
+	uint32_t start = getSysTick();
+	
+	// Interrupts stay disabled from the check until WFI, so that a wake-up can't be missed. WFI
+	// still returns on a pending interrupt, which is then handled after enabling interrupts.
+	__disable_irq();
+	sleeping = true;
+	while ((getSysTick() - start) < ms) {
+		requestTick(start + ms);
+		__WFI();
+		__enable_irq();
+		__disable_irq();
+	}
+	
+	sleeping = false;
+	if (tickless) { sysTickSchedule(); }
+	__set_PRIMASK(primask);
+}
+
+
+// --- IDLE ---
+// Sleep (WFI) until the next interrupt. In tickless mode SysTick only interrupts for a requested
+// tick, or at the end of its longest period. The interrupt is handled once interrupts are enabled,
+// which is on return unless they were disabled on entry.
+void McuCore::idle() {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	sleeping = true;
+	if (tickless) { sysTickSchedule(); }
+	
+	__WFI();
+	
+	sleeping = false;
+	if (tickless) { sysTickSchedule(); }
+	__set_PRIMASK(primask);
+}
+
+
+// --- SET TICK CALLBACK ---
+// Set a function to be called from the SysTick interrupt, after the tick count has been advanced.
+// In tickless mode that's only at the end of each period. Pass 0 to remove it.
+void McuCore::setTickCallback(void (*cb)()) {
+	tickCallback = cb;
+}
+
+
+// --- GET CYCLES ---
+// Returns the core clock cycles since initSysTick() as a monotonic 64-bit count. M3/M4/M7 extend
+// the 32-bit DWT cycle counter, which keeps counting in Sleep mode as DBG_SLEEP is set. M0
+// combines the tick count with the SysTick counter value.
+uint64_t McuCore::getCycles() {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+#if (__CORTEX_M >= 3)
+	uint32_t now = DWT->CYCCNT;
+	if (now < cyclesLast) { cyclesHigh++; }
+	cyclesLast = now;
+	uint64_t cycles = ((uint64_t) cyclesHigh << 32) | now;
+#else
+	uint32_t elapsed;
+	uint64_t ticks = sysTickNow(elapsed);
+	uint64_t cycles = (ticks * tickCycles) + elapsed;
+#endif
+	
+	__set_PRIMASK(primask);
+	
+	return cycles;
+}
+
+
+// --- CYCLES TO NS ---
+// Converts core clock cycles to nanoseconds, without overflowing the intermediate result.
+uint64_t McuCore::cyclesToNs(uint64_t cycles) {
+	uint32_t clk = SystemCoreClock;
+	
+	return (cycles / clk) * 1000000000ULL + ((cycles % clk) * 1000000000ULL) / clk;
+}
+
+
+// --- GET NANOSECONDS ---
+uint64_t McuCore::getNanoseconds() {
+	return cyclesToNs(getCycles());
+}
+
+
+// --- DELAY CYCLES ---
+// Busy-wait for at least the given number of core clock cycles.
+void McuCore::delayCycles(uint32_t cycles) {
+#if (__CORTEX_M >= 3)
+	uint32_t start = DWT->CYCCNT;
+	while ((DWT->CYCCNT - start) < cycles) { }
+#else
+	uint64_t start = getCycles();
+	while ((getCycles() - start) < cycles) { }
+#endif
+}
+
+
+// --- DELAY US ---
+// Busy-wait for at least the given number of microseconds.
+void McuCore::delayUs(uint32_t us) {
+	uint64_t cycles = ((uint64_t) us * SystemCoreClock + 999999) / 1000000;
+	uint64_t start = getCycles();
+	while ((getCycles() - start) < cycles) { }
 }
@@ -1,34 +1,37 @@
 /*
-	dac.cpp - Implementation file for the SPI class.
+	dac.cpp - Implementation file for the DAC class.
 */
 
 
 #include <dac.h>
 
 
-#ifdef NODATE_DAC_ENABLED
+// Only MCUs with a DAC have its register definitions.
+#if defined NODATE_DAC_ENABLED && defined DAC1
 
 
 const int dac_count = 3;
 
-// --- SPI DEVICES ---
-SPI_device* SPI_list() {
-	SPI_device item;
-	static SPI_device dac_devices[dac_count];
+// --- DAC DEVICES ---
+DAC_device* DAC_list() {
+	DAC_device item;
+	static DAC_device dac_devices[dac_count];
 	for (int i = 0; i < dac_count; ++i) {
 		dac_devices[i] = item;
 	}
 	
-#ifdef RCC_APB1ENR_DAC1EN
+#if defined RCC_APB1ENR_DAC1EN || defined RCC_APB1ENR_DACEN || defined RCC_APB1ENR1_DAC1EN
 	dac_devices[DAC_1].regs = DAC1;
+	dac_devices[DAC_1].per = RCC_DAC1;
 	//dac_devices[DAC_1].irqType = DAC1_IRQn;
 #endif
-
+	
 #ifdef RCC_APB1ENR_DAC2EN
 	dac_devices[DAC_2].regs = DAC2;
+	dac_devices[DAC_2].per = RCC_DAC2;
 	//dac_devices[DAC_2].irqType = DAC2_IRQn;
 #endif
-
+	
 #ifdef RCC_APB1ENR_DAC3EN
 	dac_devices[DAC_3].regs = DAC3;
 	//dac_devices[DAC_3].irqType = DAC3_IRQn;
@@ -41,16 +44,20 @@ SPI_device* SPI_list() {
 DAC_device* dacList = DAC_list();
 
 
+// The channel 2 bits in CR are the channel 1 bits, shifted by 16.
+static uint32_t dacChannelShift(DAC_channel ch) {
+	return (ch == DAC_CH_1) ? 0 : 16;
+}
+
+
 // --- START ---
 bool DAC::start(DAC_devices device, DAC_channel ch, DAC_ch_cfg ch_cfg) {
 	DAC_device &instance = dacList[device];
+	if (instance.regs == 0) { return false; } // DAC doesn't exist on this MCU.
 	
-	// Check status. Set parameters.
-	// TODO: set active status per channel.
-	if (instance.active) { return true; } // Already active.
-	if (device == DAC_1) 		{ instance.per = RCC_DAC1; }
-	else if (device == DAC_2)	{ instance.per = RCC_DAC2; }
-	//else if (device == DAC_3)	{ instance.per = RCC_DAC3; }
+	// Check status.
+	bool &chActive = (ch == DAC_CH_1) ? instance.ch1_active : instance.ch2_active;
+	if (chActive) { return true; } // Already active.
 	
 	// Enable the peripheral clock.
 	// Start DAC device if needed.
@@ -59,33 +66,33 @@ bool DAC::start(DAC_devices device, DAC_channel ch, DAC_ch_cfg ch_cfg) {
 			// TODO: set status.
 			return false;
 		}
+		
+		instance.active = true;
 	}
 	
-#ifdef STM32F3
+	// Analog mode disconnects the digital input buffer from the output pin.
+	if (!GPIO::set_analog(ch_cfg.pin.port, ch_cfg.pin.pin)) { return false; }
+	
 	// Channel should be inactive at this point so that it can be configured.
-	// TODO: allow configuration of a second channel (if present) and channel bonding.
+	// Without a trigger, data written to the data holding register is converted right away.
 	uint32_t creg = 0;
-	if (ch_cfg.triggerSource == DAC_TRIG_SOFTWARE) 		{ creg |= 7 << DAC_CR_TSEL1; }
-	else if (ch_cfg.triggerSource == DAC_TRIG_TIMER) 	{ 
-		creg |= ch_cfg.trigger << DAC_CR_TSEL1;
-	}
-	else if (ch_cfg.triggerSource == DAC_TRIG_EXT) {
-		creg |= ch_cfg.trigger << DAC_CR_TSEL1;
+	if (ch_cfg.triggerSource == DAC_TRIG_TIMER || ch_cfg.triggerSource == DAC_TRIG_EXT) {
+		creg |= DAC_CR_TEN1 | ((ch_cfg.trigger << DAC_CR_TSEL1_Pos) & DAC_CR_TSEL1_Msk);
 	}
 	
 	if (!ch_cfg.waveGen) {
 		// DAC_WAVEx: leave at default 0x00 to disable this feature.
-		
+	
 		// On F334 DAC1 CR[1] is BOFF1, on DAC2 it is OUTEN1.
 		// For channel 2 it is always OUTEN2.
 		// Leave at the default 0 to enable output buffering on DAC1_CH1.
-		
+	
 	}
 	else {
 		// Set wave type.
-		if (ch_cfg.waveGenCfg == DAC_WAVE_NOISE) 			{ creg |= 1 << DAC_CR_WAVE1; }
-		else if (ch_cfg.waveGenCfg == DAC_WAVE_TRIANGLE) 	{ creg |= 2 << DAC_CR_WAVE1; }
-		
+		if (ch_cfg.waveGenCfg == DAC_WAVE_NOISE) 			{ creg |= 1 << DAC_CR_WAVE1_Pos; }
+		else if (ch_cfg.waveGenCfg == DAC_WAVE_TRIANGLE) 	{ creg |= 2 << DAC_CR_WAVE1_Pos; }
+	
 		// TODO: Allow configuring of DAC_MAMP1.
 		// Leaving on b0000 for unmask bit 0 default (amplitude == 1).
 	}
@@ -93,37 +100,209 @@ bool DAC::start(DAC_devices device, DAC_channel ch, DAC_ch_cfg ch_cfg) {
 	// Enable the channel.
 	creg |= DAC_CR_EN1;
 	
-	instance.regs->CR = creg;
+	uint32_t shift = dacChannelShift(ch);
+	instance.regs->CR = (instance.regs->CR & ~(0xFFFFUL << shift)) | (creg << shift);
 	
+	chActive = true;
+	
+	return true;
+}
+
+
+// --- WRITE ---
+bool DAC::write(DAC_devices device, uint16_t data, DAC_channel ch) {
+	DAC_device &instance = dacList[device];
 	
-	instance.active = true;
+	// Check status.
+	if (ch == DAC_CH_1 && !instance.ch1_active) { return false; } // Unconfigured channel.
+	if (ch == DAC_CH_2 && !instance.ch2_active) { return false; }
 	
-#elif defined STM32F4
-	//
+	// Write the provided data as right-aligned 12-bit data (DAC_DHR12Rx).
+	if (ch == DAC_CH_1) { instance.regs->DHR12R1 = data; }
+	else 				{ instance.regs->DHR12R2 = data; }
 	
+	return true;
+}
+
+
+#if defined NODATE_DMA_ENABLED && defined NODATE_TIMER_ENABLED
+
+// --- TRIGGER MAPPINGS ---
+// TSEL values for the timer TRGO triggers of the DAC channels, per family.
+struct DAC_trigger_mapping {
+	TimerDevice timer;
+	uint8_t tsel;
+};
+
+static const DAC_trigger_mapping dacTriggerMappings[] = {
+	{ TIMER_6, 0 },
+	{ TIMER_7, 2 },
+	{ TIMER_2, 4 },
+#if defined __stm32f0 || defined __stm32f3
+	{ TIMER_3, 1 },
+#elif defined __stm32f1 || defined __stm32f4 || defined __stm32f7
+	{ TIMER_8, 1 },
+	{ TIMER_5, 3 },
+	{ TIMER_4, 5 },
 #endif
+	{ TIMER_1, 0xFF }	// End of table.
+};
+
+
+// --- STREAM CALLBACKS ---
+// Passes the half of the stream buffer which DMA just finished sending on to the application.
+// DMA callbacks, with the DAC as context.
+static void dacStreamHalf(void* ctx) {
+	DAC_device &instance = *((DAC_device*) ctx);
+	if (instance.streamHalf) { instance.streamHalf(0, instance.streamCount / 2); }
+}
+
+static void dacStreamFull(void* ctx) {
+	DAC_device &instance = *((DAC_device*) ctx);
+	uint16_t half = instance.streamCount / 2;
+	if (instance.streamFull) { instance.streamFull(half, instance.streamCount - half); }
+}
+
+
+// --- STREAM START ---
+// Common part of startStream() and startStreamDual(). 'bits' are the CR bits of the channel(s),
+// 'target' the data holding register and 'size' the sample size in bytes. The DMA request of
+// channel 1 also serves the dual channel stream. Only DAC1 is supported, as the DMA & trigger
+// mappings only cover its channels.
+static bool dacStreamStart(DAC_devices device, DAC_channel ch, uint32_t bits,
+						volatile uint32_t* target, const void* buffer, uint16_t count,
+						uint8_t size, DAC_stream &stream) {
+	if (device != DAC_1) { return false; }
 	
-	return false;
+	DAC_device &instance = dacList[device];
+	if (instance.streaming) { return false; }
+	if (buffer == 0 || count < 2) { return false; }
+	if (stream.rate == 0) { return false; }
+	
+	const DAC_trigger_mapping* m = dacTriggerMappings;
+	for (; m->tsel != 0xFF; ++m) {
+		if (m->timer == stream.timer) { break; }
+	}
+	
+	if (m->tsel == 0xFF) { return false; } // Timer can't trigger the DAC.
+	
+	if (!Timer::setFrequency(stream.timer, stream.rate)) { return false; }
+	if (!Timer::setTrigger(stream.timer, TIMER_TRGO_UPDATE)) { return false; }
+	
+	// The DMA mappings list the request of each DAC1 channel under RCC_DAC1 & RCC_DAC2.
+	RccPeripheral per = (ch == DAC_CH_1) ? RCC_DAC1 : RCC_DAC2;
+	if (!DMA::acquire(per, DMA_DIR_TX, instance.dma)) { return false; }
+	
+	instance.streamCount = count;
+	instance.streamHalf = stream.half;
+	instance.streamFull = stream.full;
+	
+	DMA_config cfg;
+	cfg.channel = instance.dma.channel;
+	cfg.request = instance.dma.request;
+	cfg.dir = DMA_MEM_TO_PER;
+	cfg.source = (uint32_t*) buffer;
+	cfg.target = (uint32_t*) target;
+	cfg.prio = DMA_PRIO_HIGH;
+	cfg.count = count;
+	cfg.src_size = size;
+	cfg.des_size = size;
+	cfg.circular = true;
+	cfg.src_incr = true;
+	cfg.des_incr = false;
+	
+	DMA_callbacks cb;
+	cb.half = dacStreamHalf;
+	cb.filled = dacStreamFull;
+	cb.ctx = &instance;
+	if (!DMA::configureChannel(instance.dma.device, cfg, cb)) {
+		DMA::release(instance.dma);
+		return false;
+	}
+	
+	// TSEL can only be changed while the channel is disabled.
+	uint32_t tsel = 0;
+	uint32_t tselMask = 0;
+	if (bits & DAC_CR_EN1) {
+		tsel |= (uint32_t) m->tsel << DAC_CR_TSEL1_Pos;
+		tselMask |= DAC_CR_TSEL1;
+	}
+	
+	if (bits & DAC_CR_EN2) {
+		tsel |= (uint32_t) m->tsel << DAC_CR_TSEL2_Pos;
+		tselMask |= DAC_CR_TSEL2;
+	}
+	
+	uint32_t dmaen = (ch == DAC_CH_1) ? DAC_CR_DMAEN1 : DAC_CR_DMAEN2;
+	instance.regs->CR &= ~(bits | tselMask);
+	instance.regs->CR |= tsel | ((DAC_CR_TEN1 | DAC_CR_TEN2) & (bits << 2)) | dmaen;
+	instance.regs->CR |= bits;
+	
+	instance.timer = stream.timer;
+	instance.streamBits = bits;
+	instance.streaming = true;
+	
+	return Timer::start(stream.timer);
 }
 
 
-// --- WRITE ---
-bool DAC::write(DAC_devices device, uint16_t data) {
+// --- START STREAM ---
+// Stream 'count' 12-bit samples from the circular 'buffer' to a channel, one sample per update
+// event of the stream timer. 'half' is called once the first half of the buffer has been sent,
+// 'full' for the second half, while DMA continues with the other half. The channel has to be
+// started with start() first. Only available on DAC1.
+bool DAC::startStream(DAC_devices device, DAC_channel ch, const uint16_t* buffer,
+															uint16_t count, DAC_stream stream) {
 	DAC_device &instance = dacList[device];
+	if (ch == DAC_CH_1 && !instance.ch1_active) { return false; }
+	if (ch == DAC_CH_2 && !instance.ch2_active) { return false; }
 	
-	// Check status. Set parameters.
-	// TODO: set active status per channel.
-	if (!instance.active) { return false; } // Unconfigured DAC.
+	uint32_t bits = DAC_CR_EN1 << dacChannelShift(ch);
+	volatile uint32_t* target = (ch == DAC_CH_1) ? &(instance.regs->DHR12R1)
+													: &(instance.regs->DHR12R2);
 	
-#ifdef STM32F3
-	// Write the provided data as right-aligned 12-bit data (DAC_DRH12R1).
-	instance.regs->DRH12R1 = data;
+	return dacStreamStart(device, ch, bits, target, buffer, count, 2, stream);
+}
+
+
+// --- START STREAM DUAL ---
+// Stream to both channels at once. Each 32-bit sample holds channel 1 in bits 0-11 and channel
+// 2 in bits 16-27, as in DHR12RD. Both channels have to be started with start() first.
+bool DAC::startStreamDual(DAC_devices device, const uint32_t* buffer, uint16_t count,
+																			DAC_stream stream) {
+	DAC_device &instance = dacList[device];
+	if (!instance.ch1_active || !instance.ch2_active) { return false; }
 	
-	return true;
-#endif
+	return dacStreamStart(device, DAC_CH_1, DAC_CR_EN1 | DAC_CR_EN2,
+							&(instance.regs->DHR12RD), buffer, count, 4, stream);
+}
+
+
+// --- STOP STREAM ---
+// Stop the stream timer and DMA transfer. The channel(s) keep the last sample and return to
+// software writes.
+bool DAC::stopStream(DAC_devices device) {
+	DAC_device &instance = dacList[device];
+	if (!instance.streaming) { return false; }
+	
+	Timer::stop(instance.timer);
+	
+	// Disabling the trigger requires disabling the channel(s).
+	uint32_t bits = instance.streamBits;
+	instance.regs->CR &= ~bits;
+	instance.regs->CR &= ~(DAC_CR_DMAEN1 | DAC_CR_DMAEN2 | ((DAC_CR_TEN1 | DAC_CR_TEN2) & (bits << 2)));
+	instance.regs->CR |= bits;
+	
+	DMA::abort(instance.dma.device, instance.dma.channel);
+	DMA::release(instance.dma);
 	
-	return false;
+	instance.streaming = false;
+	instance.streamHalf = 0;
+	instance.streamFull = 0;
+	
+	return true;
 }
 
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -13,6 +13,18 @@
 
 const int dma_count = 2;
 
+// F07x & F09x have seven DMA1 channels, sharing the channel 4 & 5 interrupt for 4-7.
+#if defined STM32F071xB || defined STM32F072xB || defined STM32F078xx || \
+		defined STM32F091xC || defined STM32F098xx
+#define NODATE_DMA_F0_CHANNEL_6_7
+#endif
+
+// F030xC & F09x route the DMA requests to the channels only through the CSELR register.
+#if defined STM32F030xC || defined STM32F091xC || defined STM32F098xx
+#define NODATE_DMA_F0_CSELR
+#endif
+
+
 // --- DMA DEVICES ---
 DMA_device* DMA_list() {
 	DMA_device item;
@@ -21,7 +33,10 @@ DMA_device* DMA_list() {
 		dma_devices[i] = item;
 	}
 	
-#ifdef RCC_AHBENR_DMAEN
+	dma_devices[DMA_1].per = RCC_DMA1;
+	dma_devices[DMA_2].per = RCC_DMA2;
+	
+#if defined RCC_AHBENR_DMAEN || defined RCC_AHBENR_DMA1EN || defined RCC_AHB1ENR_DMA1EN
 	dma_devices[DMA_1].regs = DMA1;
 #ifdef __stm32f0
 	dma_devices[DMA_1].channels[0].regs = DMA1_Channel1;
@@ -34,21 +49,84 @@ DMA_device* DMA_list() {
 	dma_devices[DMA_1].channels[3].irqType = DMA1_Channel4_5_IRQn;
 	dma_devices[DMA_1].channels[4].regs = DMA1_Channel5;
 	dma_devices[DMA_1].channels[4].irqType = DMA1_Channel4_5_IRQn;
-	/* dma_devices[DMA_1].channels[5].regs = DMA1_Channel6; // For F07x+ devices.
+#ifdef NODATE_DMA_F0_CHANNEL_6_7
+	dma_devices[DMA_1].channels[5].regs = DMA1_Channel6;
 	dma_devices[DMA_1].channels[5].irqType = DMA1_Channel4_5_IRQn;
 	dma_devices[DMA_1].channels[6].regs = DMA1_Channel7;
-	dma_devices[DMA_1].channels[6].irqType = DMA1_Channel4_5_IRQn; */
+	dma_devices[DMA_1].channels[6].irqType = DMA1_Channel4_5_IRQn;
+#endif
+#elif defined __stm32f1
+	dma_devices[DMA_1].channels[0].regs = DMA1_Channel1;
+	dma_devices[DMA_1].channels[0].irqType = DMA1_Channel1_IRQn;
+	dma_devices[DMA_1].channels[1].regs = DMA1_Channel2;
+	dma_devices[DMA_1].channels[1].irqType = DMA1_Channel2_IRQn;
+	dma_devices[DMA_1].channels[2].regs = DMA1_Channel3;
+	dma_devices[DMA_1].channels[2].irqType = DMA1_Channel3_IRQn;
+	dma_devices[DMA_1].channels[3].regs = DMA1_Channel4;
+	dma_devices[DMA_1].channels[3].irqType = DMA1_Channel4_IRQn;
+	dma_devices[DMA_1].channels[4].regs = DMA1_Channel5;
+	dma_devices[DMA_1].channels[4].irqType = DMA1_Channel5_IRQn;
+	dma_devices[DMA_1].channels[5].regs = DMA1_Channel6;
+	dma_devices[DMA_1].channels[5].irqType = DMA1_Channel6_IRQn;
+	dma_devices[DMA_1].channels[6].regs = DMA1_Channel7;
+	dma_devices[DMA_1].channels[6].irqType = DMA1_Channel7_IRQn;
+#elif defined NODATE_DMA_STREAMS
+	dma_devices[DMA_1].channels[0].regs = DMA1_Stream0;
+	dma_devices[DMA_1].channels[0].irqType = DMA1_Stream0_IRQn;
+	dma_devices[DMA_1].channels[1].regs = DMA1_Stream1;
+	dma_devices[DMA_1].channels[1].irqType = DMA1_Stream1_IRQn;
+	dma_devices[DMA_1].channels[2].regs = DMA1_Stream2;
+	dma_devices[DMA_1].channels[2].irqType = DMA1_Stream2_IRQn;
+	dma_devices[DMA_1].channels[3].regs = DMA1_Stream3;
+	dma_devices[DMA_1].channels[3].irqType = DMA1_Stream3_IRQn;
+	dma_devices[DMA_1].channels[4].regs = DMA1_Stream4;
+	dma_devices[DMA_1].channels[4].irqType = DMA1_Stream4_IRQn;
+	dma_devices[DMA_1].channels[5].regs = DMA1_Stream5;
+	dma_devices[DMA_1].channels[5].irqType = DMA1_Stream5_IRQn;
+	dma_devices[DMA_1].channels[6].regs = DMA1_Stream6;
+	dma_devices[DMA_1].channels[6].irqType = DMA1_Stream6_IRQn;
+	dma_devices[DMA_1].channels[7].regs = DMA1_Stream7;
+	dma_devices[DMA_1].channels[7].irqType = DMA1_Stream7_IRQn;
 #endif
 #endif
 
-/* #ifdef RCC_APB2ENR_ADC2EN
-	dma_devices[DMA_2].regs = ADC2;
-#if defined __stm32f4 || defined __stm32f1 || defined __stm32f7
-	dma_devices[DMA_2].irqType = ADC_IRQn;
+#if defined RCC_AHBENR_DMA2EN || defined RCC_AHB1ENR_DMA2EN
+	dma_devices[DMA_2].regs = DMA2;
+#if defined __stm32f1
+	dma_devices[DMA_2].channels[0].regs = DMA2_Channel1;
+	dma_devices[DMA_2].channels[0].irqType = DMA2_Channel1_IRQn;
+	dma_devices[DMA_2].channels[1].regs = DMA2_Channel2;
+	dma_devices[DMA_2].channels[1].irqType = DMA2_Channel2_IRQn;
+	dma_devices[DMA_2].channels[2].regs = DMA2_Channel3;
+	dma_devices[DMA_2].channels[2].irqType = DMA2_Channel3_IRQn;
+	dma_devices[DMA_2].channels[3].regs = DMA2_Channel4;
+	dma_devices[DMA_2].channels[4].regs = DMA2_Channel5;
+#if defined STM32F105xC || defined STM32F107xC
+	dma_devices[DMA_2].channels[3].irqType = DMA2_Channel4_IRQn;
+	dma_devices[DMA_2].channels[4].irqType = DMA2_Channel5_IRQn;
 #else
-	dma_devices[DMA_2].irqType = ADC2_IRQn;
+	dma_devices[DMA_2].channels[3].irqType = DMA2_Channel4_5_IRQn;
+	dma_devices[DMA_2].channels[4].irqType = DMA2_Channel4_5_IRQn;
+#endif
+#elif defined NODATE_DMA_STREAMS
+	dma_devices[DMA_2].channels[0].regs = DMA2_Stream0;
+	dma_devices[DMA_2].channels[0].irqType = DMA2_Stream0_IRQn;
+	dma_devices[DMA_2].channels[1].regs = DMA2_Stream1;
+	dma_devices[DMA_2].channels[1].irqType = DMA2_Stream1_IRQn;
+	dma_devices[DMA_2].channels[2].regs = DMA2_Stream2;
+	dma_devices[DMA_2].channels[2].irqType = DMA2_Stream2_IRQn;
+	dma_devices[DMA_2].channels[3].regs = DMA2_Stream3;
+	dma_devices[DMA_2].channels[3].irqType = DMA2_Stream3_IRQn;
+	dma_devices[DMA_2].channels[4].regs = DMA2_Stream4;
+	dma_devices[DMA_2].channels[4].irqType = DMA2_Stream4_IRQn;
+	dma_devices[DMA_2].channels[5].regs = DMA2_Stream5;
+	dma_devices[DMA_2].channels[5].irqType = DMA2_Stream5_IRQn;
+	dma_devices[DMA_2].channels[6].regs = DMA2_Stream6;
+	dma_devices[DMA_2].channels[6].irqType = DMA2_Stream6_IRQn;
+	dma_devices[DMA_2].channels[7].regs = DMA2_Stream7;
+	dma_devices[DMA_2].channels[7].irqType = DMA2_Stream7_IRQn;
+#endif
 #endif
-#endif */
 	
 	return dma_devices;
 }
@@ -57,105 +135,193 @@ DMA_device* dmaList = DMA_list();
 
 
 // --- ISRs ---
-#ifdef __stm32f0
+#if defined __stm32f0 || defined __stm32f1
+// Handles the flags of the channels 'first' to 'last' (0-based) which share an interrupt. Each
+// channel has four flags (GIF, TCIF, HTIF & TEIF) in ISR, at an offset of four bits per channel.
+// ISR is read once, and the flags which were seen are cleared with a single write to IFCR. GIF is
+// left out, as clearing it clears all flags of the channel, including any set after the read.
+static void channelIrq(DMA_device &instance, uint8_t first, uint8_t last) {
+	uint32_t mask = ((1UL << ((last - first + 1) * 4)) - 1) << (first * 4);
+	uint32_t isr = instance.regs->ISR & mask & ~0x11111111UL;
+	if (isr == 0) { return; }
+	
+	instance.regs->IFCR = isr;
+	
+	for (uint8_t i = first; i <= last; ++i) {
+		uint32_t flags = (isr >> (i * 4)) & 0xF;
+		if (flags == 0) { continue; }
+		
+		DMA_channel &ch = instance.channels[i];
+		if ((flags & DMA_ISR_HTIF1) && ch.cb.half) 		{ ch.cb.half(ch.cb.ctx); }
+		if ((flags & DMA_ISR_TCIF1) && ch.cb.filled) 	{ ch.cb.filled(ch.cb.ctx); }
+		if ((flags & DMA_ISR_TEIF1) && ch.cb.error) 	{ ch.cb.error(ch.cb.ctx); }
+	}
+}
+#endif
+
+
+#if defined __stm32f0
+// The channel 4 & 5 handler is aliased to the channel 4 to 7 handler where channels 6 & 7 exist.
 extern "C" {
 	void DMA1_Channel1_IRQHandler(void);
 	void DMA1_Channel2_3_IRQHandler(void);
 	void DMA1_Channel4_5_IRQHandler(void);
 }
 
+void DMA1_Channel1_IRQHandler(void) 	{ channelIrq(dmaList[DMA_1], 0, 0); }
+void DMA1_Channel2_3_IRQHandler(void) 	{ channelIrq(dmaList[DMA_1], 1, 2); }
+#ifdef NODATE_DMA_F0_CHANNEL_6_7
+void DMA1_Channel4_5_IRQHandler(void) 	{ channelIrq(dmaList[DMA_1], 3, 6); }
+#else
+void DMA1_Channel4_5_IRQHandler(void) 	{ channelIrq(dmaList[DMA_1], 3, 4); }
+#endif
+#elif defined __stm32f1
+extern "C" {
+	void DMA1_Channel1_IRQHandler(void);
+	void DMA1_Channel2_IRQHandler(void);
+	void DMA1_Channel3_IRQHandler(void);
+	void DMA1_Channel4_IRQHandler(void);
+	void DMA1_Channel5_IRQHandler(void);
+	void DMA1_Channel6_IRQHandler(void);
+	void DMA1_Channel7_IRQHandler(void);
+	void DMA2_Channel1_IRQHandler(void);
+	void DMA2_Channel2_IRQHandler(void);
+	void DMA2_Channel3_IRQHandler(void);
+#if defined STM32F105xC || defined STM32F107xC
+	void DMA2_Channel4_IRQHandler(void);
+	void DMA2_Channel5_IRQHandler(void);
+#else
+	void DMA2_Channel4_5_IRQHandler(void);
+#endif
+}
 
-void DMA1_Channel1_IRQHandler(void) {
-	DMA_device &instance = dmaList[0];
-	DMA_channel &ch = instance.channels[0];
-	
-	// Check for flag states. Handle callbacks.
-	if (instance.regs->ISR & DMA_ISR_HTIF1) {	// half-transfer interrupt.
-        instance.regs->IFCR |= DMA_IFCR_CHTIF1;
-		ch.cb.half();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TCIF1) { // transfer complete.
-		instance.regs->IFCR |= DMA_IFCR_CTCIF1;
-		ch.cb.filled();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TEIF1) { // transfer error.
-		instance.regs->IFCR |= DMA_IFCR_CTEIF1;
-		ch.cb.error();
-	}
+void DMA1_Channel1_IRQHandler(void) { channelIrq(dmaList[DMA_1], 0, 0); }
+void DMA1_Channel2_IRQHandler(void) { channelIrq(dmaList[DMA_1], 1, 1); }
+void DMA1_Channel3_IRQHandler(void) { channelIrq(dmaList[DMA_1], 2, 2); }
+void DMA1_Channel4_IRQHandler(void) { channelIrq(dmaList[DMA_1], 3, 3); }
+void DMA1_Channel5_IRQHandler(void) { channelIrq(dmaList[DMA_1], 4, 4); }
+void DMA1_Channel6_IRQHandler(void) { channelIrq(dmaList[DMA_1], 5, 5); }
+void DMA1_Channel7_IRQHandler(void) { channelIrq(dmaList[DMA_1], 6, 6); }
+void DMA2_Channel1_IRQHandler(void) { channelIrq(dmaList[DMA_2], 0, 0); }
+void DMA2_Channel2_IRQHandler(void) { channelIrq(dmaList[DMA_2], 1, 1); }
+void DMA2_Channel3_IRQHandler(void) { channelIrq(dmaList[DMA_2], 2, 2); }
+#if defined STM32F105xC || defined STM32F107xC
+void DMA2_Channel4_IRQHandler(void) { channelIrq(dmaList[DMA_2], 3, 3); }
+void DMA2_Channel5_IRQHandler(void) { channelIrq(dmaList[DMA_2], 4, 4); }
+#else
+void DMA2_Channel4_5_IRQHandler(void) { channelIrq(dmaList[DMA_2], 3, 4); }
+#endif
+#elif defined NODATE_DMA_STREAMS
+// Offsets of the flags for streams 0-3 in LISR, and streams 4-7 in HISR.
+static const uint8_t streamShift[4] = { 0, 6, 16, 22 };
+static const uint32_t streamFlags = DMA_LISR_FEIF0 | DMA_LISR_DMEIF0 | DMA_LISR_TEIF0 |
+									DMA_LISR_HTIF0 | DMA_LISR_TCIF0;
+
+
+// Clears all flags of a stream.
+static void clearStreamFlags(DMA_device &instance, uint8_t stream) {
+	if (stream < 4) { instance.regs->LIFCR = streamFlags << streamShift[stream]; }
+	else 			{ instance.regs->HIFCR = streamFlags << streamShift[stream - 4]; }
 }
 
 
-void DMA1_Channel2_3_IRQHandler(void) {
-	// Determine the channel with the active ISR.
-	DMA_device &instance = dmaList[0];
-	if (instance.regs->ISR & DMA_ISR_HTIF2) {	// half-transfer interrupt.
-        instance.regs->IFCR |= DMA_IFCR_CHTIF2;
-		DMA_channel &ch = instance.channels[1];
-		ch.cb.half();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TCIF2) { // transfer complete.
-		instance.regs->IFCR |= DMA_IFCR_CTCIF2;
-		DMA_channel &ch = instance.channels[1];
-		ch.cb.filled();
+// Handles the flags of a single stream.
+static void streamIrq(DMA_device &instance, uint8_t stream) {
+	uint32_t shift = streamShift[stream & 0x3];
+	uint32_t flags;
+	if (stream < 4) {
+		flags = (instance.regs->LISR >> shift) & streamFlags;
+		if (flags == 0) { return; }
+		instance.regs->LIFCR = (flags << shift);
 	}
-	else if (instance.regs->ISR & DMA_ISR_TEIF2) { // transfer error.
-		instance.regs->IFCR |= DMA_IFCR_CTEIF2;
-		DMA_channel &ch = instance.channels[1];
-		ch.cb.error();
+	else {
+		flags = (instance.regs->HISR >> shift) & streamFlags;
+		if (flags == 0) { return; }
+		instance.regs->HIFCR = (flags << shift);
 	}
 	
-	if (instance.regs->ISR & DMA_ISR_HTIF3) {	// half-transfer interrupt.
-        instance.regs->IFCR |= DMA_IFCR_CHTIF3;
-		DMA_channel &ch = instance.channels[2];
-		ch.cb.half();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TCIF3) { // transfer complete.
-		instance.regs->IFCR |= DMA_IFCR_CTCIF3;
-		DMA_channel &ch = instance.channels[2];
-		ch.cb.filled();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TEIF3) { // transfer error.
-		instance.regs->IFCR |= DMA_IFCR_CTEIF3;
-		DMA_channel &ch = instance.channels[2];
-		ch.cb.error();
-	}
+	// FIFO errors are not treated as fatal, as the stream keeps running in that case. In
+	// double-buffer mode, the transfer complete callback signals each switch of memory buffer.
+	DMA_channel &ch = instance.channels[stream];
+	if ((flags & DMA_LISR_HTIF0) && ch.cb.half) 	{ ch.cb.half(ch.cb.ctx); }
+	if ((flags & DMA_LISR_TCIF0) && ch.cb.filled) 	{ ch.cb.filled(ch.cb.ctx); }
+	if ((flags & (DMA_LISR_TEIF0 | DMA_LISR_DMEIF0)) && ch.cb.error) { ch.cb.error(ch.cb.ctx); }
 }
 
 
-void DMA1_Channel4_5_IRQHandler(void) {
-	// Determine the channel with the active ISR.
-	DMA_device &instance = dmaList[0];
-	if (instance.regs->ISR & DMA_ISR_HTIF4) {	// half-transfer interrupt.
-        instance.regs->IFCR |= DMA_IFCR_CHTIF4;
-		DMA_channel &ch = instance.channels[3];
-		ch.cb.half();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TCIF4) { // transfer complete.
-		instance.regs->IFCR |= DMA_IFCR_CTCIF4;
-		DMA_channel &ch = instance.channels[3];
-		ch.cb.filled();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TEIF4) { // transfer error.
-		instance.regs->IFCR |= DMA_IFCR_CTEIF4;
-		DMA_channel &ch = instance.channels[3];
-		ch.cb.error();
-	}
+extern "C" {
+	void DMA1_Stream0_IRQHandler(void);
+	void DMA1_Stream1_IRQHandler(void);
+	void DMA1_Stream2_IRQHandler(void);
+	void DMA1_Stream3_IRQHandler(void);
+	void DMA1_Stream4_IRQHandler(void);
+	void DMA1_Stream5_IRQHandler(void);
+	void DMA1_Stream6_IRQHandler(void);
+	void DMA1_Stream7_IRQHandler(void);
+	void DMA2_Stream0_IRQHandler(void);
+	void DMA2_Stream1_IRQHandler(void);
+	void DMA2_Stream2_IRQHandler(void);
+	void DMA2_Stream3_IRQHandler(void);
+	void DMA2_Stream4_IRQHandler(void);
+	void DMA2_Stream5_IRQHandler(void);
+	void DMA2_Stream6_IRQHandler(void);
+	void DMA2_Stream7_IRQHandler(void);
+}
+
+void DMA1_Stream0_IRQHandler(void) { streamIrq(dmaList[DMA_1], 0); }
+void DMA1_Stream1_IRQHandler(void) { streamIrq(dmaList[DMA_1], 1); }
+void DMA1_Stream2_IRQHandler(void) { streamIrq(dmaList[DMA_1], 2); }
+void DMA1_Stream3_IRQHandler(void) { streamIrq(dmaList[DMA_1], 3); }
+void DMA1_Stream4_IRQHandler(void) { streamIrq(dmaList[DMA_1], 4); }
+void DMA1_Stream5_IRQHandler(void) { streamIrq(dmaList[DMA_1], 5); }
+void DMA1_Stream6_IRQHandler(void) { streamIrq(dmaList[DMA_1], 6); }
+void DMA1_Stream7_IRQHandler(void) { streamIrq(dmaList[DMA_1], 7); }
+void DMA2_Stream0_IRQHandler(void) { streamIrq(dmaList[DMA_2], 0); }
+void DMA2_Stream1_IRQHandler(void) { streamIrq(dmaList[DMA_2], 1); }
+void DMA2_Stream2_IRQHandler(void) { streamIrq(dmaList[DMA_2], 2); }
+void DMA2_Stream3_IRQHandler(void) { streamIrq(dmaList[DMA_2], 3); }
+void DMA2_Stream4_IRQHandler(void) { streamIrq(dmaList[DMA_2], 4); }
+void DMA2_Stream5_IRQHandler(void) { streamIrq(dmaList[DMA_2], 5); }
+void DMA2_Stream6_IRQHandler(void) { streamIrq(dmaList[DMA_2], 6); }
+void DMA2_Stream7_IRQHandler(void) { streamIrq(dmaList[DMA_2], 7); }
+#endif
+
+
+// Converts a channel (F0/F1: 1-7) or stream (F4/F7: 0-7) number into a channel list index.
+static bool channelIndex(uint8_t channel, uint8_t &index) {
+#ifdef NODATE_DMA_STREAMS
+	if (channel > 7) { return false; }
+	index = channel;
+#else
+	if (channel < 1 || channel > 7) { return false; }
+	index = channel - 1;
+#endif
 	
-	if (instance.regs->ISR & DMA_ISR_HTIF5) {	// half-transfer interrupt.
-        instance.regs->IFCR |= DMA_IFCR_CHTIF5;
-		DMA_channel &ch = instance.channels[4];
-		ch.cb.half();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TCIF5) { // transfer complete.
-		instance.regs->IFCR |= DMA_IFCR_CTCIF5;
-		DMA_channel &ch = instance.channels[4];
-		ch.cb.filled();
-	}
-	else if (instance.regs->ISR & DMA_ISR_TEIF5) { // transfer error.
-		instance.regs->IFCR |= DMA_IFCR_CTEIF5;
-		DMA_channel &ch = instance.channels[4];
-		ch.cb.error();
-	}
+	return true;
+}
+
+
+// Converts an element size in bytes into the value of the MSIZE/PSIZE register fields.
+static bool sizeField(uint8_t size, uint32_t &field) {
+	if (size == 1) 		{ field = 0; }
+	else if (size == 2) { field = 1; }
+	else if (size == 4) { field = 2; }
+	else { return false; }
+	
+	return true;
+}
+
+
+#ifdef NODATE_DMA_STREAMS
+// Converts a burst length in beats into the value of the MBURST/PBURST register fields.
+static bool burstField(uint8_t beats, uint32_t &field) {
+	if (beats == 1) 		{ field = 0; }
+	else if (beats == 4) 	{ field = 1; }
+	else if (beats == 8) 	{ field = 2; }
+	else if (beats == 16) 	{ field = 3; }
+	else { return false; }
+	
+	return true;
 }
 #endif
 
@@ -163,76 +329,431 @@ void DMA1_Channel4_5_IRQHandler(void) {
 // --- START ---
 bool DMA::start(DMA_devices device) {
 	DMA_device &instance = dmaList[device];
-#ifdef __stm32f0
-	// Check status. Set parameters.
+	
+	// Check status.
 	if (instance.active) { return true; } // Already active.
-	if (device == DMA_1) 		{ instance.per = RCC_DMA1; }
-	else if (device == DMA_2)	{ instance.per = RCC_DMA2; }
-	
-	// Start device if needed.
-	if (!instance.active) {
-		if (!Rcc::enable(instance.per)) {
-			// TODO: set status.
-			return false;
-		}
+	if (instance.regs == 0) { return false; }
+	
+	// Start device.
+	if (!Rcc::enable(instance.per)) {
+		// TODO: set status.
+		return false;
 	}
   
 	instance.active = true;
 	
 	return true;
-#else
-	return false;
+}
+	
+
+// --- CLAIM ---
+// Reserves a channel (F0/F1) or stream (F4/F7) for a driver. Returns false if already claimed.
+bool DMA::claim(DMA_devices device, uint8_t channel) {
+	DMA_device &instance = dmaList[device];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return false; }
+	
+	DMA_channel &ch = instance.channels[index];
+	if (ch.regs == 0 || ch.claimed) { return false; }
+	
+	ch.claimed = true;
+	
+	return true;
+}
+
+
+// --- RELEASE ---
+bool DMA::release(DMA_devices device, uint8_t channel) {
+	DMA_device &instance = dmaList[device];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return false; }
+	
+	DMA_channel &ch = instance.channels[index];
+	if (!ch.claimed) { return false; }
+	
+	if (ch.active) { abort(device, channel); }
+	ch.claimed = false;
+	
+	return true;
+}
+
+
+// --- REQUEST MAPPINGS ---
+// Per family, the channels (F0/F1) or streams & channel selections (F4/F7) which serve the DMA
+// requests of each peripheral. The preferred option is listed first. Only default mappings are
+// listed for F0, as the alternatives require remapping in SYSCFG. The F0 request is the CSELR
+// channel selection, which is only used on the parts that have it.
+struct DMA_mapping {
+	RccPeripheral per;
+	DMA_request_dir dir;
+	DMA_devices device;
+	uint8_t channel;
+	uint8_t request;
+};
+
+static const DMA_mapping dmaMappings[] = {
+#if defined __stm32f0
+	{ RCC_ADC1, 	DMA_DIR_RX, DMA_1, 1, 0x1 },
+	{ RCC_SPI1, 	DMA_DIR_RX, DMA_1, 2, 0x3 },
+	{ RCC_SPI1, 	DMA_DIR_TX, DMA_1, 3, 0x3 },
+	{ RCC_USART1, 	DMA_DIR_TX, DMA_1, 2, 0x8 },
+	{ RCC_USART1, 	DMA_DIR_RX, DMA_1, 3, 0x8 },
+	{ RCC_I2C1, 	DMA_DIR_TX, DMA_1, 2, 0x2 },
+	{ RCC_I2C1, 	DMA_DIR_RX, DMA_1, 3, 0x2 },
+	{ RCC_DAC1, 	DMA_DIR_TX, DMA_1, 3, 0x1 },
+	{ RCC_DAC2, 	DMA_DIR_TX, DMA_1, 4, 0x1 },
+	{ RCC_SPI2, 	DMA_DIR_RX, DMA_1, 4, 0x3 },
+	{ RCC_SPI2, 	DMA_DIR_TX, DMA_1, 5, 0x3 },
+	{ RCC_USART2, 	DMA_DIR_TX, DMA_1, 4, 0x9 },
+	{ RCC_USART2, 	DMA_DIR_RX, DMA_1, 5, 0x9 },
+	{ RCC_I2C2, 	DMA_DIR_TX, DMA_1, 4, 0x2 },
+	{ RCC_I2C2, 	DMA_DIR_RX, DMA_1, 5, 0x2 },
+#ifdef NODATE_DMA_F0_CHANNEL_6_7
+	{ RCC_USART3, 	DMA_DIR_RX, DMA_1, 6, 0xA },
+	{ RCC_USART3, 	DMA_DIR_TX, DMA_1, 7, 0xA },
+	{ RCC_USART4, 	DMA_DIR_RX, DMA_1, 6, 0xB },
+	{ RCC_USART4, 	DMA_DIR_TX, DMA_1, 7, 0xB },
+#endif
+#elif defined __stm32f1
+	{ RCC_ADC1, 	DMA_DIR_RX, DMA_1, 1, 0 },
+	{ RCC_SPI1, 	DMA_DIR_RX, DMA_1, 2, 0 },
+	{ RCC_SPI1, 	DMA_DIR_TX, DMA_1, 3, 0 },
+	{ RCC_USART3, 	DMA_DIR_TX, DMA_1, 2, 0 },
+	{ RCC_USART3, 	DMA_DIR_RX, DMA_1, 3, 0 },
+	{ RCC_SPI2, 	DMA_DIR_RX, DMA_1, 4, 0 },
+	{ RCC_SPI2, 	DMA_DIR_TX, DMA_1, 5, 0 },
+	{ RCC_USART1, 	DMA_DIR_TX, DMA_1, 4, 0 },
+	{ RCC_USART1, 	DMA_DIR_RX, DMA_1, 5, 0 },
+	{ RCC_I2C2, 	DMA_DIR_TX, DMA_1, 4, 0 },
+	{ RCC_I2C2, 	DMA_DIR_RX, DMA_1, 5, 0 },
+	{ RCC_USART2, 	DMA_DIR_RX, DMA_1, 6, 0 },
+	{ RCC_USART2, 	DMA_DIR_TX, DMA_1, 7, 0 },
+	{ RCC_I2C1, 	DMA_DIR_TX, DMA_1, 6, 0 },
+	{ RCC_I2C1, 	DMA_DIR_RX, DMA_1, 7, 0 },
+	{ RCC_SPI3, 	DMA_DIR_RX, DMA_2, 1, 0 },
+	{ RCC_SPI3, 	DMA_DIR_TX, DMA_2, 2, 0 },
+	{ RCC_USART4, 	DMA_DIR_RX, DMA_2, 3, 0 },
+	{ RCC_DAC1, 	DMA_DIR_TX, DMA_2, 3, 0 },
+	{ RCC_DAC2, 	DMA_DIR_TX, DMA_2, 4, 0 },
+	{ RCC_ADC3, 	DMA_DIR_RX, DMA_2, 5, 0 },
+	{ RCC_USART4, 	DMA_DIR_TX, DMA_2, 5, 0 },
+#elif defined __stm32f4 || defined __stm32f7
+	{ RCC_SPI3, 	DMA_DIR_RX, DMA_1, 0, 0 },
+	{ RCC_SPI3, 	DMA_DIR_RX, DMA_1, 2, 0 },
+	{ RCC_SPI2, 	DMA_DIR_RX, DMA_1, 3, 0 },
+	{ RCC_SPI2, 	DMA_DIR_TX, DMA_1, 4, 0 },
+	{ RCC_SPI3, 	DMA_DIR_TX, DMA_1, 5, 0 },
+	{ RCC_SPI3, 	DMA_DIR_TX, DMA_1, 7, 0 },
+	{ RCC_I2C1, 	DMA_DIR_RX, DMA_1, 0, 1 },
+	{ RCC_I2C1, 	DMA_DIR_RX, DMA_1, 5, 1 },
+	{ RCC_I2C1, 	DMA_DIR_TX, DMA_1, 6, 1 },
+	{ RCC_I2C1, 	DMA_DIR_TX, DMA_1, 7, 1 },
+	{ RCC_USART5, 	DMA_DIR_RX, DMA_1, 0, 4 },
+	{ RCC_USART3, 	DMA_DIR_RX, DMA_1, 1, 4 },
+	{ RCC_USART4, 	DMA_DIR_RX, DMA_1, 2, 4 },
+	{ RCC_USART3, 	DMA_DIR_TX, DMA_1, 3, 4 },
+	{ RCC_USART4, 	DMA_DIR_TX, DMA_1, 4, 4 },
+	{ RCC_USART2, 	DMA_DIR_RX, DMA_1, 5, 4 },
+	{ RCC_USART2, 	DMA_DIR_TX, DMA_1, 6, 4 },
+	{ RCC_USART5, 	DMA_DIR_TX, DMA_1, 7, 4 },
+	{ RCC_USART3, 	DMA_DIR_TX, DMA_1, 4, 7 },
+	{ RCC_I2C2, 	DMA_DIR_RX, DMA_1, 2, 7 },
+	{ RCC_I2C2, 	DMA_DIR_RX, DMA_1, 3, 7 },
+	{ RCC_I2C2, 	DMA_DIR_TX, DMA_1, 7, 7 },
+	{ RCC_DAC1, 	DMA_DIR_TX, DMA_1, 5, 7 },
+	{ RCC_DAC2, 	DMA_DIR_TX, DMA_1, 6, 7 },
+#ifdef UART7
+	{ RCC_USART7, 	DMA_DIR_RX, DMA_1, 3, 5 },
+	{ RCC_USART7, 	DMA_DIR_TX, DMA_1, 1, 5 },
+	{ RCC_USART8, 	DMA_DIR_RX, DMA_1, 6, 5 },
+	{ RCC_USART8, 	DMA_DIR_TX, DMA_1, 0, 5 },
+#endif
+	{ RCC_ADC1, 	DMA_DIR_RX, DMA_2, 0, 0 },
+	{ RCC_ADC1, 	DMA_DIR_RX, DMA_2, 4, 0 },
+	{ RCC_ADC2, 	DMA_DIR_RX, DMA_2, 2, 1 },
+	{ RCC_ADC2, 	DMA_DIR_RX, DMA_2, 3, 1 },
+	{ RCC_ADC3, 	DMA_DIR_RX, DMA_2, 0, 2 },
+	{ RCC_ADC3, 	DMA_DIR_RX, DMA_2, 1, 2 },
+	{ RCC_SPI1, 	DMA_DIR_RX, DMA_2, 0, 3 },
+	{ RCC_SPI1, 	DMA_DIR_RX, DMA_2, 2, 3 },
+	{ RCC_SPI1, 	DMA_DIR_TX, DMA_2, 3, 3 },
+	{ RCC_SPI1, 	DMA_DIR_TX, DMA_2, 5, 3 },
+	{ RCC_USART1, 	DMA_DIR_RX, DMA_2, 2, 4 },
+	{ RCC_USART1, 	DMA_DIR_RX, DMA_2, 5, 4 },
+	{ RCC_USART1, 	DMA_DIR_TX, DMA_2, 7, 4 },
+	{ RCC_USART6, 	DMA_DIR_RX, DMA_2, 1, 5 },
+	{ RCC_USART6, 	DMA_DIR_RX, DMA_2, 2, 5 },
+	{ RCC_USART6, 	DMA_DIR_TX, DMA_2, 6, 5 },
+	{ RCC_USART6, 	DMA_DIR_TX, DMA_2, 7, 5 },
+#ifdef SPI4
+	{ RCC_SPI4, 	DMA_DIR_RX, DMA_2, 0, 4 },
+	{ RCC_SPI4, 	DMA_DIR_TX, DMA_2, 1, 4 },
+	{ RCC_SPI4, 	DMA_DIR_RX, DMA_2, 3, 5 },
+	{ RCC_SPI4, 	DMA_DIR_TX, DMA_2, 4, 5 },
+#endif
+#ifdef SPI5
+	{ RCC_SPI5, 	DMA_DIR_RX, DMA_2, 3, 2 },
+	{ RCC_SPI5, 	DMA_DIR_TX, DMA_2, 4, 2 },
+	{ RCC_SPI5, 	DMA_DIR_RX, DMA_2, 5, 7 },
+	{ RCC_SPI5, 	DMA_DIR_TX, DMA_2, 6, 7 },
 #endif
+#endif
+	{ RCC_DMA1, 	DMA_DIR_RX, DMA_1, 0xFF, 0 }	// End of table.
+};
+
+
+// --- ACQUIRE ---
+// Finds a free channel (F0/F1) or stream (F4/F7) for the DMA request of the peripheral and claims
+// it. Returns false if the peripheral has no DMA request on this MCU, or if all of its channels
+// or streams have already been claimed by other drivers. This should be done during
+// initialisation, so that conflicts show up there rather than as corrupted transfers.
+bool DMA::acquire(RccPeripheral per, DMA_request_dir dir, DMA_assignment &dma) {
+	if (dma.valid) { return true; }
+	
+	for (const DMA_mapping* m = dmaMappings; m->channel != 0xFF; ++m) {
+		if (m->per != per || m->dir != dir) { continue; }
+		if (dmaList[m->device].regs == 0) { continue; }
+		if (!claim(m->device, m->channel)) { continue; }
+		
+		dma.device = m->device;
+		dma.channel = m->channel;
+		dma.request = m->request;
+		dma.valid = true;
+		
+		return true;
+	}
+	
+	return false;
 }
+
+
+// --- RELEASE ---
+bool DMA::release(DMA_assignment &dma) {
+	if (!dma.valid) { return false; }
 	
+	dma.valid = false;
+	
+	return release(dma.device, dma.channel);
+}
+
 
 // --- CONFIGURE CHANNEL ---
+// Configures and enables a channel (F0/F1) or stream (F4/F7). The peripheral side of the transfer
+// is the source for peripheral-to-memory and memory-to-memory transfers, otherwise the target.
+// With a count of zero the channel is configured, but left disabled until DMA::transfer().
 bool DMA::configureChannel(DMA_devices device, DMA_config config, DMA_callbacks cb) {
 	DMA_device &instance = dmaList[device];
-#ifdef __stm32f0
-	// No more than 7 channels support on DMA 1, and 5 on F042.
-	// TODO: per-MCU variation check.
-	if (config.channel > 7) { return false; }
+	uint8_t index;
+	if (!channelIndex(config.channel, index)) { return false; }
 	
-	DMA_channel &ch = instance.channels[config.channel - 1];
-
-	// Disable channel.
+	DMA_channel &ch = instance.channels[index];
+	if (ch.regs == 0) { return false; }
+	
+	uint32_t src_size, des_size;
+	if (!sizeField(config.src_size, src_size) || !sizeField(config.des_size, des_size)) {
+		return false;
+	}
+	
+#ifdef NODATE_DMA_STREAMS
+	// Bursts require the FIFO. Double-buffer mode is not available for memory-to-memory transfers.
+	uint32_t mem_burst, per_burst;
+	if (!burstField(config.mem_burst, mem_burst) || !burstField(config.per_burst, per_burst)) {
+		return false;
+	}
+	
+	if (config.fifo == DMA_FIFO_DIRECT && (mem_burst != 0 || per_burst != 0)) { return false; }
+	if (config.target2 != 0 && config.dir == DMA_MEM_TO_MEM) { return false; }
+#else
+	// FIFO, bursts and double-buffer mode only exist on the stream-based controller.
+	if (config.fifo != DMA_FIFO_DIRECT || config.mem_burst != 1 || config.per_burst != 1 ||
+			config.target2 != 0) {
+		return false;
+	}
+#endif
+	
+	// The DMA peripheral has to be clocked before its registers can be written.
+	if (!start(device)) { return false; }
+	
+	bool per_src = (config.dir != DMA_MEM_TO_PER);
+	uint32_t per_addr 	= per_src ? (uint32_t) config.source : (uint32_t) config.target;
+	uint32_t mem_addr 	= per_src ? (uint32_t) config.target : (uint32_t) config.source;
+	bool per_incr 		= per_src ? config.src_incr : config.des_incr;
+	bool mem_incr 		= per_src ? config.des_incr : config.src_incr;
+	uint32_t per_size 	= per_src ? src_size : des_size;
+	uint32_t mem_size 	= per_src ? des_size : src_size;
+	
+#ifdef NODATE_DMA_STREAMS
+	// Disable the stream and wait for any ongoing transfer to finish.
+	ch.regs->CR &= ~DMA_SxCR_EN;
+	while (ch.regs->CR & DMA_SxCR_EN) {}
+	clearStreamFlags(instance, index);
+	
+	// Set the peripheral & memory addresses and the number of transfers.
+	ch.regs->PAR = per_addr;
+	ch.regs->M0AR = mem_addr;
+	if (config.target2 != 0) { ch.regs->M1AR = (uint32_t) config.target2; }
+	ch.regs->NDTR = config.count;
+	
+	// Configure request, increment, size, priority, direction, interrupts and circular mode.
+	uint32_t cr_reg = ((uint32_t) config.request << DMA_SxCR_CHSEL_Pos) & DMA_SxCR_CHSEL;
+	cr_reg |= ((uint32_t) config.prio) << DMA_SxCR_PL_Pos;
+	cr_reg |= (mem_size << DMA_SxCR_MSIZE_Pos) | (per_size << DMA_SxCR_PSIZE_Pos);
+	if (mem_incr) { cr_reg |= DMA_SxCR_MINC; }
+	if (per_incr) { cr_reg |= DMA_SxCR_PINC; }
+	cr_reg |= (mem_burst << DMA_SxCR_MBURST_Pos) | (per_burst << DMA_SxCR_PBURST_Pos);
+	if (config.circular) { cr_reg |= DMA_SxCR_CIRC; }
+	if (config.target2 != 0) { cr_reg |= DMA_SxCR_DBM | DMA_SxCR_CIRC; }
+	if (config.dir == DMA_MEM_TO_PER) { cr_reg |= DMA_SxCR_DIR_0; }
+	else if (config.dir == DMA_MEM_TO_MEM) { cr_reg |= DMA_SxCR_DIR_1; }
+	if (cb.half) 	{ cr_reg |= DMA_SxCR_HTIE; }
+	if (cb.filled) 	{ cr_reg |= DMA_SxCR_TCIE; }
+	if (cb.error)	{ cr_reg |= DMA_SxCR_TEIE | DMA_SxCR_DMEIE; }
+	
+	// Direct mode, or FIFO with threshold.
+	if (config.fifo == DMA_FIFO_DIRECT) { ch.regs->FCR = 0; }
+	else {
+		ch.regs->FCR = DMA_SxFCR_DMDIS | ((uint32_t) (config.fifo - 1) << DMA_SxFCR_FTH_Pos);
+	}
+	
+	ch.regs->CR = cr_reg;
+#else
+	// Disable channel. Clear any pending flags.
 	ch.regs->CCR &= ~DMA_CCR_EN;
+	instance.regs->IFCR = (0xF << (index * 4));
 	
-	// Set the target peripheral data register address.
-	// Set the target memory address.
-	// Set the number of transfers per cycle.
-	ch.regs->CPAR = (uint32_t) config.source;
-	ch.regs->CMAR = (uint32_t) config.target;
+	// Set the peripheral & memory addresses and the number of transfers.
+	ch.regs->CPAR = per_addr;
+	ch.regs->CMAR = mem_addr;
 	ch.regs->CNDTR = config.count;
 	
-	// Configure increment, size, priority, interrupts and circular mode.
-	uint32_t ccr_reg = 0;
-	if (config.prio != DMA_PRIO_LOW) { ccr_reg |= ((uint8_t) config.prio) << DMA_CCR_PL_Pos; }
-	if (config.src_incr) { ccr_reg |= DMA_CCR_MINC; }
-	if (config.des_incr) { ccr_reg |= DMA_CCR_PINC; }
+#ifdef NODATE_DMA_F0_CSELR
+	// Route the peripheral's request to the channel.
+	instance.regs->CSELR = (instance.regs->CSELR & ~(0xFUL << (index * 4))) | 
+										((uint32_t) (config.request & 0xF) << (index * 4));
+#endif
+	
+	// Configure increment, size, priority, direction, interrupts and circular mode.
+	uint32_t ccr_reg = ((uint32_t) config.prio) << DMA_CCR_PL_Pos;
+	ccr_reg |= (mem_size << DMA_CCR_MSIZE_Pos) | (per_size << DMA_CCR_PSIZE_Pos);
+	if (mem_incr) { ccr_reg |= DMA_CCR_MINC; }
+	if (per_incr) { ccr_reg |= DMA_CCR_PINC; }
 	if (config.circular) { ccr_reg |= DMA_CCR_CIRC; }
-	if (config.src_size > 3 || config.des_size > 3) { return false; }
-	if (config.src_size > 1) { ccr_reg |= (config.src_size - 1) << DMA_CCR_MSIZE_Pos; }
-	if (config.des_size > 1) { ccr_reg |= (config.des_size - 1) << DMA_CCR_PSIZE_Pos; }
+	if (config.dir == DMA_MEM_TO_PER) { ccr_reg |= DMA_CCR_DIR; }
+	else if (config.dir == DMA_MEM_TO_MEM) { ccr_reg |= DMA_CCR_MEM2MEM; }
 	if (cb.half) 	{ ccr_reg |= DMA_CCR_HTIE; }
 	if (cb.filled) 	{ ccr_reg |= DMA_CCR_TCIE; }
 	if (cb.error)	{ ccr_reg |= DMA_CCR_TEIE; }
 	
 	// Copy to channel register.
 	ch.regs->CCR = ccr_reg;
+#endif
 	
 	// Save configuration & callbacks.
 	ch.config = config;
 	ch.cb = cb;
+	
+	// Configure NVIC for DMA, at the same priority as the peripheral interrupts.
+	NVIC_SetPriority(ch.irqType, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 1));
+	NVIC_EnableIRQ(ch.irqType);
 
 	// Enable channel.
-	ch.regs->CCR |= DMA_CCR_EN;
 	ch.active = true;
- 
-	// Configure NVIC for DMA.
-	NVIC_EnableIRQ(ch.irqType);
-	NVIC_SetPriority(ch.irqType, 0);
+	if (config.count == 0) { return true; }
+	
+#ifdef NODATE_DMA_STREAMS
+	ch.regs->CR |= DMA_SxCR_EN;
+#else
+	ch.regs->CCR |= DMA_CCR_EN;
+#endif
+	
+	return true;
+}
+
+
+// --- TRANSFER ---
+// Starts a new transfer on a configured channel, with only the memory address and count changed.
+// Any ongoing transfer on the channel is cut short.
+bool DMA::transfer(DMA_devices device, uint8_t channel, uint32_t* memory, uint16_t count) {
+	DMA_device &instance = dmaList[device];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return false; }
+	
+	DMA_channel &ch = instance.channels[index];
+	if (!ch.active || count == 0) { return false; }
+	
+#ifdef NODATE_DMA_STREAMS
+	// The stream disables itself at the end of a transfer.
+	ch.regs->CR &= ~DMA_SxCR_EN;
+	while (ch.regs->CR & DMA_SxCR_EN) {}
+	clearStreamFlags(instance, index);
+	ch.regs->M0AR = (uint32_t) memory;
+	ch.regs->NDTR = count;
+	ch.regs->CR |= DMA_SxCR_EN;
+#else
+	ch.regs->CCR &= ~DMA_CCR_EN;
+	instance.regs->IFCR = (0xF << (index * 4));
+	ch.regs->CMAR = (uint32_t) memory;
+	ch.regs->CNDTR = count;
+	ch.regs->CCR |= DMA_CCR_EN;
+#endif
+	
+	return true;
+}
+
+
+// --- REMAINING ---
+// Returns the number of transfers left in the current cycle of the channel.
+uint16_t DMA::remaining(DMA_devices device, uint8_t channel) {
+	DMA_device &instance = dmaList[device];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return 0; }
+	
+	DMA_channel &ch = instance.channels[index];
+	if (!ch.active) { return 0; }
+	
+#ifdef NODATE_DMA_STREAMS
+	return ch.regs->NDTR;
+#else
+	return ch.regs->CNDTR;
+#endif
+}
+
+
+// --- CURRENT MEMORY ---
+// Returns the memory buffer (0 or 1) that a stream in double-buffer mode is currently accessing.
+// Always 0 for other channels.
+uint8_t DMA::currentMemory(DMA_devices device, uint8_t channel) {
+#ifdef NODATE_DMA_STREAMS
+	DMA_device &instance = dmaList[device];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return 0; }
+	
+	DMA_channel &ch = instance.channels[index];
+	if (!ch.active) { return 0; }
+	
+	return (ch.regs->CR & DMA_SxCR_CT) ? 1 : 0;
+#else
+	return 0;
+#endif
+}
+
+
+// --- SET MEMORY ---
+// Sets the address of the memory buffer (0 or 1) of a stream in double-buffer mode. Only the
+// buffer which is not currently accessed by the stream can be changed while it is running.
+bool DMA::setMemory(DMA_devices device, uint8_t channel, uint8_t memory, uint32_t* address) {
+#ifdef NODATE_DMA_STREAMS
+	DMA_device &instance = dmaList[device];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return false; }
+	
+	DMA_channel &ch = instance.channels[index];
+	if (!ch.active || !(ch.regs->CR & DMA_SxCR_DBM)) { return false; }
+	if ((ch.regs->CR & DMA_SxCR_EN) && memory == currentMemory(device, channel)) { return false; }
+	
+	if (memory == 0) 		{ ch.regs->M0AR = (uint32_t) address; }
+	else if (memory == 1) 	{ ch.regs->M1AR = (uint32_t) address; }
+	else { return false; }
 	
 	return true;
 #else
@@ -245,21 +766,26 @@ bool DMA::configureChannel(DMA_devices device, DMA_config config, DMA_callbacks
 // Stop any active DMA transfer.
 bool DMA::abort(DMA_devices device, uint8_t channel) {
 	DMA_device &instance = dmaList[device];
-#ifdef __stm32f0	
-	DMA_channel &ch = instance.channels[channel - 1];
+	uint8_t index;
+	if (!channelIndex(channel, index)) { return false; }
+	
+	DMA_channel &ch = instance.channels[index];
 	if (!ch.active) { return false; }
 	
+#ifdef NODATE_DMA_STREAMS
+	// Disable interrupts & the stream.
+	ch.regs->CR &= ~(DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE);
+	ch.regs->CR &= ~DMA_SxCR_EN;
+#else
 	// Disable interrupts.
 	ch.regs->CCR &= ~(DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_TEIE);
 	
 	// Disable the channel.
 	ch.regs->CCR &= ~DMA_CCR_EN;
+#endif
 	ch.active = false;
 	
 	return true;
-#else
-	return false;
-#endif
 }
 
 #endif
@@ -54,7 +54,8 @@ GPIO_instance* GPIO_instances() {
 	return instancesStatic;
 }
 
-//GPIO_instance* instancesStatic = GPIO_instances();
+// Built once at start-up, so that the 'active' flag persists and the RCC is only touched on first use.
+GPIO_instance* instancesStatic = GPIO_instances();
 
 bool afio_enabled = false;
 
@@ -64,7 +65,6 @@ bool GPIO::set_input(GPIO_ports port, uint8_t pin, GPIO_pupd pupd) {
 	// Validate port & pin.
 	if (pin > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -139,7 +139,6 @@ bool GPIO::set_output(GPIO_ports port, uint8_t pin, GPIO_pupd pupd, GPIO_out_typ
 	// Validate port & pin.
 	if (pin > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -239,7 +238,6 @@ bool GPIO::set_af(GPIO_ports port, uint8_t pin, uint8_t af) {
 	if (pin > 15) { return false; }
 	if (af > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -315,7 +313,6 @@ bool GPIO::set_af(GPIO_ports port, uint8_t pin, RccPeripheral per, uint8_t af, G
 	if (pin > 15) { return false; }
 	if (af > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -427,7 +424,6 @@ bool GPIO::set_af(GPIO_ports port, uint8_t pin, RccPeripheral per, uint8_t af, G
 bool GPIO::set_analog(GPIO_ports port, uint8_t pin) {
 	if (pin > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -455,7 +451,6 @@ bool GPIO::set_output_parameters(GPIO_ports port, uint8_t pin, GPIO_pupd pupd,
 	// Validate port & pin.
 	if (pin > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -539,7 +534,6 @@ bool GPIO::write(GPIO_ports port, uint8_t pin, GPIO_level level) {
 	
 	if (pin > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -552,12 +546,13 @@ bool GPIO::write(GPIO_ports port, uint8_t pin, GPIO_level level) {
 		}
 	}
 	
-	// Write to pin.
+	// Write to pin. The lower half of BSRR sets pins, the upper half resets them, which avoids
+	// a read-modify-write on ODR.
 	if (level == GPIO_LEVEL_LOW) {
-		instance.regs->ODR &= ~(0x1 << pin);
+		instance.regs->BSRR = (0x1 << (pin + 16));
 	}
 	else if (level == GPIO_LEVEL_HIGH) {
-		instance.regs->ODR |= (0x1 << pin);
+		instance.regs->BSRR = (0x1 << pin);
 	}
 	
 	return true;
@@ -570,6 +565,27 @@ bool GPIO::write(GpioPinDef def, GPIO_level level) {
 }
 
 
+// --- WRITE PORT ---
+// Set and clear multiple pins on a port with a single store. Pins present in both masks are set.
+bool GPIO::writePort(GPIO_ports port, uint16_t setMask, uint16_t clearMask) {
+	GPIO_instance &instance = instancesStatic[port];
+	
+	// Check if port is active, if not, try to activate it.
+	if (!instance.active) {
+		if (Rcc::enablePort((RccPort) port)) {
+			instance.active = true;
+		}
+		else {
+			return false;
+		}
+	}
+	
+	instance.regs->BSRR = ((uint32_t) clearMask << 16) | setMask;
+	
+	return true;
+}
+
+
 // --- WRITE ---
 // Write an analogue value to the pin.
 bool GPIO::write(GPIO_ports port, uint8_t pin, uint32_t level) {
@@ -584,7 +600,6 @@ uint8_t  GPIO::read(GPIO_ports port, uint8_t pin) {
 	uint8_t out = 0;
 	if (pin > 15) { return false; }
 	
-	GPIO_instance* instancesStatic = GPIO_instances();
 	GPIO_instance &instance = instancesStatic[port];
 	
 	// Check if port is active, if not, try to activate it.
@@ -10,6 +10,8 @@
 
 
 #include <gpio.h>
+#include <clock.h>
+#include <i2c_timing.h>
 
 
 const int i2c_count = 3;
@@ -28,10 +30,12 @@ I2C_device* I2C_list() {
 	i2c_devices[I2C_1].irqType = I2C1_IRQn;
 #else
 	i2c_devices[I2C_1].irqType = I2C1_EV_IRQn;
+	i2c_devices[I2C_1].irqErrType = I2C1_ER_IRQn;
 #endif
 #elif defined RCC_APB1ENR1_I2C1EN
 	i2c_devices[I2C_1].regs = I2C1;
 	i2c_devices[I2C_1].irqType = I2C1_EV_IRQn;
+	i2c_devices[I2C_1].irqErrType = I2C1_ER_IRQn;
 #endif
 
 #ifdef RCC_APB1ENR_I2C2EN
@@ -40,10 +44,12 @@ I2C_device* I2C_list() {
 	i2c_devices[I2C_2].irqType = I2C2_IRQn;
 #else
 	i2c_devices[I2C_2].irqType = I2C2_EV_IRQn;
+	i2c_devices[I2C_2].irqErrType = I2C2_ER_IRQn;
 #endif
 #elif defined RCC_APB1ENR1_I2C2EN
 	i2c_devices[I2C_2].regs = I2C2;
 	i2c_devices[I2C_2].irqType = I2C2_EV_IRQn;
+	i2c_devices[I2C_2].irqErrType = I2C2_ER_IRQn;
 #endif
 
 #ifdef RCC_APB1ENR_I2C3EN
@@ -52,56 +58,337 @@ I2C_device* I2C_list() {
 	i2c_devices[I2C_3].irqType = I2C3_IRQn;
 #else
 	i2c_devices[I2C_3].irqType = I2C3_EV_IRQn;
+	i2c_devices[I2C_3].irqErrType = I2C3_ER_IRQn;
 #endif
 #elif defined RCC_APB1ENR1_I2C3EN
 	i2c_devices[I2C_3].regs = I2C3;
 	i2c_devices[I2C_3].irqType = I2C3_EV_IRQn;
+	i2c_devices[I2C_3].irqErrType = I2C3_ER_IRQn;
 #endif
 	
 	return i2c_devices;
 }
 
 
-// FIXME: hard-coding I2C timings isn't ideal. Neither is dynamically calculating them.
-uint32_t i2c_timings_4[4];
-uint32_t i2c_timings_8[4];
-uint32_t i2c_timings_16[4];
-uint32_t i2c_timings_48[4];
-uint32_t i2c_timings_54[4];
-
-bool I2C_timings() {
-#if !defined __stm32f1 && !defined __stm32f4
-	// 4khz and 54khz timings are based on max rise and fall times
-	i2c_timings_4[0] = 0x004091F3;
-	i2c_timings_4[1] = 0x00400D10;
-	i2c_timings_4[2] = 0x00100002;
-	i2c_timings_4[3] = 0x00000001;
-	i2c_timings_8[0] = 0x1042C3C7;
-	i2c_timings_8[1] = 0x10420F13;
-	i2c_timings_8[2] = 0x00310309;
-	i2c_timings_8[3] = 0x00100306;
-	i2c_timings_16[0] = 0x3042C3C7;
-	i2c_timings_16[1] = 0x30420F13;
-	i2c_timings_16[2] = 0x10320309;
-	i2c_timings_16[3] = 0x00200204;
-	i2c_timings_48[0] = 0xB042C3C7;
-	i2c_timings_48[1] = 0xB0420F13;
-	i2c_timings_48[2] = 0x50330309;
-	i2c_timings_48[3] = 0x50100103;
-	i2c_timings_54[0] = 0xD0417BFF;
-	i2c_timings_54[1] = 0x40D32A31;
-	i2c_timings_54[2] = 0x10A60D20;
-	i2c_timings_54[3] = 0x00900916;
+I2C_device* i2cList = I2C_list();
+
+
+// SCL frequency in Hz for each of the I2C modes.
+const uint32_t i2c_mode_frequency[] = { 10000, 100000, 400000, 1000000 };
+
+
+#ifndef HSI_VALUE
+#if defined STM32F0 || defined STM32F1
+	#define HSI_VALUE    ((uint32_t)8000000)
+#else
+	#define HSI_VALUE    ((uint32_t)16000000)
+#endif
 #endif
 
-	return true;
+
+// --- I2C CLOCK ---
+// Returns the I2C kernel clock: PCLK1, or the HSI/SYSCLK for I2C1 on F0.
+static uint32_t i2cClock(I2C_devices device) {
+#if defined STM32F0
+	if (device == I2C_1) {
+		return (RCC->CFGR3 & RCC_CFGR3_I2C1SW) ? Clock::currentSysClock() : HSI_VALUE;
+	}
+	
+	return Clock::currentSysClock() >> APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE_Msk) >> RCC_CFGR_PPRE_Pos)];
+#else
+	return Clock::currentSysClock() >> APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos)];
+#endif
 }
 
 
-I2C_device* i2cList = I2C_list();
+// --- ASYNCHRONOUS TRANSFERS ---
+// Interrupt-driven master transfers: an optional write phase, followed by a read phase after a
+// repeated START. On F0 & F7 the data phases use DMA if channels are available.
+
+#if defined NODATE_DMA_ENABLED && !defined __stm32f1 && !defined __stm32f4
+// Gives the DMA channels back, as they are shared with other peripherals (e.g. with SPI1 & USART1
+// on F0). Active channels are aborted.
+static void i2cDmaRelease(I2C_device &instance) {
+	DMA::release(instance.dmaTx);
+	DMA::release(instance.dmaRx);
+	instance.dmaActive = false;
+}
+#endif
+
+
+// Ends the transfer, then calls the callback.
+static void i2cXferDone(I2C_device &instance, bool error) {
+#if defined __stm32f1 || defined __stm32f4
+	instance.regs->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN);
+	instance.regs->CR1 &= ~I2C_CR1_POS;
+#else
+	// RXIE stays enabled for the receive callback set up by startMaster().
+	instance.regs->CR1 &= ~(I2C_CR1_TXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE |
+									I2C_CR1_ERRIE | I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN);
+	instance.regs->CR1 |= I2C_CR1_RXIE;
+#ifdef NODATE_DMA_ENABLED
+	if (instance.dmaActive) { i2cDmaRelease(instance); }
+#endif
+#endif
+	
+	instance.xferError = error;
+	instance.xferState = I2C_XFER_IDLE;
+	if (instance.xferCallback) { instance.xferCallback(); }
+}
+
+
+#if defined __stm32f1 || defined __stm32f4
+// Generates the START. Everything else happens in the event interrupt.
+static void i2cXferStart(I2C_device &instance) {
+	instance.regs->CR1 |= I2C_CR1_ACK;
+	instance.regs->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN;
+	instance.regs->CR1 |= I2C_CR1_START;
+}
+
+
+// Event interrupt. Follows the EV5 - EV8 sequences from the reference manual. Reception ends as
+// described there for N = 1, 2 & > 2 bytes: the NACK & STOP of the last bytes are set while BTF
+// stalls the bus, so that they don't depend on the interrupt latency. Only N = 1 relies on
+// programming the STOP right after clearing ADDR.
+static void i2cXferEvent(I2C_device &instance) {
+	uint32_t sr1 = instance.regs->SR1;
+	
+	// EV5: START sent. Send the address with the direction bit.
+	if (sr1 & I2C_SR1_SB) {
+		uint8_t rw = (instance.xferState == I2C_XFER_READ) ? 1 : 0;
+		instance.regs->DR = (instance.xferAddress << 1) | rw;
+		return;
+	}
+	
+	// EV6: address acknowledged. Reading SR2 clears ADDR. A single byte read has to be NACKed,
+	// with the STOP programmed right after clearing ADDR. For two bytes, POS makes the NACK apply
+	// to the second byte. Reads of up to three bytes then continue on BTF, longer ones on RXNE.
+	if (sr1 & I2C_SR1_ADDR) {
+		if (instance.xferState != I2C_XFER_READ) {
+			(void) instance.regs->SR2;
+			return;
+		}
+		
+		uint16_t len = instance.rxLen;
+		if (len == 2) { instance.regs->CR1 |= I2C_CR1_POS; }
+		if (len <= 2) { instance.regs->CR1 &= ~I2C_CR1_ACK; }
+		if (len == 1 || len > 3) 	{ instance.regs->CR2 |= I2C_CR2_ITBUFEN; }
+		else 						{ instance.regs->CR2 &= ~I2C_CR2_ITBUFEN; }
+		(void) instance.regs->SR2;
+		if (len == 1) { instance.regs->CR1 |= I2C_CR1_STOP; }
+		return;
+	}
+	
+	if (instance.xferState == I2C_XFER_WRITE) {
+		if ((sr1 & I2C_SR1_TXE) && instance.xferPos < instance.txLen) {
+			// EV8: next byte. After the last one, wait for BTF without TXE interrupts.
+			instance.regs->DR = instance.txData[instance.xferPos++];
+			if (instance.xferPos == instance.txLen) { instance.regs->CR2 &= ~I2C_CR2_ITBUFEN; }
+		}
+		else if ((sr1 & I2C_SR1_BTF) && instance.xferPos == instance.txLen) {
+			// EV8_2: all bytes sent. Repeated START for the read phase, or STOP.
+			if (instance.rxLen > 0) {
+				instance.xferState = I2C_XFER_READ;
+				instance.xferPos = 0;
+				instance.regs->CR1 |= I2C_CR1_ACK;
+				instance.regs->CR1 |= I2C_CR1_START;
+			}
+			else {
+				instance.regs->CR1 |= I2C_CR1_STOP;
+				i2cXferDone(instance, false);
+			}
+		}
+	}
+	else if (instance.xferState == I2C_XFER_READ) {
+		uint16_t left = instance.rxLen - instance.xferPos;
+		if ((sr1 & I2C_SR1_BTF) && left == 3) {
+			// Byte N-2 in DR, N-1 in the shift register. NACK byte N, then read N-2.
+			instance.regs->CR1 &= ~I2C_CR1_ACK;
+			instance.rxData[instance.xferPos++] = instance.regs->DR;
+		}
+		else if ((sr1 & I2C_SR1_BTF) && left == 2) {
+			// Byte N-1 in DR, N in the shift register. STOP, then read both.
+			instance.regs->CR1 |= I2C_CR1_STOP;
+			instance.rxData[instance.xferPos++] = instance.regs->DR;
+			instance.rxData[instance.xferPos++] = instance.regs->DR;
+			i2cXferDone(instance, false);
+		}
+		else if ((sr1 & I2C_SR1_RXNE) && (left == 1 || left > 3)) {
+			// EV7: read the byte. The last three bytes are handled on BTF.
+			instance.rxData[instance.xferPos++] = instance.regs->DR;
+			if (left == 1) 		{ i2cXferDone(instance, false); }
+			else if (left == 4) { instance.regs->CR2 &= ~I2C_CR2_ITBUFEN; }
+		}
+	}
+}
+
+
+// Error interrupt: NACK, bus error, arbitration lost or overrun. Releases the bus after a NACK.
+static void i2cXferError(I2C_device &instance) {
+	uint32_t sr1 = instance.regs->SR1;
+	uint32_t flags = I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR;
+	instance.regs->SR1 = ~(sr1 & flags) & 0xFFFF;
+	if (sr1 & I2C_SR1_AF) { instance.regs->CR1 |= I2C_CR1_STOP; }
+	
+	if (instance.xferState != I2C_XFER_IDLE) { i2cXferDone(instance, true); }
+}
+#else
+// Programs CR2 for the read or write phase & generates a (repeated) START. NBYTES is limited to
+// 255, longer phases are continued via reload. The STOP follows automatically after the last phase.
+static void i2cXferPhase(I2C_device &instance, bool read, uint16_t len, bool last) {
+	uint16_t chunk = (len > 255) ? 255 : len;
+	instance.xferLeft = len - chunk;
+	uint32_t reg_cr2 = (instance.xferAddress << 1) | ((uint32_t) chunk << I2C_CR2_NBYTES_Pos) | I2C_CR2_START;
+	if (read) 						{ reg_cr2 |= I2C_CR2_RD_WRN; }
+	if (instance.xferLeft > 0) 		{ reg_cr2 |= I2C_CR2_RELOAD; }
+	else if (last) 					{ reg_cr2 |= I2C_CR2_AUTOEND; }
+	instance.regs->CR2 = reg_cr2;
+}
+
 
-// Populate I2C timings.
-bool i2c_init = I2C_timings();
+// Enables the interrupts & DMA requests and generates the START.
+static void i2cXferStart(I2C_device &instance) {
+	instance.regs->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+	uint32_t reg_cr1 = I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
+#ifdef NODATE_DMA_ENABLED
+	if (instance.dmaActive) {
+		if (instance.txLen > 0) { reg_cr1 |= I2C_CR1_TXDMAEN; }
+		if (instance.rxLen > 0) { reg_cr1 |= I2C_CR1_RXDMAEN; }
+		instance.regs->CR1 &= ~I2C_CR1_RXIE;
+	}
+	else {
+		reg_cr1 |= I2C_CR1_TXIE | I2C_CR1_RXIE;
+	}
+#else
+	reg_cr1 |= I2C_CR1_TXIE | I2C_CR1_RXIE;
+#endif
+	instance.regs->CR1 |= reg_cr1;
+	
+	if (instance.xferState == I2C_XFER_WRITE) 	{ i2cXferPhase(instance, false, instance.txLen, instance.rxLen == 0); }
+	else 										{ i2cXferPhase(instance, true, instance.rxLen, true); }
+}
+
+
+// Event interrupt. With DMA, only the phase changes and the STOP are handled here.
+static void i2cXferEvent(I2C_device &instance) {
+	uint32_t isr = instance.regs->ISR;
+	
+	// Bus error, arbitration lost or overrun. The peripheral releases the bus itself.
+	if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)) {
+		instance.regs->ICR = I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+		if (instance.xferState != I2C_XFER_IDLE) { i2cXferDone(instance, true); }
+		return;
+	}
+	
+	if (instance.xferState == I2C_XFER_IDLE) { return; }
+	
+	// NACK: end with a STOP, unless one is generated automatically, then wait for STOPF.
+	if (isr & I2C_ISR_NACKF) {
+		instance.regs->ICR = I2C_ICR_NACKCF;
+		instance.xferError = true;
+		if (!(instance.regs->CR2 & I2C_CR2_AUTOEND)) { instance.regs->CR2 |= I2C_CR2_STOP; }
+		instance.xferState = I2C_XFER_STOP;
+	}
+	
+	if ((isr & I2C_ISR_TXIS) && instance.xferState == I2C_XFER_WRITE && instance.xferPos < instance.txLen) {
+		instance.regs->TXDR = instance.txData[instance.xferPos++];
+	}
+	
+	if ((isr & I2C_ISR_RXNE) && instance.xferState == I2C_XFER_READ && instance.xferPos < instance.rxLen) {
+		instance.rxData[instance.xferPos++] = instance.regs->RXDR;
+	}
+	
+	if ((isr & I2C_ISR_TCR) && instance.xferState != I2C_XFER_STOP) {
+		// Reload: continue the phase with the next chunk.
+		uint16_t chunk = (instance.xferLeft > 255) ? 255 : instance.xferLeft;
+		instance.xferLeft -= chunk;
+		uint32_t reg_cr2 = instance.regs->CR2 & ~(I2C_CR2_NBYTES | I2C_CR2_RELOAD | I2C_CR2_START);
+		reg_cr2 |= ((uint32_t) chunk << I2C_CR2_NBYTES_Pos);
+		if (instance.xferLeft > 0) { reg_cr2 |= I2C_CR2_RELOAD; }
+		else if (instance.xferState == I2C_XFER_READ || instance.rxLen == 0) { reg_cr2 |= I2C_CR2_AUTOEND; }
+		instance.regs->CR2 = reg_cr2;
+	}
+	else if ((isr & I2C_ISR_TC) && instance.xferState == I2C_XFER_WRITE) {
+		// Write phase done without AUTOEND: repeated START for the read phase.
+		instance.xferState = I2C_XFER_READ;
+		instance.xferPos = 0;
+		i2cXferPhase(instance, true, instance.rxLen, true);
+	}
+	
+	if (isr & I2C_ISR_STOPF) {
+		instance.regs->ICR = I2C_ICR_STOPCF;
+		instance.regs->CR2 = 0x0;
+		i2cXferDone(instance, instance.xferError);
+	}
+}
+
+
+// Error interrupt (F7 & L4). Shares the handling with the event interrupt.
+static void i2cXferError(I2C_device &instance) {
+	i2cXferEvent(instance);
+}
+
+
+#ifdef NODATE_DMA_ENABLED
+// DMA error callback, with the I2C device as context.
+static void i2cDmaError(void* ctx) { i2cXferDone(*((I2C_device*) ctx), true); }
+
+
+// Sets up the DMA channels for the phases of the transfer. The transfers start with the requests
+// from the peripheral. Only the directions used are acquired, and none are kept on failure.
+static bool i2cXferDma(I2C_device &instance) {
+	if (instance.txLen > 0 && !DMA::acquire(instance.per, DMA_DIR_TX, instance.dmaTx)) {
+		return false;
+	}
+	
+	if (instance.rxLen > 0 && !DMA::acquire(instance.per, DMA_DIR_RX, instance.dmaRx)) {
+		i2cDmaRelease(instance);
+		return false;
+	}
+	
+	DMA_callbacks cbs;
+	cbs.error = i2cDmaError;
+	cbs.ctx = &instance;
+	
+	DMA_config cfg;
+	cfg.prio = DMA_PRIO_MEDIUM;
+	cfg.src_size = 1;
+	cfg.des_size = 1;
+	cfg.circular = false;
+	if (instance.txLen > 0) {
+		cfg.channel = instance.dmaTx.channel;
+		cfg.request = instance.dmaTx.request;
+		cfg.dir = DMA_MEM_TO_PER;
+		cfg.source = (uint32_t*) instance.txData;
+		cfg.target = (uint32_t*) &(instance.regs->TXDR);
+		cfg.count = instance.txLen;
+		cfg.src_incr = true;
+		cfg.des_incr = false;
+		if (!DMA::configureChannel(instance.dmaTx.device, cfg, cbs)) {
+			i2cDmaRelease(instance);
+			return false;
+		}
+	}
+	
+	if (instance.rxLen > 0) {
+		cfg.channel = instance.dmaRx.channel;
+		cfg.request = instance.dmaRx.request;
+		cfg.dir = DMA_PER_TO_MEM;
+		cfg.source = (uint32_t*) &(instance.regs->RXDR);
+		cfg.target = (uint32_t*) instance.rxData;
+		cfg.count = instance.rxLen;
+		cfg.src_incr = false;
+		cfg.des_incr = true;
+		if (!DMA::configureChannel(instance.dmaRx.device, cfg, cbs)) {
+			i2cDmaRelease(instance);
+			return false;
+		}
+	}
+	
+	return true;
+}
+#endif
+#endif
 
 
 // Callback handlers.
@@ -122,6 +409,10 @@ extern "C" {
 
 void I2C1_IRQHandler(void) {
 	I2C_device &instance = i2cList[0];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
 	
 	// Verify interrupt status.
 	if ((instance.regs->ISR & I2C_ISR_RXNE) == I2C_ISR_RXNE) {
@@ -133,7 +424,11 @@ void I2C1_IRQHandler(void) {
 
 void I2C2_IRQHandler(void) {
 	I2C_device &instance = i2cList[1];
-
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	// Verify interrupt status.
 	if ((instance.regs->ISR & I2C_ISR_RXNE) == I2C_ISR_RXNE) {
 		// Read byte (which clears RXNE flag).
@@ -144,7 +439,11 @@ void I2C2_IRQHandler(void) {
 
 void I2C3_IRQHandler(void) {
 	I2C_device &instance = i2cList[2];
-
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	// Verify interrupt status.
 	if ((instance.regs->ISR & I2C_ISR_RXNE) == I2C_ISR_RXNE) {
 		// Read byte (which clears RXNE flag).
@@ -182,6 +481,11 @@ volatile uint8_t Buffer_Rx3[255];
 
 void I2C1_EV_IRQHandler(void) {
 	I2C_device &instance = i2cList[0];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	/* The following must remain volatile.  Optimization may result in unexpected
 	 * register reads that can cause unplanned interrupts
 	 */
@@ -258,6 +562,11 @@ void I2C1_EV_IRQHandler(void) {
  */
 void I2C2_EV_IRQHandler(void) {
 	I2C_device &instance = i2cList[1];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	/* The following must remain volatile.  Optimization may result in unexpected
 	 * register reads that can cause unplanned interrupts
 	 */
@@ -334,6 +643,11 @@ void I2C2_EV_IRQHandler(void) {
  */
 void I2C3_EV_IRQHandler(void) {
 	I2C_device &instance = i2cList[2];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	/* The following must remain volatile.  Optimization may result in unexpected
 	 * register reads that can cause unplanned interrupts
 	 */
@@ -410,6 +724,10 @@ extern "C" {
 
 void I2C1_EV_IRQHandler(void) {
 	I2C_device &instance = i2cList[0];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
 	
 	// Verify interrupt status.
 	if ((instance.regs->ISR & I2C_ISR_RXNE) == I2C_ISR_RXNE) {
@@ -422,6 +740,11 @@ void I2C1_EV_IRQHandler(void) {
 
 void I2C2_EV_IRQHandler(void) {
 	I2C_device &instance = i2cList[1];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	if ((instance.regs->ISR & I2C_ISR_RXNE) == I2C_ISR_RXNE) {
 		i2c_rxb = instance.regs->RXDR;
 		instance.callback(i2c_rxb);
@@ -431,6 +754,11 @@ void I2C2_EV_IRQHandler(void) {
 
 void I2C3_EV_IRQHandler(void) {
 	I2C_device &instance = i2cList[2];
+	if (instance.xferState != I2C_XFER_IDLE) {
+		i2cXferEvent(instance);
+		return;
+	}
+	
 	if ((instance.regs->ISR & I2C_ISR_RXNE) == I2C_ISR_RXNE) {
 		i2c_rxb = instance.regs->RXDR;
 		instance.callback(i2c_rxb);
@@ -439,6 +767,30 @@ void I2C3_EV_IRQHandler(void) {
 #endif
 
 
+#if !defined __stm32f0
+extern "C" {
+	void I2C1_ER_IRQHandler(void);
+	void I2C2_ER_IRQHandler(void);
+	void I2C3_ER_IRQHandler(void);
+}
+
+
+void I2C1_ER_IRQHandler(void) {
+	i2cXferError(i2cList[0]);
+}
+
+
+void I2C2_ER_IRQHandler(void) {
+	i2cXferError(i2cList[1]);
+}
+
+
+void I2C3_ER_IRQHandler(void) {
+	i2cXferError(i2cList[2]);
+}
+#endif
+
+
 // --- START I2C ---
 // Perform basic initialisation of I2C peripheral. After this the device can be further configured
 // as Master or Slave device using the appropriate method.
@@ -503,143 +855,56 @@ bool I2C::startI2C(I2C_devices device, GPIO_ports scl_port, uint8_t scl_pin, uin
 }
 
 
+// --- SET BUS TIMES ---
+// Set the SCL/SDA rise & fall times in ns of the bus, as used by startMaster() to calculate the
+// bus timing. Defaults are i2c_rise_time_default & i2c_fall_time_default.
+bool I2C::setBusTimes(I2C_devices device, uint32_t rise, uint32_t fall) {
+	I2C_device &instance = i2cList[device];
+	instance.riseTime = rise;
+	instance.fallTime = fall;
+	
+	return true;
+}
+
+
 // --- START MASTER ---
 // Start I2C master mode on the target I2C peripheral.
 bool I2C::startMaster(I2C_devices device, I2C_modes mode, std::function<void(uint8_t)> callback) {
 	I2C_device &instance = i2cList[device];
-#if defined STM32F0 || defined STM32F1
-	#define HSI_VALUE    ((uint32_t)8000000)
-#elif defined STM32F4 || defined STM32L4 || defined STM32F7
-	#define HSI_VALUE    ((uint32_t)16000000)
-#endif
+	if (!instance.active) { return false; } // Interface isn't active yet.
+	
+	// Timing for the current I2C clock, mode and bus rise & fall times.
+	uint32_t i2cclk = i2cClock(device);
+	uint32_t frequency = i2c_mode_frequency[mode];
 
 	// Note that the STM32F1 and STM32F4 (with one exception) series do not support Fast+ mode
 #if defined STM32F1 || defined STM32F4
-	// Disable I2C
+	uint32_t ccr = I2C_timing::ccr(i2cclk, frequency, instance.riseTime);
+	uint32_t freqrange = I2C_timing::cr2Freq(i2cclk);
+	if (ccr == 0) { return false; }
+	if (freqrange < 2 || freqrange > 50) { return false; }
+	if (mode == I2C_MODE_FM && freqrange < 4) { return false; }
+	
+	// Disable & reset I2C.
 	instance.regs->CR1 &= ~(I2C_CR1_PE);
-	/*Reset I2C*/
 	instance.regs->CR1 |= I2C_CR1_SWRST;
 	instance.regs->CR1 &= ~(I2C_CR1_SWRST);
-	// Get PCLK1 frequency
-	uint32_t pclk1 = SystemCoreClock >> APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos)];
-	// Calculate peripheral frequency range in Mhz
-	uint32_t freqrange = pclk1/1000000U;
-	if (freqrange > 50U) return false;  // max freq is 50 Mhz
-	// Check the minimum allowed PCLK1 frequency (dependent on I2C speed)
-	switch (mode) {
-	case I2C_MODE_SM10:
-	case I2C_MODE_SM100:
-		if (freqrange < 2U)
-			return false;
-		break;
-	case I2C_MODE_FM:
-		if (freqrange < 4U)
-			return false;
-		break;
-	default:
-		return false;
-	}
-	// configure the frequency range in the CR2 register
+	
 	instance.regs->CR2 &= ~(I2C_CR2_FREQ);
 	instance.regs->CR2 |= (freqrange << I2C_CR2_FREQ_Pos);
-	// configure rise time in TRISE register
-	uint32_t riseTime;
-	switch (mode) {
-	case I2C_MODE_SM10:
-	case I2C_MODE_SM100:
-		instance.regs->TRISE &= ~(I2C_TRISE_TRISE);
-		instance.regs->TRISE |= (freqrange + 1) << I2C_TRISE_TRISE_Pos;
-		break;
-	case I2C_MODE_FM:
-		instance.regs->TRISE &= ~(I2C_TRISE_TRISE);
-		instance.regs->TRISE |= (((freqrange * 300) / 1000) + 1) << I2C_TRISE_TRISE_Pos;
-		break;
-	default:
-		return false;
-	}
-	// configure Speed in CCR register
-	instance.regs->CCR &= ~(I2C_CCR_FS);
-	uint32_t pclk1Period;
-	uint32_t ccr;
-	switch(mode) {
-		case I2C_MODE_SM10:
-			// at 10 Khz and a default duty cycle of 50%, Thigh = Tlow = ~50us = 50000ns
-			pclk1Period = 1000/freqrange;
-			ccr = (50000u / pclk1Period)+1;  // round up to prevent overspeed
-			if (ccr < 4u) ccr = 4u;
-		case I2C_MODE_SM100:
-			// at 100 Khz and a default duty cycle of 50%, Thigh = Tlow = ~5us =  5000ns
-			// these are acceptable per datasheet
-			pclk1Period = 1000/freqrange;
-			ccr = (5000u / pclk1Period)+1;  // round up to prevent overspeed
-			if (ccr < 4u) ccr = 4u;
-			break;
-		case I2C_MODE_FM:
-			instance.regs->CCR |= I2C_CCR_FS;
-			instance.regs->CCR |= I2C_CCR_DUTY;
-			// at 400 Khz and Thigh/Tlow = 19/6, I2C period = Thigh+Tlow = 250 ns
-			pclk1Period = 1000/freqrange;
-			ccr = (250u / ((19+6)*pclk1Period))+1;  // round up to prevent overspeed
-			if (ccr < 1u) ccr = 1u;
-			break;
-		default:
-			// should have already been caught by earlier case statements, but just in case ...
-			return false;
-	}
-	instance.regs->CCR &= ~(I2C_CCR_CCR);
-	instance.regs->CCR |= ccr << I2C_CCR_CCR_Pos;
-	// Enable I2C
-	instance.regs->CR1 |= I2C_CR1_PE;
+	instance.regs->TRISE = I2C_timing::trise(i2cclk, frequency) << I2C_TRISE_TRISE_Pos;
+	instance.regs->CCR = ccr;
 #else
-	uint32_t i2cClock;
-	uint32_t divisor;
-	// Check status. Set parameters.
-	if (!instance.active) { return false; } // Interface isn't active yet.
-	
-	// Determine I2C clock source and frequency
-	divisor = (RCC->CFGR & RCC_CFGR_HPRE_Msk) >> RCC_CFGR_HPRE_Pos;
-	if (divisor != 0) {
-		divisor = divisor - 7;
-		if (divisor > 4) divisor++;
-		i2cClock = SystemCoreClock >> divisor;
-	}
-	else {
-		i2cClock = SystemCoreClock;
-	}
-#if defined STM32F0
-	divisor = (RCC->CFGR & RCC_CFGR_PPRE_Msk) >> RCC_CFGR_PPRE_Pos;
-#else
-	divisor = (RCC->CFGR & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos;
-#endif
-	if (divisor != 0) {
-		divisor = divisor - 3;
-		i2cClock = i2cClock >> divisor;
-	}
-#if defined STM32F0
-	if (device == I2C_1) {
-		i2cClock = HSI_VALUE;
-	}
-#endif
-	// Set timing register.
-	if (i2cClock == 4000000) {
-		instance.regs->TIMINGR = i2c_timings_4[mode];
-	}
-	else if (i2cClock == 8000000) {
-		instance.regs->TIMINGR = i2c_timings_8[mode];
-	}
-	else if (i2cClock == 16000000) {
-		instance.regs->TIMINGR = i2c_timings_16[mode];
-	}
-	else if (i2cClock == 48000000) {
-		instance.regs->TIMINGR = i2c_timings_48[mode];
-	}
-	else if (i2cClock == 54000000) {
-		instance.regs->TIMINGR = i2c_timings_54[mode];
-	}
-	else {
-		// Unavailable timing for this system clock.
+	uint32_t timing = I2C_timing::timingr(i2cclk, frequency, instance.riseTime, instance.fallTime);
+	if (timing == 0) {
+		// No valid timing for this I2C clock.
 		return false;
 	}
+	
+	// The timing register can only be written with the peripheral disabled.
+	instance.regs->CR1 &= ~(I2C_CR1_PE);
+	instance.regs->TIMINGR = timing;
+	
 	// Enable interrupts on peripheral.
 	instance.regs->CR1 |= I2C_CR1_RXIE;
 #endif
@@ -1311,10 +1576,148 @@ bool I2C::receiveFromMaster(I2C_devices device, uint32_t count, uint8_t* buffer)
 }
 
 
+// --- WRITE READ ---
+// Starts an asynchronous master transfer with the slave at the 7-bit address: 'txlen' bytes are
+// written, followed by a repeated START and 'rxlen' bytes being read. Either length can be zero,
+// for a write-only or read-only transfer. Returns as soon as the transfer has started. Completion
+// is signalled via the callback (called from the interrupt) and transferBusy(). Both buffers have
+// to remain valid until then.
+// Returns false if a transfer is already in progress or the bus is busy.
+bool I2C::writeRead(I2C_devices device, uint8_t address, const uint8_t* txdata, uint16_t txlen,
+											uint8_t* rxdata, uint16_t rxlen, I2C_done_cb cb) {
+	I2C_device &instance = i2cList[device];
+	if (!instance.active || !instance.master) { return false; }
+	if (instance.xferState != I2C_XFER_IDLE) { return false; }
+	if ((txlen == 0 && rxlen == 0) || (txlen > 0 && txdata == 0) || (rxlen > 0 && rxdata == 0)) {
+		return false;
+	}
+	
+#if defined __stm32f1 || defined __stm32f4
+	if ((instance.regs->SR2 & I2C_SR2_BUSY) || (instance.regs->CR1 & I2C_CR1_STOP)) { return false; }
+#else
+	if (instance.regs->ISR & I2C_ISR_BUSY) { return false; }
+#endif
+	
+	instance.xferAddress = address;
+	instance.txData = txdata;
+	instance.txLen = txlen;
+	instance.rxData = rxdata;
+	instance.rxLen = rxlen;
+	instance.xferPos = 0;
+	instance.xferCallback = cb;
+	instance.xferError = false;
+	instance.xferState = (txlen > 0) ? I2C_XFER_WRITE : I2C_XFER_READ;
+	
+#if defined NODATE_DMA_ENABLED && !defined __stm32f1 && !defined __stm32f4
+	instance.dmaActive = i2cXferDma(instance);
+#endif
+	
+	NVIC_EnableIRQ(instance.irqType);
+#if !defined __stm32f0
+	NVIC_SetPriority(instance.irqErrType, 0);
+	NVIC_EnableIRQ(instance.irqErrType);
+#endif
+	
+	i2cXferStart(instance);
+	
+	return true;
+}
+
+
+// --- TRANSFER BUSY ---
+// Returns true while an asynchronous transfer is in progress.
+bool I2C::transferBusy(I2C_devices device) {
+	return i2cList[device].xferState != I2C_XFER_IDLE;
+}
+
+
+// --- TRANSFER FAILED ---
+// Returns true if the last asynchronous transfer ended with an error, e.g. a NACK.
+bool I2C::transferFailed(I2C_devices device) {
+	return i2cList[device].xferError;
+}
+
+
+// --- ABORT ---
+// Ends an asynchronous transfer which did not complete, e.g. on a time-out. Sends a STOP.
+bool I2C::abort(I2C_devices device) {
+	I2C_device &instance = i2cList[device];
+	if (instance.xferState == I2C_XFER_IDLE) { return true; }
+	
+#if defined __stm32f1 || defined __stm32f4
+	instance.regs->CR1 |= I2C_CR1_STOP;
+#else
+	instance.regs->CR2 |= I2C_CR2_STOP;
+#endif
+	i2cXferDone(instance, true);
+	
+	return true;
+}
+
+
+// --- REGISTER ACCESS ---
+// Time-out in SysTicks (ms) for a register access, including waiting for the bus.
+const uint32_t i2cRegisterTimeout = 100;
+
+
+// --- TRANSFER ---
+// Runs a writeRead() transfer to completion: 'txlen' bytes are written, followed by a repeated
+// START and 'rxlen' bytes being read. Retries the start while the bus is busy. Blocks until done.
+// Relies on the I2C interrupt, so it cannot be used from an interrupt of the same or higher
+// priority.
+bool I2C::transfer(I2C_devices device, uint8_t address, const uint8_t* txdata, uint16_t txlen,
+														uint8_t* rxdata, uint16_t rxlen) {
+	uint32_t ts = McuCore::getSysTick();
+	while (!I2C::writeRead(device, address, txdata, txlen, rxdata, rxlen)) {
+		if ((McuCore::getSysTick() - ts) > i2cRegisterTimeout) { return false; }
+	}
+	
+	while (I2C::transferBusy(device)) {
+		if ((McuCore::getSysTick() - ts) > i2cRegisterTimeout) {
+			I2C::abort(device);
+			return false;
+		}
+	}
+	
+	return !I2C::transferFailed(device);
+}
+
+
+// --- READ REGISTERS ---
+// Reads 'len' bytes starting at register 'reg' of the slave, as a single transfer: the register
+// address is written, followed by a repeated START and the read. Blocks until done. Relies on
+// the I2C interrupt, so it cannot be used from an interrupt of the same or higher priority.
+bool I2C::readRegisters(I2C_devices device, uint8_t address, uint8_t reg, uint8_t* data, 
+																			uint16_t len) {
+	if (len == 0) { return false; }
+	
+	return transfer(device, address, &reg, 1, data, len);
+}
+
+
+// --- WRITE REGISTERS ---
+// Writes 'len' bytes (up to i2c_register_write_max) starting at register 'reg' of the slave, as
+// a single transfer. Blocks until done.
+bool I2C::writeRegisters(I2C_devices device, uint8_t address, uint8_t reg, 
+															const uint8_t* data, uint16_t len) {
+	if (len > i2c_register_write_max) { return false; }
+	
+	uint8_t buffer[i2c_register_write_max + 1];
+	buffer[0] = reg;
+	for (uint16_t i = 0; i < len; ++i) { buffer[i + 1] = data[i]; }
+	
+	return transfer(device, address, buffer, len + 1, 0, 0);
+}
+
+
 // --- STOP I2C ---
 // Stop I2C device and reset in preparation for new initialisation.
 bool I2C::stop(I2C_devices device) {
 	I2C_device &instance = i2cList[device];
+	abort(device);
+#if defined NODATE_DMA_ENABLED && !defined __stm32f1 && !defined __stm32f4
+	i2cDmaRelease(instance);
+#endif
 	instance.regs->CR1 &= ~I2C_CR1_PE;
 
 	// Disable interrupt.
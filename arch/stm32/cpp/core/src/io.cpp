@@ -29,10 +29,21 @@ extern "C" {
 int _write(int handle, char* data, int size) {
 	if (!stdout_active) { return 0; }
 	
-	int count = size;
-	while (count-- > 0) {
-		USART::sendUart(IO::usart, *data);
-		data++;
+	// Queue as much as possible in the USART's TX buffer, if it has one. Fall back to sending
+	// a single character, which blocks until there is room again, or polls without a buffer.
+	// A character which is dropped because the buffer can't drain is skipped, so that the caller
+	// doesn't retry it (see USART::txDropped()).
+	int count = 0;
+	while (count < size) {
+		uint16_t queued = USART::write(IO::usart, data + count, size - count);
+		if (queued == 0) {
+			uint32_t dropped = USART::txDropped(IO::usart);
+			if (!USART::sendUart(IO::usart, data[count]) && 
+							USART::txDropped(IO::usart) == dropped) { return count; }
+			queued = 1;
+		}
+		
+		count += queued;
 	}
 	
 	return size;
@@ -15,7 +15,7 @@ static const uint8_t handle_max = std::numeric_limits<uint8_t>::max();
 
 
 const int portCount = 11;
-const int peripheralCount = 47;
+const int peripheralCount = 49;
 bool getAHBprescaler(uint32_t divisor, uint32_t &AHBfield);
 bool getAPB1prescaler(uint32_t divisor, uint32_t &APB1field);
 bool getAPB2prescaler(uint32_t divisor, uint32_t &APB2field);
@@ -262,6 +262,10 @@ RccPeripheralHandle* peripheralHandles() {
 	peripheralHandlesStatic[RCC_DMA1].exists = true;
 	peripheralHandlesStatic[RCC_DMA1].enr = &(RCC->AHBENR);
 	peripheralHandlesStatic[RCC_DMA1].enable = RCC_AHBENR_DMAEN_Pos;
+#elif defined RCC_AHBENR_DMA1EN
+	peripheralHandlesStatic[RCC_DMA1].exists = true;
+	peripheralHandlesStatic[RCC_DMA1].enr = &(RCC->AHBENR);
+	peripheralHandlesStatic[RCC_DMA1].enable = RCC_AHBENR_DMA1EN_Pos;
 #elif defined RCC_AHB1ENR_DMA1EN
 	peripheralHandlesStatic[RCC_DMA1].exists = true;
 	peripheralHandlesStatic[RCC_DMA1].enr = &(RCC->AHB1ENR);
@@ -345,6 +349,12 @@ RccPeripheralHandle* peripheralHandles() {
 	peripheralHandlesStatic[RCC_TIM1].enable = RCC_APB2ENR_TIM1EN_Pos;
 #endif
 
+#ifdef RCC_APB2ENR_TIM8EN
+	peripheralHandlesStatic[RCC_TIM8].exists = true;
+	peripheralHandlesStatic[RCC_TIM8].enr = &(RCC->APB2ENR);
+	peripheralHandlesStatic[RCC_TIM8].enable = RCC_APB2ENR_TIM8EN_Pos;
+#endif
+
 #ifdef RCC_APB2ENR_SPI1EN
 	peripheralHandlesStatic[RCC_SPI1].exists = true;
 	peripheralHandlesStatic[RCC_SPI1].enr = &(RCC->APB2ENR);
@@ -427,6 +437,16 @@ RccPeripheralHandle* peripheralHandles() {
 	peripheralHandlesStatic[RCC_TIM4].enable = RCC_APB1ENR_TIM4EN_Pos;
 #endif
 
+#ifdef RCC_APB1ENR_TIM5EN
+	peripheralHandlesStatic[RCC_TIM5].exists = true;
+	peripheralHandlesStatic[RCC_TIM5].enr = &(RCC->APB1ENR);
+	peripheralHandlesStatic[RCC_TIM5].enable = RCC_APB1ENR_TIM5EN_Pos;
+#elif defined RCC_APB1ENR1_TIM5EN
+	peripheralHandlesStatic[RCC_TIM5].exists = true;
+	peripheralHandlesStatic[RCC_TIM5].enr = &(RCC->APB1ENR1);
+	peripheralHandlesStatic[RCC_TIM5].enable = RCC_APB1ENR1_TIM5EN_Pos;
+#endif
+
 #ifdef RCC_APB1ENR_TIM6EN
 	peripheralHandlesStatic[RCC_TIM6].exists = true;
 	peripheralHandlesStatic[RCC_TIM6].enr = &(RCC->APB1ENR);
@@ -585,15 +605,18 @@ RccPeripheralHandle* peripheralHandles() {
 	peripheralHandlesStatic[RCC_BKP].enable = RCC_APB1ENR_BKPEN_Pos;
 #endif
 
-/* #ifdef RCC_APB1ENR_DACEN
-	peripheralHandlesStatic[RCC_DAC].exists = true;
-	peripheralHandlesStatic[RCC_DAC].enr = &(RCC->APB1ENR);
-	peripheralHandlesStatic[RCC_DAC].enable = RCC_APB1ENR_DACEN_Pos;
-#elif defined RCC_APB1ENR1_DAC1EN */
 #if defined RCC_APB1ENR_DAC1EN
 	peripheralHandlesStatic[RCC_DAC1].exists = true;
 	peripheralHandlesStatic[RCC_DAC1].enr = &(RCC->APB1ENR);
 	peripheralHandlesStatic[RCC_DAC1].enable = RCC_APB1ENR_DAC1EN_Pos;
+#elif defined RCC_APB1ENR_DACEN
+	peripheralHandlesStatic[RCC_DAC1].exists = true;
+	peripheralHandlesStatic[RCC_DAC1].enr = &(RCC->APB1ENR);
+	peripheralHandlesStatic[RCC_DAC1].enable = RCC_APB1ENR_DACEN_Pos;
+#elif defined RCC_APB1ENR1_DAC1EN
+	peripheralHandlesStatic[RCC_DAC1].exists = true;
+	peripheralHandlesStatic[RCC_DAC1].enr = &(RCC->APB1ENR1);
+	peripheralHandlesStatic[RCC_DAC1].enable = RCC_APB1ENR1_DAC1EN_Pos;
 #endif
 
 #if defined RCC_APB1ENR_DAC2EN
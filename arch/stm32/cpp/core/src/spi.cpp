@@ -61,9 +61,61 @@ SPI_device* SPI_list() {
 SPI_device* spiList = SPI_list();
 
 
+// --- SPI CLOCK ---
+// Returns the PCLK frequency of the APB the device is on: APB2 for SPI1, 4 & 5, APB1 for SPI2 & 3.
+static uint32_t spiClock(SPI_devices device) {
+	uint32_t tmp;
+#if defined STM32F0
+	tmp = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE_Msk) >> RCC_CFGR_PPRE_Pos)];
+#else
+	if ((device == SPI_1) || (device == SPI_4) || (device == SPI_5)) {
+		tmp = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE2_Msk) >> RCC_CFGR_PPRE2_Pos)];
+	}
+	else {
+		tmp = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos)];
+	}
+#endif
+	
+	return SystemCoreClock >> tmp;
+}
+
+
+// --- CONFIGURATION BITS ---
+// Returns the CR1 bits for the configuration. The baud rate prescaler (PCLK/2 - PCLK/256) is the
+// smallest one which does not exceed the requested frequency. The resulting SCK frequency is
+// returned in 'frequency'.
+static uint32_t spiConfigBits(uint32_t pclk, const SPI_config &config, uint32_t &frequency) {
+	uint32_t br = 0;
+	while (br < 7 && (pclk >> (br + 1)) > config.frequency) { br++; }
+	frequency = pclk >> (br + 1);
+	
+	uint32_t bits = (br << SPI_CR1_BR_Pos);
+	if (config.mode & 0x2) 	{ bits |= SPI_CR1_CPOL; }
+	if (config.mode & 0x1) 	{ bits |= SPI_CR1_CPHA; }
+	if (config.lsbFirst) 	{ bits |= SPI_CR1_LSBFIRST; }
+	
+	return bits;
+}
+
+
+// --- FRAME SIZE BITS ---
+// Updates the CR1 & CR2 register values for 8- or 16-bit frames.
+static void spiFrameBits(SPI_frame_size size, uint32_t &reg_cr1, uint32_t &reg_cr2) {
+#ifdef SPI_CR2_DS
+	// Data size in CR2, with the RX FIFO threshold matching the frame size.
+	reg_cr2 &= ~(SPI_CR2_DS | SPI_CR2_FRXTH);
+	if (size == SPI_FRAME_16BIT) 	{ reg_cr2 |= SPI_CR2_DS; }
+	else 							{ reg_cr2 |= SPI_CR2_FRXTH | SPI_CR2_DS_2 | SPI_CR2_DS_1 | SPI_CR2_DS_0; }
+#else
+	if (size == SPI_FRAME_16BIT) 	{ reg_cr1 |= SPI_CR1_DFF; }
+	else 							{ reg_cr1 &= ~SPI_CR1_DFF; }
+#endif
+}
+
+
 // --- START SPI MASTER ---
-// Start the device in SPI mode.
-bool SPI::startSPIMaster(SPI_devices device, SPI_pins pins) {
+// Start the device in SPI mode, with the initial bus settings in 'config'.
+bool SPI::startSPIMaster(SPI_devices device, SPI_pins pins, SPI_config config) {
 	SPI_device &instance = spiList[device];
 	
 	// Check status. Set parameters.
@@ -115,36 +167,17 @@ bool SPI::startSPIMaster(SPI_devices device, SPI_pins pins) {
 		}
 	}
 	
-	// Configure SPI peripheral.
-	// TODO: enable configuring of CR1_BR for baud rates. Defaulting to Pclk/2.
-#ifdef STM32F0
-	uint32_t reg_cr1 = 0;
-	reg_cr1 |= SPI_CR1_BR; // Use Fpclk / 256.
-	instance.regs->CR1 = reg_cr1;
-	
-	// Use 8-bit mode.
-	uint32_t reg_cr2 = 0;
-	// FIFO reception threshold & Data Size.
-	reg_cr2 = SPI_CR2_FRXTH | SPI_CR2_DS_2 | SPI_CR2_DS_1 | SPI_CR2_DS_0;
-	instance.regs->CR2 = reg_cr2;
-#else
-	// Configure CPOL & CPHA.
-	// TODO: enable configuration. Use default (0 & 0) for now.
-	
-	// Configure DFF (data frame format). Default is 0x0 (8-bit).
-	
-	// Configure LSBFIRST. Default is 0x0 (MSB first).
-	
-	// Set CR2_FRF.
-	// FIXME: make configurable. Default is 0x0 (Motorola). Other option is TI (0x1).
-	
-#endif
-	// Set MSTR.
+	// Configure SPI peripheral: baud rate, clock polarity & phase, bit order and frame size.
+	// The frame format (CR2_FRF) is left at Motorola.
 	// MSTR has to be set to enable Master mode. Default is slave mode.
-	instance.regs->CR1 |= SPI_CR1_MSTR;
+	uint32_t reg_cr1 = SPI_CR1_MSTR | spiConfigBits(spiClock(device), config, instance.frequency);
 	
 	// Set NSS as output. Disables multi-master mode.
-	instance.regs->CR2 |= SPI_CR2_SSOE;
+	uint32_t reg_cr2 = SPI_CR2_SSOE;
+	spiFrameBits(config.frameSize, reg_cr1, reg_cr2);
+	instance.frameSize = config.frameSize;
+	instance.regs->CR2 = reg_cr2;
+	instance.regs->CR1 = reg_cr1;
 	
 	// Enable peripheral (SPE).
 	instance.regs->CR1 |= SPI_CR1_SPE;
@@ -233,92 +266,153 @@ bool SPI::startI2SSlave(SPI_devices device, I2S_pins pins) {
 }
 
 
-// -- SEND DATA ---
-bool SPI::sendData(SPI_devices device, uint8_t* data, uint16_t len) {
+// --- CONFIGURE ---
+// Applies the bus settings for the next transaction, e.g. when switching between slaves on a shared
+// bus. Waits for the current frame to finish. The peripheral is only briefly disabled if the
+// settings differ from the current ones.
+bool SPI::configure(SPI_devices device, const SPI_config &config) {
 	SPI_device &instance = spiList[device];
+	if (!instance.active) { return false; }
+#ifdef NODATE_DMA_ENABLED
+	if (instance.dmaBusy) { return false; }
+#endif
 	
-	// Write each byte into the DR register to transfer it.
-	for (uint16_t i = 0; i < len; ++i) {
-		// Check that the TX buffer is empty.
-		uint32_t ts = McuCore::getSysTick();
-		uint32_t timeout = 400; // TODO: make configurable.
-		while ((instance.regs->SR & SPI_SR_TXE) != SPI_SR_TXE) {
-			// Handle timeout.
-			if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
-				// TODO: set status.
-				//printf("SPI TXE time-out.\n");
-				return false;
-			}
-		}
-		
-		*((volatile uint8_t*) &(instance.regs->DR)) = data[i];
-	}
+	const uint32_t mask = SPI_CR1_BR | SPI_CR1_CPOL | SPI_CR1_CPHA | SPI_CR1_LSBFIRST;
+	uint32_t frequency;
+	uint32_t bits = spiConfigBits(spiClock(device), config, frequency);
+	uint32_t reg_cr1 = instance.regs->CR1;
+	if ((reg_cr1 & mask) == bits && instance.frameSize == config.frameSize) { return true; }
 	
-	// Wait for SR_TXE to indicate empty status.
-	uint32_t ts = McuCore::getSysTick();
-	uint32_t timeout = 400; // TODO: make configurable.
-	while ((instance.regs->SR & SPI_SR_TXE) != SPI_SR_TXE) {
-		if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
-			return false;
-		}
-	}
+	while (instance.regs->SR & SPI_SR_BSY) { }
+	instance.regs->CR1 = reg_cr1 & ~SPI_CR1_SPE;
 	
-	// Wait for SR_BSY to indicate bus not busy.
-	ts = McuCore::getSysTick();
-	while ((instance.regs->SR & SPI_SR_BSY) == SPI_SR_BSY) {
-		if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
-			return false;
-		}
-	}
+	reg_cr1 = (reg_cr1 & ~mask) | bits;
+	uint32_t reg_cr2 = instance.regs->CR2;
+	spiFrameBits(config.frameSize, reg_cr1, reg_cr2);
+	instance.regs->CR2 = reg_cr2;
+	instance.regs->CR1 = reg_cr1;
+	instance.frameSize = config.frameSize;
+	instance.frequency = frequency;
 	
-	// Read SPI_DR to clear it.
-	uint16_t t = instance.regs->DR;
+	return true;
+}
+
+
+// --- GET FREQUENCY ---
+// Returns the actual SCK frequency in Hz, or 0 if the device has not been started.
+uint32_t SPI::getFrequency(SPI_devices device) {
+	SPI_device &instance = spiList[device];
+	if (!instance.active) { return 0; }
 	
-	// Clear SR overrun flag.
-	t = instance.regs->SR;
+	return instance.frequency;
+}
+
+
+// --- SET FRAME SIZE ---
+// Sets 8- or 16-bit data frames. The peripheral is briefly disabled to change the frame size.
+bool SPI::setFrameSize(SPI_devices device, SPI_frame_size size) {
+	SPI_device &instance = spiList[device];
+	if (!instance.active) { return false; }
+	if (instance.frameSize == size) { return true; }
+	
+	uint32_t reg_cr1 = instance.regs->CR1;
+	uint32_t reg_cr2 = instance.regs->CR2;
+	instance.regs->CR1 = reg_cr1 & ~SPI_CR1_SPE;
+	spiFrameBits(size, reg_cr1, reg_cr2);
+	instance.regs->CR2 = reg_cr2;
+	instance.regs->CR1 = reg_cr1;
+	instance.frameSize = size;
 	
 	return true;
 }
 
 
-// --- RECEIVE DATA ---
-bool SPI::receiveData(SPI_devices device, uint8_t* data, uint16_t count) {
-	SPI_device &instance = spiList[device];
+// --- POLLED TRANSFERS ---
+// 8- and 16-bit accesses to the data register. With 8-bit frames, a 16-bit access to the FIFO
+// transfers two frames at once, the first in the low byte.
+#ifndef SPI_DR8
+#define SPI_DR8(regs) 	(*((__IO uint8_t*) &((regs)->DR)))
+#define SPI_DR16(regs) 	(*((__IO uint16_t*) &((regs)->DR)))
+#endif
+
+// F0, F3, F7 & L4 have 32-bit TX & RX FIFOs, the others a single frame buffer each way.
+#ifdef SPI_SR_FRLVL
+#define NODATE_SPI_FIFO
+#endif
+
+// The number of polling iterations between time-out checks.
+const uint16_t spiTimeoutPolls = 64;
+
+
+// Transfers max(txcount, rxcount) bytes. The TX data is followed by 0x00 bytes once it runs out,
+// and received bytes beyond rxcount are discarded. The TX side is kept ahead of the RX side, so
+// that the shifter does not idle between frames, but never by more than the receiver can buffer.
+static bool spiTransfer(SPI_device &instance, const uint8_t* txdata, uint16_t txcount, 
+														uint8_t* rxdata, uint16_t rxcount) {
+	uint16_t total = (txcount > rxcount) ? txcount : rxcount;
+	bool wide = (instance.frameSize == SPI_FRAME_16BIT);
+	if (wide && (total & 1)) { return false; }
 	
-	uint32_t timeout = 400;
-	uint32_t ts;
-	for (uint16_t i = 0; i < count; ++i) {
-		ts = McuCore::getSysTick();
-		// 1. Wait for SR_BSY to indicate bus not busy.
-		ts = McuCore::getSysTick();
-		while ((instance.regs->SR & SPI_SR_BSY) == SPI_SR_BSY) {
-			if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
-				return false;
+#ifdef NODATE_SPI_FIFO
+	const uint16_t limit = 4;
+	const bool pack = true;
+#else
+	const uint16_t limit = wide ? 4 : 2;
+	const bool pack = wide;
+#endif
+	
+	uint16_t txpos = 0;
+	uint16_t rxpos = 0;
+	uint16_t polls = 0;
+	uint32_t ts = McuCore::getSysTick();
+	uint32_t timeout = 400; // TODO: make configurable.
+	while (rxpos < total) {
+		uint32_t sr = instance.regs->SR;
+		
+		// Transmit: two bytes at a time where possible.
+		if ((sr & SPI_SR_TXE) && txpos < total) {
+			uint16_t chunk = (pack && (total - txpos) >= 2) ? 2 : 1;
+			if ((txpos - rxpos) + chunk <= limit) {
+				uint8_t lo = (txpos < txcount) ? txdata[txpos] : 0x00;
+				if (chunk == 2) {
+					uint8_t hi = (txpos + 1 < txcount) ? txdata[txpos + 1] : 0x00;
+					SPI_DR16(instance.regs) = (uint16_t) (lo | (hi << 8));
+				}
+				else {
+					SPI_DR8(instance.regs) = lo;
+				}
+				
+				txpos += chunk;
 			}
 		}
 		
-		// 2. Send dummy byte to generate a CLK signal.
-		*((volatile uint8_t*) &(instance.regs->DR)) = 0x00;
-	
-        // 3. Check SR_RXNE == 1. (Receive data register Not Empty).
-		ts = McuCore::getSysTick();
-        while ((instance.regs->SR & SPI_SR_RXNE) != SPI_SR_RXNE) {
-			// Handle timeout.
+		// Receive: two bytes at a time where available.
+#ifdef NODATE_SPI_FIFO
+		bool pair = (sr & SPI_SR_FRLVL_1) && (total - rxpos) >= 2;
+		bool single = !pair && (sr & SPI_SR_RXNE);
+#else
+		bool pair = wide && (sr & SPI_SR_RXNE);
+		bool single = !wide && (sr & SPI_SR_RXNE);
+#endif
+		if (pair) {
+			uint16_t data = SPI_DR16(instance.regs);
+			if (rxpos < rxcount) 		{ rxdata[rxpos] = (uint8_t) data; }
+			if (rxpos + 1 < rxcount) 	{ rxdata[rxpos + 1] = (uint8_t) (data >> 8); }
+			rxpos += 2;
+		}
+		else if (single) {
+			uint8_t data = SPI_DR8(instance.regs);
+			if (rxpos < rxcount) { rxdata[rxpos] = data; }
+			rxpos++;
+		}
+		
+		// Handle timeout.
+		if (++polls == spiTimeoutPolls) {
+			polls = 0;
 			if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
 				// TODO: set status.
 				return false;
 			}
-        }
-		
-        // 4. Read DR contents into buffer.
-		data[i] = (uint8_t) instance.regs->DR;
-	}
-	
-	// Wait for BSY to be unset.
-	ts = McuCore::getSysTick();
-	while ((instance.regs->SR & SPI_SR_BSY) == SPI_SR_BSY) {
-		if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
-			return false;
 		}
 	}
 	
@@ -326,64 +420,176 @@ bool SPI::receiveData(SPI_devices device, uint8_t* data, uint16_t count) {
 }
 
 
+// -- SEND DATA ---
+bool SPI::sendData(SPI_devices device, uint8_t* data, uint16_t len) {
+	SPI_device &instance = spiList[device];
+	
+	return spiTransfer(instance, data, len, 0, 0);
+}
+
+
+// --- RECEIVE DATA ---
+// Receives 'count' bytes, while sending 0x00 bytes.
+bool SPI::receiveData(SPI_devices device, uint8_t* data, uint16_t count) {
+	SPI_device &instance = spiList[device];
+	
+	return spiTransfer(instance, 0, 0, data, count);
+}
+
+
 // --- TRANSCEIVE DATA ---
-// Transmit the TX data buffer while receiving in the RX data buffer.
+// Transmit the TX data buffer while receiving in the RX data buffer. The first received byte is
+// the one clocked in with the first transmitted byte. Transfers the larger of both counts.
 bool SPI::transceiveData(SPI_devices device, uint8_t* txdata, uint16_t txcount,
 													uint8_t* rxdata, uint16_t rxcount) {
 	SPI_device &instance = spiList[device];
 	
-	bool txallowed = true;
-	uint32_t ts = McuCore::getSysTick();
-	uint32_t timeout = 400;
-	while (txcount > 0 && rxcount > 0) {
-		// Send phase.
-		// Check if the send buffer is empty.
-		if (((instance.regs->SR & SPI_SR_TXE) == SPI_SR_TXE) && txallowed) {
-			if (txcount > 0) {
-				instance.regs->DR = *txdata++;
-				txallowed = false;
-				txcount--;
-			}
-			else {
-				// Send dummy byte.
-				instance.regs->DR = 0x00;
-			}
-		}
+	return spiTransfer(instance, txdata, txcount, rxdata, rxcount);
+}
+
+
+#ifdef NODATE_DMA_ENABLED
+// --- DMA TRANSFER ---
+// Dummy frames for transfers which only transmit or only receive.
+static uint16_t spiDmaDummyTx = 0;
+static uint16_t spiDmaDummyRx;
+
+
+// Returns the DMA channels after a transfer, so that the peripherals sharing them can use them.
+static void spiDmaRelease(SPI_device &instance) {
+	instance.regs->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+	DMA::release(instance.dmaTx);
+	DMA::release(instance.dmaRx);
+}
+
+
+// Ends the DMA transfer. RX completes last, as it only finishes once all frames have been
+// clocked in, so the bus is idle at this point.
+static void spiDmaDone(SPI_device &instance, bool error) {
+	spiDmaRelease(instance);
 	
-		// Receive phase.
-		// Check if receive buffer has data.
-		if (((instance.regs->SR & SPI_SR_RXNE) == SPI_SR_RXNE) && rxcount > 0) {
-			// Read DR contents into buffer.
-			*rxdata++ = (uint8_t) instance.regs->DR;
-			txallowed = true;
-			rxcount--;
-		}
-		
-		// Handle timeout.
-		if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
-			// TODO: set status.
-			return false;
-		}
+	instance.dmaError = error;
+	instance.dmaBusy = false;
+	if (instance.dmaCallback) { instance.dmaCallback(); }
+}
+
+
+// DMA callbacks, with the SPI device as context.
+static void spiDmaComplete(void* ctx) 	{ spiDmaDone(*((SPI_device*) ctx), false); }
+static void spiDmaError(void* ctx) 		{ spiDmaDone(*((SPI_device*) ctx), true); }
+
+
+// --- TRANSFER DMA ---
+// Transmits & receives 'count' frames (8- or 16-bit, see setFrameSize()) using DMA, without
+// involving the CPU. Either buffer can be null, for transmit-only or receive-only transfers, in
+// which case dummy frames are used. Returns as soon as the transfer has started. Completion is
+// signalled via the callback (called from the DMA interrupt) and transferBusy().
+bool SPI::transferDMA(SPI_devices device, const void* txdata, void* rxdata, uint16_t count, 
+																		SPI_done_cb cb) {
+	SPI_device &instance = spiList[device];
+	if (!instance.active || instance.dmaBusy) { return false; }
+	if (count == 0 || (txdata == 0 && rxdata == 0)) { return false; }
+	if (!DMA::acquire(instance.per, DMA_DIR_TX, instance.dmaTx)) { return false; }
+	if (!DMA::acquire(instance.per, DMA_DIR_RX, instance.dmaRx)) {
+		// Don't keep the TX channel from the peripherals sharing it.
+		DMA::release(instance.dmaTx);
+		return false;
 	}
 	
-	// Wait until TX FIFO empty.
+	uint8_t size = (instance.frameSize == SPI_FRAME_16BIT) ? 2 : 1;
+	instance.dmaCallback = cb;
+	instance.dmaError = false;
+	instance.dmaBusy = true;
+	
+	// Drain any stale RX data and clear an overrun.
+	while (instance.regs->SR & SPI_SR_RXNE) { (void) instance.regs->DR; }
+	(void) instance.regs->SR;
+	
+	DMA_callbacks cbs;
+	cbs.error = spiDmaError;
+	cbs.ctx = &instance;
+	
+	// RX first, so that no frame can be missed once TX starts.
+	DMA_config rx;
+	rx.channel = instance.dmaRx.channel;
+	rx.request = instance.dmaRx.request;
+	rx.dir = DMA_PER_TO_MEM;
+	rx.source = (uint32_t*) &(instance.regs->DR);
+	rx.target = (uint32_t*) (rxdata ? rxdata : &spiDmaDummyRx);
+	rx.prio = DMA_PRIO_HIGH;
+	rx.count = count;
+	rx.src_size = size;
+	rx.des_size = size;
+	rx.circular = false;
+	rx.src_incr = false;
+	rx.des_incr = (rxdata != 0);
+	cbs.filled = spiDmaComplete;
+	if (!DMA::configureChannel(instance.dmaRx.device, rx, cbs)) {
+		spiDmaRelease(instance);
+		instance.dmaBusy = false;
+		return false;
+	}
 	
-	// Wait until BSY flag is clear.
+	instance.regs->CR2 |= SPI_CR2_RXDMAEN;
+	
+	DMA_config tx;
+	tx.channel = instance.dmaTx.channel;
+	tx.request = instance.dmaTx.request;
+	tx.dir = DMA_MEM_TO_PER;
+	tx.source = (uint32_t*) (txdata ? txdata : &spiDmaDummyTx);
+	tx.target = (uint32_t*) &(instance.regs->DR);
+	tx.prio = DMA_PRIO_MEDIUM;
+	tx.count = count;
+	tx.src_size = size;
+	tx.des_size = size;
+	tx.circular = false;
+	tx.src_incr = (txdata != 0);
+	tx.des_incr = false;
+	cbs.filled = 0;
+	if (!DMA::configureChannel(instance.dmaTx.device, tx, cbs)) {
+		spiDmaRelease(instance);
+		instance.dmaBusy = false;
+		return false;
+	}
+	
+	instance.regs->CR2 |= SPI_CR2_TXDMAEN;
 	
 	return true;
 }
 
 
+// --- TRANSFER BUSY ---
+// Returns true while a DMA transfer is in progress.
+bool SPI::transferBusy(SPI_devices device) {
+	return spiList[device].dmaBusy;
+}
+
+
+// --- TRANSFER FAILED ---
+// Returns true if the last DMA transfer ended with a DMA error.
+bool SPI::transferFailed(SPI_devices device) {
+	return spiList[device].dmaError;
+}
+#endif
+
+
 // --- STOP ---
 // Stop the peripheral.
-bool stop(SPI_devices device) {
+bool SPI::stop(SPI_devices device) {
 	SPI_device &instance = spiList[device];
 	
 	// Check status.
 	if (!instance.active) { return true; } // Already stopped.
 	
+#ifdef NODATE_DMA_ENABLED
+	// Abort any DMA transfer and return the DMA channels.
+	spiDmaRelease(instance);
+	instance.dmaBusy = false;
+#endif
+	
 	// Disable peripheral.
 	instance.regs->CR1 &= ~SPI_CR1_SPE;
+	instance.active = false;
 	
 	return true;
 }
@@ -11,6 +11,78 @@
 #ifdef NODATE_TIMER_ENABLED
 
 
+const int timer_count = 8;
+
+// --- TIMER DEVICES ---
+Timer_device* Timer_list() {
+	Timer_device item;
+	static Timer_device timer_devices[timer_count];
+	for (int i = 0; i < timer_count; ++i) {
+		timer_devices[i] = item;
+	}
+	
+#ifdef RCC_APB2ENR_TIM1EN
+	timer_devices[TIMER_1].regs = TIM1;
+	timer_devices[TIMER_1].per = RCC_TIM1;
+	timer_devices[TIMER_1].channels = 4;
+	timer_devices[TIMER_1].advanced = true;
+	timer_devices[TIMER_1].apb2 = true;
+#endif
+
+#if defined RCC_APB1ENR_TIM2EN || defined RCC_APB1ENR1_TIM2EN
+	timer_devices[TIMER_2].regs = TIM2;
+	timer_devices[TIMER_2].per = RCC_TIM2;
+	timer_devices[TIMER_2].channels = 4;
+#ifndef __stm32f1
+	timer_devices[TIMER_2].wide = true;
+#endif
+#endif
+
+#if defined RCC_APB1ENR_TIM3EN || defined RCC_APB1ENR1_TIM3EN
+	timer_devices[TIMER_3].regs = TIM3;
+	timer_devices[TIMER_3].per = RCC_TIM3;
+	timer_devices[TIMER_3].channels = 4;
+#endif
+
+#ifdef RCC_APB1ENR_TIM4EN
+	timer_devices[TIMER_4].regs = TIM4;
+	timer_devices[TIMER_4].per = RCC_TIM4;
+	timer_devices[TIMER_4].channels = 4;
+#endif
+
+#if defined RCC_APB1ENR_TIM5EN || defined RCC_APB1ENR1_TIM5EN
+	timer_devices[TIMER_5].regs = TIM5;
+	timer_devices[TIMER_5].per = RCC_TIM5;
+	timer_devices[TIMER_5].channels = 4;
+#ifndef __stm32f1
+	timer_devices[TIMER_5].wide = true;
+#endif
+#endif
+
+#if defined RCC_APB1ENR_TIM6EN || defined RCC_APB1ENR1_TIM6EN
+	timer_devices[TIMER_6].regs = TIM6;
+	timer_devices[TIMER_6].per = RCC_TIM6;
+#endif
+
+#if defined RCC_APB1ENR_TIM7EN || defined RCC_APB1ENR1_TIM7EN
+	timer_devices[TIMER_7].regs = TIM7;
+	timer_devices[TIMER_7].per = RCC_TIM7;
+#endif
+
+#ifdef RCC_APB2ENR_TIM8EN
+	timer_devices[TIMER_8].regs = TIM8;
+	timer_devices[TIMER_8].per = RCC_TIM8;
+	timer_devices[TIMER_8].channels = 4;
+	timer_devices[TIMER_8].advanced = true;
+	timer_devices[TIMER_8].apb2 = true;
+#endif
+	
+	return timer_devices;
+}
+
+Timer_device* timerList = Timer_list();
+
+
 // Delay counter
 //static volatile uint32_t DelayCounter;
 
@@ -51,23 +123,574 @@ Timer::~Timer() {
 
 
 // --- DELAY ---
+// Sleep for the given number of milliseconds, instead of spinning. Other interrupts are handled
+// in between.
 void Timer::delay(uint32_t ms) {
-	uint32_t start = McuCore::getSysTick();
-	uint32_t delay = ms;
+	McuCore::sleep(ms);
+}
+
+
+// --- CLOCK ---
+// Returns the timer kernel clock. Timers run at twice the APB clock if the APB prescaler isn't 1.
+uint32_t Timer::clock(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	uint32_t presc;
+#if defined STM32F0
+	presc = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE_Msk) >> RCC_CFGR_PPRE_Pos)];
+#else
+	if (instance.apb2) {
+		presc = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE2_Msk) >> RCC_CFGR_PPRE2_Pos)];
+	}
+	else {
+		presc = APBPrescTable[((RCC->CFGR & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos)];
+	}
+#endif
+	
+	uint32_t pclk = Clock::currentSysClock() >> presc;
+	return (presc == 0) ? pclk : pclk * 2;
+}
+
+
+// --- LOAD ---
+// Enable the timer if needed and load the prescaler (PSC + 1) and auto-reload (ARR) values.
+static bool timerLoad(Timer_device &instance, uint32_t prescaler, uint32_t reload) {
+	if (!instance.active) {
+		if (!Rcc::enable(instance.per)) { return false; }
+		instance.active = true;
+	}
+	
+	instance.prescaler = prescaler;
+	instance.reload = reload;
+	instance.regs->PSC = prescaler - 1;
+	instance.regs->ARR = reload;
+	
+	// Load the prescaler with an update event, without an interrupt. With MMS = Reset the update
+	// event is output on TRGO, so while the counter is stopped MMS = Enable holds TRGO low instead.
+	// A running counter with a trigger output selected loads the new values at its next update,
+	// so that no extra trigger reaches an ADC or DAC.
+	instance.regs->CR1 |= TIM_CR1_URS | TIM_CR1_ARPE;
+	uint32_t cr2 = instance.regs->CR2;
+	if (!(instance.regs->CR1 & TIM_CR1_CEN)) {
+		instance.regs->CR2 = (cr2 & ~TIM_CR2_MMS) | ((uint32_t) TIMER_TRGO_ENABLE << TIM_CR2_MMS_Pos);
+		instance.regs->EGR = TIM_EGR_UG;
+		instance.regs->SR = 0;
+		instance.regs->CR2 = cr2;
+	}
+	else if ((cr2 & TIM_CR2_MMS) == 0) {
+		instance.regs->EGR = TIM_EGR_UG;
+		instance.regs->SR = 0;
+	}
+	
+	return true;
+}
+
+
+// --- SET FREQUENCY ---
+// Set the prescaler & auto-reload values for an update event at the given frequency in Hz. The
+// lowest prescaler is used which allows the auto-reload value to fit in the counter, for the
+// highest resolution. The achieved frequency is returned by getFrequency() and getPeriod().
+bool Timer::setFrequency(TimerDevice device, uint32_t frequency) {
+	Timer_device &instance = timerList[device];
+	if (instance.regs == 0) { return false; }
+	
+	uint32_t clk = clock(device);
+	if (frequency == 0 || frequency > clk / 2) { return false; }
 	
-	// TODO: if () { }
+	// Timer clock cycles per update event, rounded to the nearest.
+	uint64_t period = ((uint64_t) clk + frequency / 2) / frequency;
+	uint64_t counter = instance.wide ? 0x100000000ULL : 0x10000ULL;
+	uint64_t prescaler = (period + counter - 1) / counter;
+	if (prescaler > 0x10000) { return false; }
 	
-	while ((McuCore::getSysTick() - start) < delay) { }
+	uint64_t reload = (period + prescaler / 2) / prescaler;
+	if (reload > counter) 	{ reload = counter; }
+	if (reload < 2) 		{ reload = 2; }
 	
-	// Enable the SysTick timer
-	//SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	return timerLoad(instance, (uint32_t) prescaler, (uint32_t) (reload - 1));
+}
 
-	// Wait for a specified number of milliseconds
-	//DelayCounter = 0;
-	//while (DelayCounter < ms);
 
-	// Disable the SysTick timer
-	//SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+// --- GET PERIOD ---
+// Returns the number of timer clock cycles per update event.
+uint64_t Timer::getPeriod(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	return (uint64_t) instance.prescaler * ((uint64_t) instance.reload + 1);
+}
+
+
+// --- GET FREQUENCY ---
+// Returns the achieved update frequency in Hz, rounded to the nearest.
+uint32_t Timer::getFrequency(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	if (instance.prescaler == 0) { return 0; }
+	
+	uint64_t period = getPeriod(device);
+	
+	return (uint32_t) ((clock(device) + period / 2) / period);
+}
+
+
+// --- SET TRIGGER ---
+// Select the trigger output (TRGO) source.
+bool Timer::setTrigger(TimerDevice device, Timer_trigger trigger) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return false; }
+	
+	instance.regs->CR2 = (instance.regs->CR2 & ~TIM_CR2_MMS) | 
+									((uint32_t) trigger << TIM_CR2_MMS_Pos);
+	
+	return true;
+}
+
+
+// --- START ---
+// Start the counter.
+bool Timer::start(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return false; }
+	
+	instance.regs->CR1 |= TIM_CR1_CEN;
+	
+	return true;
+}
+
+
+// --- STOP ---
+// Stop the counter.
+bool Timer::stop(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return false; }
+	
+	instance.regs->CR1 &= ~TIM_CR1_CEN;
+	
+	return true;
+}
+
+
+// --- TICK RATE ---
+// Returns the counter clock in Hz.
+uint32_t Timer::tickRate(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	if (instance.prescaler == 0) { return 0; }
+	
+	return clock(device) / instance.prescaler;
+}
+
+
+// --- GET COUNT ---
+// Returns the counter value, e.g. the position in encoder mode.
+uint32_t Timer::getCount(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return 0; }
+	
+	return instance.regs->CNT;
+}
+
+
+// --- CHANNEL REGISTERS ---
+// CCMR1 holds the mode of channels 1 & 2, CCMR2 of channels 3 & 4, 8 bits per channel.
+static volatile uint32_t* timerCcmr(Timer_device &instance, Timer_channel ch) {
+	return (ch < TIMER_CH_3) ? &(instance.regs->CCMR1) : &(instance.regs->CCMR2);
+}
+
+static uint32_t timerCcmrShift(Timer_channel ch) {
+	return (ch & 1) * 8;
+}
+
+static volatile uint32_t* timerCcr(Timer_device &instance, Timer_channel ch) {
+	return &(instance.regs->CCR1) + ch;
+}
+
+// CCER has 4 bits per channel: enable, polarity, complementary enable & polarity.
+static uint32_t timerCcerShift(Timer_channel ch) {
+	return ch * 4;
+}
+
+
+// --- PINS ---
+// Put a channel pin into alternate function mode. F1 has no AF selection per pin, the 'af' value
+// of the pin is the AFIO remap value of the timer instead.
+static bool timerPinOutput(Timer_device &instance, GpioPinDef pin) {
+#ifdef STM32F1
+	if (!GPIO::set_output(pin.port, pin.pin, GPIO_FLOATING, GPIO_PUSH_PULL, GPIO_HIGH)) {
+		return false;
+	}
+	
+	return GPIO::set_af(pin.port, pin.pin, instance.per, pin.af, GPIO_PUSH_PULL);
+#else
+	return GPIO::set_af(pin);
+#endif
+}
+
+static bool timerPinInput(Timer_device &instance, GpioPinDef pin, GPIO_pupd pupd) {
+#ifdef STM32F1
+	if (!GPIO::set_af(pin.port, pin.pin, instance.per, pin.af, GPIO_PUSH_PULL)) { return false; }
+	
+	return GPIO::set_input(pin.port, pin.pin, pupd);
+#else
+	if (!GPIO::set_af(pin)) { return false; }
+	
+	return GPIO::set_output_parameters(pin.port, pin.pin, pupd, GPIO_PUSH_PULL, GPIO_LOW);
+#endif
+}
+
+
+// --- ENABLE OUTPUT ---
+// Enable the output of a compare channel. Advanced-control timers also need the main output
+// enable bit.
+static void timerEnableOutput(Timer_device &instance, Timer_channel ch) {
+	uint32_t shift = timerCcerShift(ch);
+	instance.regs->CCER = (instance.regs->CCER & ~(0xFUL << shift)) | (TIM_CCER_CC1E << shift);
+	if (instance.advanced) {
+		instance.regs->BDTR |= TIM_BDTR_MOE;
+	}
+}
+
+
+// --- START PWM ---
+// Start PWM output on a channel at 'frequency' Hz, with 'duty' in 0.01% (0 - 10000). The
+// frequency applies to all channels of the timer. The pin is taken from the board definition.
+bool Timer::startPWM(TimerDevice device, Timer_channel ch, GpioPinDef pin, uint32_t frequency,
+																			uint16_t duty) {
+	Timer_device &instance = timerList[device];
+	if (ch >= instance.channels) { return false; }
+	if (duty > 10000) { return false; }
+	
+	if (!setFrequency(device, frequency)) { return false; }
+	if (!timerPinOutput(instance, pin)) { return false; }
+	
+	// Continuous counting, without the slave mode of the encoder.
+	instance.regs->CR1 &= ~TIM_CR1_OPM;
+	instance.regs->SMCR &= ~TIM_SMCR_SMS;
+	
+	// PWM mode 1 (active while CNT < CCR), with the compare value preloaded at the update event.
+	uint32_t shift = timerCcmrShift(ch);
+	volatile uint32_t* ccmr = timerCcmr(instance, ch);
+	*ccmr = (*ccmr & ~(0xFFUL << shift)) | 
+				((TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1PE) << shift);
+	setDuty(device, ch, duty);
+	
+	// Load the compare value before starting.
+	instance.regs->EGR = TIM_EGR_UG;
+	instance.regs->SR = 0;
+	timerEnableOutput(instance, ch);
+	
+	return start(device);
+}
+
+
+// --- SET DUTY ---
+// Set the duty cycle of a PWM channel in 0.01% (0 - 10000), applied at the next period.
+bool Timer::setDuty(TimerDevice device, Timer_channel ch, uint16_t duty) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return false; }
+	if (ch >= instance.channels) { return false; }
+	if (duty > 10000) { return false; }
+	
+	*timerCcr(instance, ch) = (uint32_t) (((uint64_t) instance.reload + 1) * duty / 10000);
+	
+	return true;
+}
+
+
+// --- STOP PWM ---
+// Disable the output of a PWM or one-pulse channel. The counter keeps running for the other
+// channels.
+bool Timer::stopPWM(TimerDevice device, Timer_channel ch) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return false; }
+	if (ch >= instance.channels) { return false; }
+	
+	instance.regs->CCER &= ~(TIM_CCER_CC1E << timerCcerShift(ch));
+	
+	return true;
+}
+
+
+#ifdef NODATE_DMA_ENABLED
+
+// --- CAPTURE DMA MAPPINGS ---
+// Per family, the DMA channels (F0/F1) or streams & channel selections (F4/F7) which serve the
+// capture/compare DMA requests of each timer channel. Only default mappings are listed for F0.
+struct Timer_dma_mapping {
+	TimerDevice timer;
+	Timer_channel ch;
+	DMA_devices device;
+	uint8_t channel;
+	uint8_t request;
+};
+
+static const Timer_dma_mapping timerDmaMappings[] = {
+#if defined __stm32f0
+	{ TIMER_1, TIMER_CH_1, DMA_1, 2, 0 },
+	{ TIMER_1, TIMER_CH_2, DMA_1, 3, 0 },
+	{ TIMER_1, TIMER_CH_3, DMA_1, 5, 0 },
+	{ TIMER_1, TIMER_CH_4, DMA_1, 4, 0 },
+	{ TIMER_2, TIMER_CH_1, DMA_1, 5, 0 },
+	{ TIMER_2, TIMER_CH_2, DMA_1, 3, 0 },
+	{ TIMER_2, TIMER_CH_4, DMA_1, 4, 0 },
+	{ TIMER_3, TIMER_CH_1, DMA_1, 4, 0 },
+	{ TIMER_3, TIMER_CH_3, DMA_1, 2, 0 },
+	{ TIMER_3, TIMER_CH_4, DMA_1, 3, 0 },
+#elif defined __stm32f1
+	{ TIMER_1, TIMER_CH_1, DMA_1, 2, 0 },
+	{ TIMER_1, TIMER_CH_2, DMA_1, 3, 0 },
+	{ TIMER_1, TIMER_CH_3, DMA_1, 6, 0 },
+	{ TIMER_1, TIMER_CH_4, DMA_1, 4, 0 },
+	{ TIMER_2, TIMER_CH_1, DMA_1, 5, 0 },
+	{ TIMER_2, TIMER_CH_2, DMA_1, 7, 0 },
+	{ TIMER_2, TIMER_CH_3, DMA_1, 1, 0 },
+	{ TIMER_2, TIMER_CH_4, DMA_1, 7, 0 },
+	{ TIMER_3, TIMER_CH_1, DMA_1, 6, 0 },
+	{ TIMER_3, TIMER_CH_3, DMA_1, 2, 0 },
+	{ TIMER_3, TIMER_CH_4, DMA_1, 3, 0 },
+	{ TIMER_4, TIMER_CH_1, DMA_1, 1, 0 },
+	{ TIMER_4, TIMER_CH_2, DMA_1, 4, 0 },
+	{ TIMER_4, TIMER_CH_3, DMA_1, 5, 0 },
+	{ TIMER_5, TIMER_CH_1, DMA_2, 5, 0 },
+	{ TIMER_5, TIMER_CH_2, DMA_2, 4, 0 },
+	{ TIMER_5, TIMER_CH_3, DMA_2, 2, 0 },
+	{ TIMER_5, TIMER_CH_4, DMA_2, 1, 0 },
+	{ TIMER_8, TIMER_CH_1, DMA_2, 3, 0 },
+	{ TIMER_8, TIMER_CH_2, DMA_2, 5, 0 },
+	{ TIMER_8, TIMER_CH_3, DMA_2, 1, 0 },
+	{ TIMER_8, TIMER_CH_4, DMA_2, 2, 0 },
+#elif defined __stm32f4 || defined __stm32f7
+	{ TIMER_2, TIMER_CH_1, DMA_1, 5, 3 },
+	{ TIMER_2, TIMER_CH_2, DMA_1, 6, 3 },
+	{ TIMER_2, TIMER_CH_3, DMA_1, 1, 3 },
+	{ TIMER_2, TIMER_CH_4, DMA_1, 7, 3 },
+	{ TIMER_2, TIMER_CH_4, DMA_1, 6, 3 },
+	{ TIMER_3, TIMER_CH_1, DMA_1, 4, 5 },
+	{ TIMER_3, TIMER_CH_2, DMA_1, 5, 5 },
+	{ TIMER_3, TIMER_CH_3, DMA_1, 7, 5 },
+	{ TIMER_3, TIMER_CH_4, DMA_1, 2, 5 },
+	{ TIMER_4, TIMER_CH_1, DMA_1, 0, 2 },
+	{ TIMER_4, TIMER_CH_2, DMA_1, 3, 2 },
+	{ TIMER_4, TIMER_CH_3, DMA_1, 7, 2 },
+	{ TIMER_5, TIMER_CH_1, DMA_1, 2, 6 },
+	{ TIMER_5, TIMER_CH_2, DMA_1, 4, 6 },
+	{ TIMER_5, TIMER_CH_3, DMA_1, 0, 6 },
+	{ TIMER_5, TIMER_CH_4, DMA_1, 1, 6 },
+	{ TIMER_5, TIMER_CH_4, DMA_1, 3, 6 },
+	{ TIMER_1, TIMER_CH_1, DMA_2, 1, 6 },
+	{ TIMER_1, TIMER_CH_1, DMA_2, 3, 6 },
+	{ TIMER_1, TIMER_CH_2, DMA_2, 2, 6 },
+	{ TIMER_1, TIMER_CH_3, DMA_2, 6, 6 },
+	{ TIMER_1, TIMER_CH_4, DMA_2, 4, 6 },
+	{ TIMER_8, TIMER_CH_1, DMA_2, 2, 7 },
+	{ TIMER_8, TIMER_CH_2, DMA_2, 3, 7 },
+	{ TIMER_8, TIMER_CH_3, DMA_2, 4, 7 },
+	{ TIMER_8, TIMER_CH_4, DMA_2, 7, 7 },
+#endif
+	{ TIMER_1, TIMER_CH_1, DMA_1, 0xFF, 0 }	// End of table.
+};
+
+
+// --- START CAPTURE ---
+// Capture the counter on each 'edge' of a channel pin into the circular 'buffer' of 'count'
+// values, using DMA. The counter runs freely at 'rate' Hz (0 for the timer clock), so that
+// captureTicks() on consecutive values gives the signal period. The DMA callbacks are called
+// for each half of the buffer. The pin is taken from the board definition. The time base is
+// shared by all channels, so this fails if another channel of the running timer is enabled, e.g.
+// for PWM, and 'rate' needs a different time base.
+bool Timer::startCapture(TimerDevice device, Timer_channel ch, GpioPinDef pin, Timer_edge edge,
+								uint32_t rate, uint32_t* buffer, uint16_t count, DMA_callbacks cb) {
+	Timer_device &instance = timerList[device];
+	if (ch >= instance.channels) { return false; }
+	if (instance.dma[ch].valid) { return false; }
+#ifdef __stm32f1
+	if (edge == TIMER_EDGE_BOTH) { return false; }
+#endif
+	
+	uint32_t clk = clock(device);
+	uint32_t prescaler = (rate == 0 || rate >= clk) ? 1 : (clk + rate / 2) / rate;
+	if (prescaler > 0x10000) { return false; }
+	
+	// Don't change the time base under the other channels in use.
+	uint32_t reload = instance.wide ? 0xFFFFFFFF : 0xFFFF;
+	if (instance.active && (instance.regs->CR1 & TIM_CR1_CEN) && 
+			(prescaler != instance.prescaler || reload != instance.reload)) {
+		uint32_t others = 0;
+		for (uint8_t i = 0; i < instance.channels; ++i) {
+			if (i != ch) { others |= (TIM_CCER_CC1E | TIM_CCER_CC1NE) << (i * 4); }
+		}
+		
+		if (instance.regs->CCER & others) { return false; }
+	}
+	
+	const Timer_dma_mapping* m = timerDmaMappings;
+	for (; m->channel != 0xFF; ++m) {
+		if (m->timer != device || m->ch != ch) { continue; }
+		if (DMA::claim(m->device, m->channel)) { break; }
+	}
+	
+	if (m->channel == 0xFF) { return false; } // No DMA channel available.
+	
+	DMA_assignment &dma = instance.dma[ch];
+	dma.device = m->device;
+	dma.channel = m->channel;
+	dma.request = m->request;
+	dma.valid = true;
+	
+	// Free-running counter over its full range.
+	if (!timerLoad(instance, prescaler, reload) ||
+			!timerPinInput(instance, pin, GPIO_FLOATING)) {
+		DMA::release(dma);
+		return false;
+	}
+	
+	instance.regs->CR1 &= ~TIM_CR1_OPM;
+	instance.regs->SMCR &= ~TIM_SMCR_SMS;
+	
+	// Capture on TIx, without filter or prescaler.
+	uint32_t shift = timerCcmrShift(ch);
+	volatile uint32_t* ccmr = timerCcmr(instance, ch);
+	*ccmr = (*ccmr & ~(0xFFUL << shift)) | (TIM_CCMR1_CC1S_0 << shift);
+	
+	uint32_t ccer = TIM_CCER_CC1E;
+	if (edge == TIMER_EDGE_FALLING) 	{ ccer |= TIM_CCER_CC1P; }
+	else if (edge == TIMER_EDGE_BOTH) 	{ ccer |= TIM_CCER_CC1P | TIM_CCER_CC1NP; }
+	
+	DMA_config cfg;
+	cfg.channel = dma.channel;
+	cfg.request = dma.request;
+	cfg.source = (uint32_t*) timerCcr(instance, ch);
+	cfg.target = buffer;
+	cfg.prio = DMA_PRIO_HIGH;
+	cfg.count = count;
+	cfg.src_size = 4;
+	cfg.des_size = 4;
+	cfg.circular = true;
+	cfg.src_incr = false;
+	cfg.des_incr = true;
+	if (!DMA::configureChannel(dma.device, cfg, cb)) {
+		DMA::release(dma);
+		return false;
+	}
+	
+	shift = timerCcerShift(ch);
+	instance.regs->CCER = (instance.regs->CCER & ~(0xFUL << shift)) | (ccer << shift);
+	instance.regs->DIER |= (TIM_DIER_CC1DE << ch);
+	
+	return start(device);
+}
+
+
+// --- STOP CAPTURE ---
+// Stop capturing on a channel and release its DMA channel. The counter keeps running for the
+// other channels.
+bool Timer::stopCapture(TimerDevice device, Timer_channel ch) {
+	Timer_device &instance = timerList[device];
+	if (ch >= instance.channels) { return false; }
+	if (!instance.dma[ch].valid) { return false; }
+	
+	instance.regs->DIER &= ~(TIM_DIER_CC1DE << ch);
+	instance.regs->CCER &= ~(TIM_CCER_CC1E << timerCcerShift(ch));
+	
+	DMA::abort(instance.dma[ch].device, instance.dma[ch].channel);
+	DMA::release(instance.dma[ch]);
+	
+	return true;
+}
+
+#endif
+
+
+// --- CAPTURE TICKS ---
+// Returns the counter ticks from capture 'from' to capture 'to', across a counter wrap. Divide
+// by tickRate() for the time in seconds.
+uint32_t Timer::captureTicks(TimerDevice device, uint32_t from, uint32_t to) {
+	Timer_device &instance = timerList[device];
+	
+	return (to - from) & instance.reload;
+}
+
+
+// --- SET ONE PULSE ---
+// Configure a channel for a single pulse of 'width' µs, 'delay' µs after firePulse(). The delay
+// is at least one counter tick, so that the output is idle between pulses. The pin is taken from
+// the board definition.
+bool Timer::setOnePulse(TimerDevice device, Timer_channel ch, GpioPinDef pin, uint32_t delay,
+																			uint32_t width) {
+	Timer_device &instance = timerList[device];
+	if (ch >= instance.channels) { return false; }
+	if (width == 0) { return false; }
+	
+	// Timer clock cycles until the start & end of the pulse.
+	uint64_t clk = clock(device);
+	uint64_t start = (clk * delay + 500000) / 1000000;
+	uint64_t end = (clk * ((uint64_t) delay + width) + 500000) / 1000000;
+	uint64_t counter = instance.wide ? 0x100000000ULL : 0x10000ULL;
+	uint64_t prescaler = (end + counter - 1) / counter;
+	if (prescaler == 0) 		{ prescaler = 1; }
+	if (prescaler > 0x10000) 	{ return false; }
+	
+	uint64_t ccr = (start + prescaler / 2) / prescaler;
+	uint64_t reload = (end + prescaler / 2) / prescaler;
+	if (ccr == 0) 			{ ccr = 1; }
+	if (reload > counter) 	{ reload = counter; }
+	if (reload <= ccr) 		{ return false; } // Pulse shorter than one tick.
+	
+	if (!timerLoad(instance, (uint32_t) prescaler, (uint32_t) (reload - 1))) { return false; }
+	instance.regs->CR1 &= ~TIM_CR1_CEN;
+	if (!timerPinOutput(instance, pin)) { return false; }
+	
+	// The counter stops at the update event after the pulse.
+	instance.regs->CR1 |= TIM_CR1_OPM;
+	
+	// PWM mode 2: inactive while CNT < CCR, active until the end of the period.
+	uint32_t shift = timerCcmrShift(ch);
+	volatile uint32_t* ccmr = timerCcmr(instance, ch);
+	*ccmr = (*ccmr & ~(0xFFUL << shift)) | 
+				((TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_0 | TIM_CCMR1_OC1PE) << shift);
+	*timerCcr(instance, ch) = (uint32_t) ccr;
+	instance.regs->EGR = TIM_EGR_UG;
+	instance.regs->SR = 0;
+	timerEnableOutput(instance, ch);
+	
+	return true;
+}
+
+
+// --- FIRE PULSE ---
+// Start the pulse configured with setOnePulse(). Ignored while a pulse is in progress.
+bool Timer::firePulse(TimerDevice device) {
+	Timer_device &instance = timerList[device];
+	if (!instance.active) { return false; }
+	if ((instance.regs->CR1 & TIM_CR1_OPM) == 0) { return false; }
+	
+	instance.regs->CR1 |= TIM_CR1_CEN;
+	
+	return true;
+}
+
+
+// --- START ENCODER ---
+// Count the edges of a quadrature encoder on channel 1 ('a') & 2 ('b'), four counts per cycle.
+// The direction follows the phase between both. 'filter' is the input filter (0 - 15) against
+// contact bounce. The position is read with getCount(). The pins are taken from the board
+// definition.
+bool Timer::startEncoder(TimerDevice device, GpioPinDef a, GpioPinDef b, uint8_t filter) {
+	Timer_device &instance = timerList[device];
+	if (instance.channels < 2) { return false; }
+	if (filter > 15) { return false; }
+	
+	if (!timerLoad(instance, 1, instance.wide ? 0xFFFFFFFF : 0xFFFF)) { return false; }
+	instance.regs->CR1 &= ~TIM_CR1_CEN;
+	if (!timerPinInput(instance, a, GPIO_PULL_UP)) { return false; }
+	if (!timerPinInput(instance, b, GPIO_PULL_UP)) { return false; }
+	
+	// TI1 & TI2 as inputs, not inverted, counting on both edges of both (encoder mode 3).
+	instance.regs->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0 |
+							((uint32_t) filter << TIM_CCMR1_IC1F_Pos) | 
+							((uint32_t) filter << TIM_CCMR1_IC2F_Pos);
+	instance.regs->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC1NP | TIM_CCER_CC2P | TIM_CCER_CC2NP);
+	instance.regs->SMCR = (instance.regs->SMCR & ~TIM_SMCR_SMS) | 
+									(TIM_SMCR_SMS_1 | TIM_SMCR_SMS_0);
+	instance.regs->CNT = 0;
+	
+	return start(device);
 }
 
 #endif
@@ -0,0 +1,366 @@
+/*
+	timer_wheel.cpp - Implementation of the software timer wheel.
+
+*/
+
+
+#include <timer_wheel.h>
+#include <core.h>
+
+
+#ifdef NODATE_WHEEL_ENABLED
+
+static_assert(NODATE_WHEEL_TIMERS > 0 && NODATE_WHEEL_TIMERS < 0xFFFF,
+												"NODATE_WHEEL_TIMERS must be 1 - 65534.");
+
+
+// --- WHEEL ---
+// Four levels of 64 slots. A timer is put into the lowest level which covers its remaining ticks,
+// in the slot for its expiry tick, and moved down ('cascaded') when the tick count reaches that
+// slot on its level. Each slot is a doubly linked list of pool indices, so that a timer is removed
+// in constant time. Timers further out than the wheel covers are cascaded on the top level until
+// they fit.
+const uint32_t wheelLevels = 4;
+const uint32_t wheelBits = 6;
+const uint32_t wheelSlots = 1UL << wheelBits;
+const uint32_t wheelMask = wheelSlots - 1;
+const uint32_t wheelRange = 1UL << (wheelLevels * wheelBits);	// Ticks covered by the wheel.
+const uint16_t wheelNone = 0xFFFF;
+const uint16_t wheelExpired = wheelLevels * wheelSlots;		// List of the timers being run.
+
+
+struct TimerWheel_node {
+	TimerWheel_cb cb = 0;
+	void* arg = 0;
+	uint32_t expires = 0;
+	uint32_t period = 0;		// Ticks, 0 for a one-shot timer.
+	uint16_t next = wheelNone;
+	uint16_t prev = wheelNone;
+	uint16_t list = wheelNone;	// Slot list the timer is in, none if free.
+	uint16_t seq = 0;			// Increased on each start, so that old handles don't match.
+};
+
+
+static TimerWheel_node wheelNodes[NODATE_WHEEL_TIMERS];
+static uint16_t wheelHeads[wheelLevels * wheelSlots + 1];
+static uint64_t wheelUsed[wheelLevels];		// Non-empty slots per level.
+static uint16_t wheelFree = wheelNone;
+static uint32_t wheelNext = 0;				// Next tick to process.
+static bool wheelActive = false;
+
+
+static void wheelLink(uint16_t index, uint16_t list) {
+	TimerWheel_node &node = wheelNodes[index];
+	node.list = list;
+	node.prev = wheelNone;
+	node.next = wheelHeads[list];
+	if (node.next != wheelNone) { wheelNodes[node.next].prev = index; }
+	wheelHeads[list] = index;
+	if (list != wheelExpired) { wheelUsed[list >> wheelBits] |= (1ULL << (list & wheelMask)); }
+}
+
+
+static void wheelUnlink(uint16_t index) {
+	TimerWheel_node &node = wheelNodes[index];
+	if (node.prev != wheelNone) { wheelNodes[node.prev].next = node.next; }
+	else {
+		wheelHeads[node.list] = node.next;
+		if (node.next == wheelNone && node.list != wheelExpired) {
+			wheelUsed[node.list >> wheelBits] &= ~(1ULL << (node.list & wheelMask));
+		}
+	}
+	
+	if (node.next != wheelNone) { wheelNodes[node.next].prev = node.prev; }
+	node.list = wheelNone;
+}
+
+
+static void wheelRelease(uint16_t index) {
+	wheelNodes[index].next = wheelFree;
+	wheelFree = index;
+}
+
+
+// Put a timer into the slot for its expiry tick, relative to the next tick to process.
+static void wheelInsert(uint16_t index) {
+	uint32_t expires = wheelNodes[index].expires;
+	int32_t delta = (int32_t) (expires - wheelNext);
+	if (delta < 0) {
+		expires = wheelNext;
+		delta = 0;
+	}
+	else if ((uint32_t) delta >= wheelRange) {
+		expires = wheelNext + wheelRange - 1;
+		delta = wheelRange - 1;
+	}
+	
+	uint32_t level = 0;
+	while ((uint32_t) delta >= (1UL << ((level + 1) * wheelBits))) { level++; }
+	
+	wheelLink(index, (level << wheelBits) | ((expires >> (level * wheelBits)) & wheelMask));
+}
+
+
+// Move the timers in a slot down to the lower levels.
+static void wheelCascade(uint32_t level, uint32_t slot) {
+	uint16_t list = (level << wheelBits) | slot;
+	uint16_t index = wheelHeads[list];
+	wheelHeads[list] = wheelNone;
+	wheelUsed[level] &= ~(1ULL << slot);
+	
+	while (index != wheelNone) {
+		uint16_t next = wheelNodes[index].next;
+		wheelInsert(index);
+		index = next;
+	}
+}
+
+
+// Process tick 'wheelNext': cascade the higher levels at their slot boundaries, then move the
+// timers which are due to the expired list.
+static void wheelTick() {
+	uint32_t tick = wheelNext;
+	for (uint32_t level = wheelLevels - 1; level > 0; level--) {
+		if ((tick & ((1UL << (level * wheelBits)) - 1)) == 0) {
+			wheelCascade(level, (tick >> (level * wheelBits)) & wheelMask);
+		}
+	}
+	
+	uint16_t list = tick & wheelMask;
+	uint16_t index = wheelHeads[list];
+	wheelHeads[list] = wheelNone;
+	wheelUsed[0] &= ~(1ULL << list);
+	wheelHeads[wheelExpired] = index;
+	for (; index != wheelNone; index = wheelNodes[index].next) {
+		wheelNodes[index].list = wheelExpired;
+	}
+	
+	wheelNext = tick + 1;
+}
+
+
+// Find the ticks from 'wheelNext' until the next tick which has to be processed: one with timers
+// due, or the cascade of a non-empty slot. Returns false if no timer is active.
+static bool wheelNextEvent(uint32_t &ticks) {
+	bool found = false;
+	for (uint32_t level = 0; level < wheelLevels; level++) {
+		uint64_t used = wheelUsed[level];
+		if (used == 0) { continue; }
+	
+		// First slot boundary of this level at or after the next tick, then the first non-empty
+		// slot from there.
+		uint32_t shift = level * wheelBits;
+		uint32_t base = wheelNext >> shift;
+		if ((wheelNext & ((1UL << shift) - 1)) != 0) { base++; }
+	
+		uint32_t first = base & wheelMask;
+		if (first != 0) { used = (used >> first) | (used << (wheelSlots - first)); }
+	
+		uint32_t at = ((base + __builtin_ctzll(used)) << shift) - wheelNext;
+		if (!found || at < ticks) {
+			ticks = at;
+			found = true;
+		}
+	}
+	
+	return found;
+}
+
+
+static TimerWheel_node* wheelFind(uint32_t handle) {
+	uint16_t index = handle & 0xFFFF;
+	if (!wheelActive || index >= NODATE_WHEEL_TIMERS) { return 0; }
+	
+	TimerWheel_node &node = wheelNodes[index];
+	if (node.list == wheelNone || node.seq != (handle >> 16)) { return 0; }
+	
+	return &node;
+}
+
+
+// --- INIT ---
+// Set up the timer pool and start SysTick. In WHEEL_RUN_SYSTICK mode the SysTick interrupt runs
+// the callbacks, otherwise run() has to be called regularly, e.g. from the main loop.
+bool TimerWheel::init(TimerWheel_mode mode) {
+	if (!McuCore::initSysTick()) { return false; }
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if (!wheelActive) {
+		for (uint32_t i = 0; i < (wheelLevels * wheelSlots) + 1; i++) { wheelHeads[i] = wheelNone; }
+		for (uint32_t i = 0; i < wheelLevels; i++) { wheelUsed[i] = 0; }
+	
+		wheelFree = wheelNone;
+		for (uint16_t i = NODATE_WHEEL_TIMERS; i > 0; i--) {
+			wheelNodes[i - 1].list = wheelNone;
+			wheelRelease(i - 1);
+		}
+	
+		wheelNext = McuCore::getSysTick();
+		wheelActive = true;
+	}
+	
+	McuCore::setTickCallback((mode == WHEEL_RUN_SYSTICK) ? &TimerWheel::run : 0);
+	
+	__set_PRIMASK(primask);
+	
+	return true;
+}
+
+
+// --- START ---
+// Start a timer which calls 'cb' with 'arg' after 'ms' ticks (ms), and every 'ms' ticks after
+// that if periodic. The handle can be used to cancel the timer, until it has expired.
+bool TimerWheel::start(uint32_t ms, TimerWheel_cb cb, bool periodic, uint32_t &handle,
+																			void* arg) {
+	if (!wheelActive || cb == 0 || ms > 0x7FFFFFFF) { return false; }
+	if (periodic && ms == 0) { return false; }
+	
+	uint32_t now = McuCore::getSysTick();
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	uint16_t index = wheelFree;
+	if (index == wheelNone) {
+		__set_PRIMASK(primask);
+		return false; // Pool exhausted.
+	}
+	
+	TimerWheel_node &node = wheelNodes[index];
+	wheelFree = node.next;
+	node.cb = cb;
+	node.arg = arg;
+	node.expires = now + ms;
+	node.period = periodic ? ms : 0;
+	if (++node.seq == 0) { node.seq = 1; }
+	wheelInsert(index);
+	handle = ((uint32_t) node.seq << 16) | index;
+	
+	McuCore::requestTick(node.expires);
+	
+	__set_PRIMASK(primask);
+	
+	return true;
+}
+
+
+// --- CANCEL ---
+bool TimerWheel::cancel(uint32_t handle) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	TimerWheel_node* node = wheelFind(handle);
+	if (node == 0) {
+		__set_PRIMASK(primask);
+		return false;
+	}
+	
+	uint16_t index = handle & 0xFFFF;
+	wheelUnlink(index);
+	wheelRelease(index);
+	
+	__set_PRIMASK(primask);
+	
+	return true;
+}
+
+
+// --- ACTIVE ---
+// Returns whether the timer is still running.
+bool TimerWheel::active(uint32_t handle) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	bool found = wheelFind(handle) != 0;
+	
+	__set_PRIMASK(primask);
+	
+	return found;
+}
+
+
+// --- REMAINING ---
+// Returns the ticks until the timer expires next, or 0 if it's due or not running.
+uint32_t TimerWheel::remaining(uint32_t handle) {
+	uint32_t now = McuCore::getSysTick();
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	int32_t left = 0;
+	TimerWheel_node* node = wheelFind(handle);
+	if (node != 0) { left = (int32_t) (node->expires - now); }
+	
+	__set_PRIMASK(primask);
+	
+	return (left > 0) ? (uint32_t) left : 0;
+}
+
+
+// --- RUN ---
+// Run the callbacks of all timers which are due. Ticks without any timer due or to cascade are
+// skipped, so that the work doesn't depend on the time since the last call. In tickless mode the
+// tick of the next event is requested from SysTick.
+void TimerWheel::run() {
+	if (!wheelActive) { return; }
+	
+	uint32_t now = McuCore::getSysTick();
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	uint32_t ticks;
+	while (wheelNextEvent(ticks) && (int32_t) (now - (wheelNext + ticks)) >= 0) {
+		wheelNext += ticks;
+		wheelTick();
+	
+		// Periodic timers are started again before their callback, so that it can cancel them.
+		// Interrupts are enabled while a callback runs.
+		while (wheelHeads[wheelExpired] != wheelNone) {
+			uint16_t index = wheelHeads[wheelExpired];
+			TimerWheel_node &node = wheelNodes[index];
+			TimerWheel_cb cb = node.cb;
+			void* arg = node.arg;
+			wheelUnlink(index);
+			if (node.period != 0) {
+				node.expires += node.period;
+				wheelInsert(index);
+			}
+			else {
+				wheelRelease(index);
+			}
+	
+			__set_PRIMASK(primask);
+			cb(arg);
+			__disable_irq();
+		}
+	}
+	
+	if ((int32_t) (now - wheelNext) >= 0) { wheelNext = now + 1; }
+	if (wheelNextEvent(ticks)) { McuCore::requestTick(wheelNext + ticks); }
+	
+	__set_PRIMASK(primask);
+}
+
+
+// --- IDLE ---
+// Sleep until the next interrupt, unless a timer became due since the last run(). For a
+// deferred-work loop calling run() and idle() in turn.
+void TimerWheel::idle() {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	// McuCore::idle() is entered with interrupts disabled, so the wake-up is handled after the
+	// PRIMASK of the caller is restored.
+	uint32_t ticks;
+	if (!wheelActive || !wheelNextEvent(ticks) ||
+					(int32_t) (McuCore::getSysTick() - (wheelNext + ticks)) < 0) {
+		McuCore::idle();
+	}
+	
+	__set_PRIMASK(primask);
+}
+
+#endif
@@ -1,5 +1,5 @@
 /*
-	usart.h - Implementation of the USART functionality.
+	usart.cpp - Implementation of the USART functionality.
 	
 */
 
@@ -99,178 +99,226 @@ extern "C" {
 	void USART1_IRQHandler(void);
 	void USART2_IRQHandler(void);
 	void USART3_IRQHandler(void);
-	void USART4_IRQHandler(void);
-	void USART5_IRQHandler(void);
+	void UART4_IRQHandler(void);
+	void UART5_IRQHandler(void);
 	void USART6_IRQHandler(void);
-	void USART7_IRQHandler(void);
-	void USART8_IRQHandler(void);
+	void UART7_IRQHandler(void);
+	void UART8_IRQHandler(void);
 }
 #endif
 
 volatile char rxb = 'a';
 
-#if defined __stm32f0
 
-void USART1_IRQHandler(void) {
-	USART_device &instance = devicesStatic[0];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+// --- RX BUFFER ---
+// Called from the interrupt handler. Only the head is updated here, the tail is owned by read().
+static inline uint16_t usartRxAvailable(USART_device &instance) {
+	uint16_t head = instance.rxHead;
+	uint16_t tail = instance.rxTail;
+	return (head >= tail) ? (head - tail) : (instance.rxSize - tail + head);
 }
 
-void USART2_IRQHandler(void) {
-	USART_device &instance = devicesStatic[1];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+
+static inline void usartRxNotify(USART_device &instance) {
+	uint16_t available = usartRxAvailable(instance);
+	if (available > 0 && instance.rxNotify != 0) { instance.rxNotify(available); }
 }
 
-void USART3_4_IRQHandler(void) {
-	USART_device &instance = devicesStatic[2];
-	USART_device &instance2 = devicesStatic[3];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
+
+static inline void usartRxStore(USART_device &instance, char ch) {
+	uint16_t head = instance.rxHead;
+	uint16_t next = (head + 1 == instance.rxSize) ? 0 : head + 1;
+	if (next == instance.rxTail) {
+		// Buffer is full, drop the byte.
+		instance.rxDropped++;
+		return;
 	}
-	else if (instance2.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance2.regs->RDR;
-		instance2.callback(rxb);
+	
+	instance.rxBuffer[head] = ch;
+	instance.rxHead = next;
+	
+	// Notify once when the watermark is reached, further notifications follow on IDLE.
+	if (instance.rxWatermark != 0 && usartRxAvailable(instance) == instance.rxWatermark) {
+		usartRxNotify(instance);
 	}
 }
 
-#elif defined __stm32f1 || defined __stm32f4
 
-void USART1_IRQHandler(void) {
-	USART_device &instance = devicesStatic[0];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
+#ifdef NODATE_DMA_ENABLED
+// --- RX DMA ---
+// Reports the data received by the circular DMA transfer since the last call, directly from the
+// DMA buffer. When the transfer wrapped around, the data is reported as two spans.
+static void usartRxDmaUpdate(USART_device &instance) {
+	if (instance.dmaRxCallback == 0) { return; }
+	
+	uint16_t size = instance.dmaRxSize;
+	uint16_t last = instance.dmaRxPos;
+	uint16_t pos = size - DMA::remaining(instance.dmaRx.device, instance.dmaRx.channel);
+	if (pos == last) { return; }
+	
+	if (pos > last) {
+		instance.dmaRxCallback(instance.dmaRxBuffer + last, pos - last);
 	}
-}
-
-void USART2_IRQHandler(void) {
-	USART_device &instance = devicesStatic[1];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
+	else {
+		instance.dmaRxCallback(instance.dmaRxBuffer + last, size - last);
+		if (pos > 0) {
+			instance.dmaRxCallback(instance.dmaRxBuffer, pos);
+		}
 	}
+	
+	instance.dmaRxPos = (pos == size) ? 0 : pos;
 }
 
-void USART3_IRQHandler(void) {
-	USART_device &instance = devicesStatic[2];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
-	}
+
+// DMA half & full transfer callback, with the USART as context.
+static void usartRxDma(void* ctx) {
+	usartRxDmaUpdate(*((USART_device*) ctx));
 }
 
-void USART4_IRQHandler(void) {
-	USART_device &instance = devicesStatic[3];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
+
+// --- TX DMA ---
+// Reports the completed descriptor and starts the next one in the queue, if any.
+static void usartTxDmaDone(void* ctx) {
+	USART_device &instance = *((USART_device*) ctx);
+	USART_tx_desc &done = instance.dmaTxQueue[instance.dmaTxTail];
+	if (instance.dmaTxCallback != 0) { instance.dmaTxCallback(done.data, done.len); }
+	
+	uint8_t tail = (instance.dmaTxTail + 1 == instance.dmaTxSize) ? 0 : instance.dmaTxTail + 1;
+	instance.dmaTxTail = tail;
+	if (tail == instance.dmaTxHead) {
+		instance.dmaTxBusy = false;
+		return;
 	}
+	
+	USART_tx_desc &next = instance.dmaTxQueue[tail];
+	DMA::transfer(instance.dmaTx.device, instance.dmaTx.channel, (uint32_t*) next.data, next.len);
 }
+#endif
 
-void USART5_IRQHandler(void) {
-	USART_device &instance = devicesStatic[4];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
+
+// Reports received data once the RX line goes idle.
+static inline void usartIdle(USART_device &instance) {
+#ifdef NODATE_DMA_ENABLED
+	if (instance.dmaRxBuffer != 0) {
+		usartRxDmaUpdate(instance);
+		return;
 	}
+#endif
+	
+	if (instance.rxBuffer != 0) { usartRxNotify(instance); }
 }
 
-void USART6_IRQHandler(void) {
-	USART_device &instance = devicesStatic[5];
-	if (instance.regs->SR & USART_SR_RXNE) {
+
+// --- IRQ HANDLER ---
+// Handles the receive and transmit interrupts for a single USART.
+static void usartIrq(USART_device &instance) {
+	if (!instance.active) { return; }
+	
+#if defined __stm32f1 || defined __stm32f4
+	// With DMA reception, RXNEIE is off and the received data belongs to the DMA.
+	uint32_t sr = instance.regs->SR;
+	if ((sr & USART_SR_RXNE) && (instance.regs->CR1 & USART_CR1_RXNEIE)) {
 		rxb = instance.regs->DR;
-		instance.callback(rxb);
+		if (instance.rxBuffer != 0) { usartRxStore(instance, rxb); }
+		else { instance.callback(rxb); }
+	}
+	else if ((sr & USART_SR_IDLE) && !(sr & USART_SR_RXNE)) {
+		// IDLE is cleared by reading SR followed by DR.
+		(void) instance.regs->DR;
+	}
+	
+	if (sr & USART_SR_IDLE) { usartIdle(instance); }
+	
+	// Drain the TX buffer while TXE is enabled, disable it again once the buffer is empty.
+	if ((instance.regs->CR1 & USART_CR1_TXEIE) && (sr & USART_SR_TXE)) {
+		if (instance.txTail != instance.txHead) {
+			instance.regs->DR = instance.txBuffer[instance.txTail];
+			instance.txTail = (instance.txTail + 1 == instance.txSize) ? 0 : instance.txTail + 1;
+		}
+		else {
+			instance.regs->CR1 &= ~USART_CR1_TXEIE;
+		}
+	}
+#else
+	// With DMA reception, RXNEIE is off and the received data belongs to the DMA.
+	uint32_t isr = instance.regs->ISR;
+	if ((isr & USART_ISR_RXNE) && (instance.regs->CR1 & USART_CR1_RXNEIE)) {
+		rxb = instance.regs->RDR;
+		if (instance.rxBuffer != 0) { usartRxStore(instance, rxb); }
+		else { instance.callback(rxb); }
+	}
+	
+	// An overrun keeps the interrupt asserted until cleared.
+	if (isr & USART_ISR_ORE) {
+		instance.regs->ICR = USART_ICR_ORECF;
+	}
+	
+	if (isr & USART_ISR_IDLE) {
+		instance.regs->ICR = USART_ICR_IDLECF;
+		usartIdle(instance);
+	}
+	
+	// Drain the TX buffer while TXE is enabled, disable it again once the buffer is empty.
+	if ((instance.regs->CR1 & USART_CR1_TXEIE) && (isr & USART_ISR_TXE)) {
+		if (instance.txTail != instance.txHead) {
+			instance.regs->TDR = instance.txBuffer[instance.txTail];
+			instance.txTail = (instance.txTail + 1 == instance.txSize) ? 0 : instance.txTail + 1;
+		}
+		else {
+			instance.regs->CR1 &= ~USART_CR1_TXEIE;
+		}
 	}
+#endif
 }
 
-void USART7_IRQHandler(void) {
-	USART_device &instance = devicesStatic[6];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
-	}
+
+#if defined __stm32f0
+
+void USART1_IRQHandler(void) {
+	usartIrq(devicesStatic[0]);
 }
 
-void USART8_IRQHandler(void) {
-	USART_device &instance = devicesStatic[7];
-	if (instance.regs->SR & USART_SR_RXNE) {
-		rxb = instance.regs->DR;
-		instance.callback(rxb);
-	}
+void USART2_IRQHandler(void) {
+	usartIrq(devicesStatic[1]);
 }
 
+void USART3_4_IRQHandler(void) {
+	usartIrq(devicesStatic[2]);
+	usartIrq(devicesStatic[3]);
+}
 
 #else
 
 void USART1_IRQHandler(void) {
-	USART_device &instance = devicesStatic[0];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+	usartIrq(devicesStatic[0]);
 }
 
 void USART2_IRQHandler(void) {
-	USART_device &instance = devicesStatic[1];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+	usartIrq(devicesStatic[1]);
 }
 
 void USART3_IRQHandler(void) {
-	USART_device &instance = devicesStatic[2];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+	usartIrq(devicesStatic[2]);
 }
 
-void USART4_IRQHandler(void) {
-	USART_device &instance = devicesStatic[3];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+void UART4_IRQHandler(void) {
+	usartIrq(devicesStatic[3]);
 }
 
-void USART5_IRQHandler(void) {
-	USART_device &instance = devicesStatic[4];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+void UART5_IRQHandler(void) {
+	usartIrq(devicesStatic[4]);
 }
 
 void USART6_IRQHandler(void) {
-	USART_device &instance = devicesStatic[5];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+	usartIrq(devicesStatic[5]);
 }
 
-void USART7_IRQHandler(void) {
-	USART_device &instance = devicesStatic[6];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+void UART7_IRQHandler(void) {
+	usartIrq(devicesStatic[6]);
 }
 
-void USART8_IRQHandler(void) {
-	USART_device &instance = devicesStatic[7];
-	if (instance.regs->ISR & USART_ISR_RXNE) {
-		rxb = instance.regs->RDR;
-		instance.callback(rxb);
-	}
+void UART8_IRQHandler(void) {
+	usartIrq(devicesStatic[7]);
 }
 
 #endif
@@ -294,6 +342,8 @@ bool USART::startUart(USART_devices device, GPIO_ports tx_port, uint8_t tx_pin,
 	else if (device == USART_4) { per = RCC_USART4; }
 	else if (device == USART_5) { per = RCC_USART5; }
 	else if (device == USART_6) { per = RCC_USART6; }
+	else if (device == USART_7) { per = RCC_USART7; }
+	else if (device == USART_8) { per = RCC_USART8; }
 	
 	if (instance.active) { return true; }
 	
@@ -394,14 +444,9 @@ bool USART::startUart(USART_devices device, GPIO_ports tx_port, uint8_t tx_pin,
 	instance.regs->BRR = (((usartClock) + ((baudrate) / 2U)) / (baudrate));
 #endif
 	
-	// Enable the USART via its CR1 register.
-#ifndef __stm32f3
+	// Enable the USART via its CR1 register, with both receiver and transmitter.
 #ifdef STM32F1
 	instance.regs->CR1 |= (USART_CR1_RE | USART_CR1_TE);
-#else
-	//instance.regs->CR1 |= (USART_CR1_RE | USART_CR1_TE | USART_CR1_UE | USART_CR1_RXNEIE);
-	instance.regs->CR1 |= USART_CR1_UE;
-#endif
 #else
 	instance.regs->CR1 |= (USART_CR1_RE | USART_CR1_TE | USART_CR1_UE);
 #endif
@@ -419,6 +464,10 @@ bool USART::startUart(USART_devices device, GPIO_ports tx_port, uint8_t tx_pin,
 	
 	// Configure interrupt.
 	instance.regs->CR1 |= USART_CR1_RXNEIE;
+	if (instance.rxBuffer != 0) {
+		instance.regs->CR1 |= USART_CR1_IDLEIE;
+	}
+	
 	NVIC_SetPriority(instance.irqType, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 1));
 	NVIC_EnableIRQ(instance.irqType);
 	
@@ -431,19 +480,18 @@ bool USART::startUart(USART_devices device, GPIO_ports tx_port, uint8_t tx_pin,
 bool USART::configureDMAT(USART_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb) {
 	USART_device &instance = devicesStatic[device];
 	if (!instance.active) { return false; }
-#if defined __stm32f0
-	// Disable transmission/reception.
-	instance.regs->CR1 &= ~(USART_CR1_RE | USART_CR1_TE | USART_CR1_UE | USART_CR1_RXNEIE);
+	if (!DMA::acquire(instance.per, DMA_DIR_TX, instance.dmaTx)) { return false; }
 	
-	// Enable DMA on USART. Enable for TX.
-	instance.regs->CR3 |= USART_CR3_DMAT;
-	
-	// Re-enable transmission/reception.
-	instance.regs->CR1 |= (USART_CR1_RE | USART_CR1_TE | USART_CR1_UE | USART_CR1_RXNEIE);
-
 	DMA_config cfg;
+	cfg.channel = instance.dmaTx.channel;
+	cfg.request = instance.dmaTx.request;
+	cfg.dir = DMA_MEM_TO_PER;
 	cfg.source = buffer;
+#if defined __stm32f1 || defined __stm32f4
+	cfg.target = (uint32_t*) &(instance.regs->DR);
+#else
 	cfg.target = (uint32_t*) &(instance.regs->TDR);
+#endif
 	cfg.prio = DMA_PRIO_MEDIUM;
 	cfg.count = count;
 	cfg.src_size = 1;
@@ -451,24 +499,12 @@ bool USART::configureDMAT(USART_devices device, uint32_t* buffer, uint16_t count
 	cfg.circular = false;
 	cfg.src_incr = true;
 	cfg.des_incr = false;
-	if (device == USART_1) {
-		cfg.channel = 2;
-		DMA::configureChannel(DMA_1, cfg, cb);
-	}
-	else if (device == USART_2) {
-		cfg.channel = 4;
-		DMA::configureChannel(DMA_1, cfg, cb);
-	}
-	else {
-		return false; // TODO: define other USARTs.
-	}
+	if (!DMA::configureChannel(instance.dmaTx.device, cfg, cb)) { return false; }
 	
-	DMA::start(DMA_1);
-	return true;
-#else
+	// Enable DMA on USART for TX. This does not require disabling the USART.
+	instance.regs->CR3 |= USART_CR3_DMAT;
 	
-	return false;
-#endif
+	return true;
 }
 
 
@@ -477,18 +513,17 @@ bool USART::configureDMAT(USART_devices device, uint32_t* buffer, uint16_t count
 bool USART::configureDMAR(USART_devices device, uint32_t* buffer, uint16_t count, DMA_callbacks cb) {
 	USART_device &instance = devicesStatic[device];
 	if (!instance.active) { return false; }
-#if defined __stm32f0
-	// Disable transmission/reception.
-	instance.regs->CR1 &= ~(USART_CR1_RE | USART_CR1_TE | USART_CR1_UE | USART_CR1_RXNEIE);
-	
-	// Enable DMA on USART. Enable for RX.
-	instance.regs->CR3 |= USART_CR3_DMAR;
-	
-	// Re-enable transmission/reception.
-	instance.regs->CR1 |= (USART_CR1_RE | USART_CR1_TE | USART_CR1_UE | USART_CR1_RXNEIE);
+	if (!DMA::acquire(instance.per, DMA_DIR_RX, instance.dmaRx)) { return false; }
 	
 	DMA_config cfg;
+	cfg.channel = instance.dmaRx.channel;
+	cfg.request = instance.dmaRx.request;
+	cfg.dir = DMA_PER_TO_MEM;
+#if defined __stm32f1 || defined __stm32f4
+	cfg.source = (uint32_t*) &(instance.regs->DR);
+#else
 	cfg.source = (uint32_t*) &(instance.regs->RDR);
+#endif
 	cfg.target = buffer;
 	cfg.prio = DMA_PRIO_MEDIUM;
 	cfg.count = count;
@@ -497,26 +532,376 @@ bool USART::configureDMAR(USART_devices device, uint32_t* buffer, uint16_t count
 	cfg.circular = false;
 	cfg.src_incr = false;
 	cfg.des_incr = true;
-	if (device == USART_1) {
-		cfg.channel = 3;
-		DMA::configureChannel(DMA_1, cfg, cb);
-	}
-	else if (device == USART_2) {
-		cfg.channel = 5;
-		DMA::configureChannel(DMA_1, cfg, cb);
+	if (!DMA::configureChannel(instance.dmaRx.device, cfg, cb)) { return false; }
+	
+	// Enable DMA on USART for RX. The RX interrupt would compete with the DMA for the data.
+	instance.regs->CR1 &= ~USART_CR1_RXNEIE;
+	instance.regs->CR3 |= USART_CR3_DMAR;
+	
+	return true;
+}
+
+
+// --- START RX DMA ---
+// Starts continuous reception into the circular buffer. New data is reported to the callback at
+// the half-way and end points of the buffer, and when the RX line goes idle. The reported data
+// must be processed before the DMA transfer wraps around to it again.
+bool USART::startRxDMA(USART_devices device, uint8_t* buffer, uint16_t size, USART_span_cb cb) {
+	USART_device &instance = devicesStatic[device];
+	if (!instance.active) { return false; }
+	if (buffer == 0 || size < 2 || cb == 0) { return false; }
+	if (!DMA::acquire(instance.per, DMA_DIR_RX, instance.dmaRx)) { return false; }
+	
+	instance.dmaRxBuffer 	= buffer;
+	instance.dmaRxSize		= size;
+	instance.dmaRxPos		= 0;
+	instance.dmaRxCallback	= cb;
+	
+	DMA_config cfg;
+	cfg.channel = instance.dmaRx.channel;
+	cfg.request = instance.dmaRx.request;
+	cfg.dir = DMA_PER_TO_MEM;
+#if defined __stm32f1 || defined __stm32f4
+	cfg.source = (uint32_t*) &(instance.regs->DR);
+#else
+	cfg.source = (uint32_t*) &(instance.regs->RDR);
+#endif
+	cfg.target = (uint32_t*) buffer;
+	cfg.prio = DMA_PRIO_HIGH;
+	cfg.count = size;
+	cfg.src_size = 1;
+	cfg.des_size = 1;
+	cfg.circular = true;
+	cfg.src_incr = false;
+	cfg.des_incr = true;
+	
+	DMA_callbacks cbs;
+	cbs.half = usartRxDma;
+	cbs.filled = usartRxDma;
+	cbs.ctx = &instance;
+	if (!DMA::configureChannel(instance.dmaRx.device, cfg, cbs)) {
+		DMA::release(instance.dmaRx);
+		instance.dmaRxBuffer = 0;
+		return false;
 	}
-	else {
-		return false; // TODO: define other USARTS.
+	
+	// Run the USART interrupt at the same priority as the DMA interrupt, so that neither can
+	// interrupt the other while reporting data.
+	NVIC_SetPriority(instance.irqType, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 1));
+	
+	// Hand reception over to the DMA, and use the idle line interrupt to report partial data.
+	// The USART stays enabled throughout.
+	instance.regs->CR1 &= ~USART_CR1_RXNEIE;
+	instance.regs->CR3 |= USART_CR3_DMAR;
+	instance.regs->CR1 |= USART_CR1_IDLEIE;
+	
+	return true;
+}
+
+
+// --- STOP RX DMA ---
+bool USART::stopRxDMA(USART_devices device) {
+	USART_device &instance = devicesStatic[device];
+	if (!instance.active || instance.dmaRxBuffer == 0) { return false; }
+	
+	instance.regs->CR3 &= ~USART_CR3_DMAR;
+	DMA::release(instance.dmaRx);
+	instance.dmaRxBuffer = 0;
+	instance.dmaRxCallback = 0;
+	
+	// Return to interrupt-driven reception.
+	if (instance.rxBuffer == 0) {
+		instance.regs->CR1 &= ~USART_CR1_IDLEIE;
 	}
 	
-	DMA::start(DMA_1);
+	instance.regs->CR1 |= USART_CR1_RXNEIE;
+	NVIC_SetPriority(instance.irqType, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 1));
+	
 	return true;
+}
+
+
+// --- START TX DMA ---
+// Configures the TX DMA channel once, for transmitting the descriptors passed to queueTxDMA().
+// Descriptors are sent back to back, each one started from the transfer complete interrupt of the
+// previous one. The callback is called for each completed descriptor, after which its data may be
+// reused. The queue holds up to size - 1 pending descriptors.
+bool USART::startTxDMA(USART_devices device, USART_tx_desc* queue, uint8_t size, USART_tx_cb cb) {
+	USART_device &instance = devicesStatic[device];
+	if (!instance.active) { return false; }
+	if (queue == 0 || size < 2) { return false; }
+	if (!DMA::acquire(instance.per, DMA_DIR_TX, instance.dmaTx)) { return false; }
+	
+	instance.dmaTxQueue 	= queue;
+	instance.dmaTxSize		= size;
+	instance.dmaTxHead		= 0;
+	instance.dmaTxTail		= 0;
+	instance.dmaTxBusy		= false;
+	instance.dmaTxCallback	= cb;
+	
+	// A count of zero leaves the channel idle until the first descriptor is queued.
+	DMA_config cfg;
+	cfg.channel = instance.dmaTx.channel;
+	cfg.request = instance.dmaTx.request;
+	cfg.dir = DMA_MEM_TO_PER;
+	cfg.source = 0;
+#if defined __stm32f1 || defined __stm32f4
+	cfg.target = (uint32_t*) &(instance.regs->DR);
 #else
+	cfg.target = (uint32_t*) &(instance.regs->TDR);
+#endif
+	cfg.prio = DMA_PRIO_MEDIUM;
+	cfg.count = 0;
+	cfg.src_size = 1;
+	cfg.des_size = 1;
+	cfg.circular = false;
+	cfg.src_incr = true;
+	cfg.des_incr = false;
 	
-	return false;
+	DMA_callbacks cbs;
+	cbs.filled = usartTxDmaDone;
+	cbs.ctx = &instance;
+	if (!DMA::configureChannel(instance.dmaTx.device, cfg, cbs)) {
+		DMA::release(instance.dmaTx);
+		instance.dmaTxQueue = 0;
+		return false;
+	}
+	
+	instance.regs->CR3 |= USART_CR3_DMAT;
+	
+	return true;
+}
+
+
+// --- QUEUE TX DMA ---
+// Adds a descriptor to the TX DMA queue. Returns false if the queue is full.
+bool USART::queueTxDMA(USART_devices device, const uint8_t* data, uint16_t len) {
+	USART_device &instance = devicesStatic[device];
+	if (instance.dmaTxQueue == 0 || len == 0) { return false; }
+	
+	uint8_t head = instance.dmaTxHead;
+	uint8_t next = (head + 1 == instance.dmaTxSize) ? 0 : head + 1;
+	if (next == instance.dmaTxTail) { return false; }
+	
+	instance.dmaTxQueue[head].data = data;
+	instance.dmaTxQueue[head].len = len;
+	instance.dmaTxHead = next;
+	
+	// If the DMA is idle, start it here. Otherwise the transfer complete interrupt picks it up.
+	if (!instance.dmaTxBusy) {
+		instance.dmaTxBusy = true;
+		DMA::transfer(instance.dmaTx.device, instance.dmaTx.channel, (uint32_t*) data, len);
+	}
+	
+	return true;
+}
+
+
+// --- STOP TX DMA ---
+// Stops the TX DMA. Queued descriptors are dropped without being reported.
+bool USART::stopTxDMA(USART_devices device) {
+	USART_device &instance = devicesStatic[device];
+	if (!instance.active || instance.dmaTxQueue == 0) { return false; }
+	
+	DMA::release(instance.dmaTx);
+	instance.regs->CR3 &= ~USART_CR3_DMAT;
+	instance.dmaTxQueue = 0;
+	instance.dmaTxBusy = false;
+	
+	return true;
+}
 #endif
+
+
+// --- SET RX BUFFER ---
+// Switches reception from the per-byte callback to a ring buffer of size - 1 bytes. The notify
+// callback is called from the interrupt when the line goes idle, or when the number of buffered
+// bytes reaches the watermark (0 to disable). Set a null buffer to return to the callback.
+bool USART::setRxBuffer(USART_devices device, uint8_t* buffer, uint16_t size, uint16_t watermark, 
+																			USART_rx_cb notify) {
+	USART_device &instance = devicesStatic[device];
+	if (buffer != 0 && (size < 2 || watermark >= size)) { return false; }
+	
+	// Keep the interrupt handler from using the buffer while it is being replaced.
+	instance.rxBuffer	= 0;
+	instance.rxSize 	= size;
+	instance.rxHead 	= 0;
+	instance.rxTail 	= 0;
+	instance.rxWatermark = watermark;
+	instance.rxNotify	= notify;
+	instance.rxDropped	= 0;
+	instance.rxBuffer	= buffer;
+	
+	if (instance.active) {
+		if (buffer != 0) 	{ instance.regs->CR1 |= USART_CR1_IDLEIE; }
+		else 				{ instance.regs->CR1 &= ~USART_CR1_IDLEIE; }
+	}
+	
+	return true;
 }
+
+
+// --- READ ---
+// Copies up to max bytes from the RX buffer. Returns the number of bytes read.
+uint16_t USART::read(USART_devices device, char* buffer, uint16_t max) {
+	USART_device &instance = devicesStatic[device];
+	if (instance.rxBuffer == 0) { return 0; }
+	
+	uint16_t tail = instance.rxTail;
+	uint16_t head = instance.rxHead;
+	uint16_t count = 0;
+	while (count < max && tail != head) {
+		buffer[count++] = instance.rxBuffer[tail];
+		tail = (tail + 1 == instance.rxSize) ? 0 : tail + 1;
+	}
+	
+	instance.rxTail = tail;
+	
+	return count;
+}
+
+
+// --- AVAILABLE ---
+// Returns the number of bytes waiting in the RX buffer.
+uint16_t USART::available(USART_devices device) {
+	USART_device &instance = devicesStatic[device];
+	if (instance.rxBuffer == 0) { return 0; }
+	
+	return usartRxAvailable(instance);
+}
+
+
+// --- RX DROPPED ---
+// Returns the number of received bytes dropped because the RX buffer was full, since the buffer
+// was set.
+uint32_t USART::rxDropped(USART_devices device) {
+	return devicesStatic[device].rxDropped;
+}
+
+
+// --- SET TX BUFFER ---
+// Sets the buffer used to queue data for interrupt-driven transmission. Up to size - 1 bytes
+// can be queued. Set a null buffer to return to polled transmission.
+bool USART::setTxBuffer(USART_devices device, uint8_t* buffer, uint16_t size) {
+	USART_device &instance = devicesStatic[device];
+	if (buffer != 0 && size < 2) { return false; }
+	
+	// Wait for any queued data to be sent.
+	if (instance.active && instance.txBuffer != 0) { flush(device); }
+	
+	instance.txBuffer 	= buffer;
+	instance.txSize 	= size;
+	instance.txHead 	= 0;
+	instance.txTail 	= 0;
+	instance.txReserve 	= 0;
+	instance.txWriters 	= 0;
+	instance.txDropped 	= 0;
+	
+	return true;
+}
+
+
+// --- WRITE ---
+// Queues up to len bytes in the TX buffer without blocking. Returns the number of bytes queued.
+// Safe to call from multiple tasks and interrupt handlers. Space is reserved with interrupts
+// disabled and the data is copied with them enabled. The reserved data is committed to the
+// interrupt handler once the last overlapping write() has finished copying.
+uint16_t USART::write(USART_devices device, const char* buffer, uint16_t len) {
+	USART_device &instance = devicesStatic[device];
+	if (!instance.active || instance.txBuffer == 0) { return 0; }
+	
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	uint16_t head = instance.txReserve;
+	uint16_t tail = instance.txTail;
+	uint16_t used = (head >= tail) ? head - tail : instance.txSize - tail + head;
+	uint16_t count = instance.txSize - 1 - used;
+	if (count > len) { count = len; }
+	if (count == 0) {
+		__set_PRIMASK(primask);
+		return 0; // Buffer is full.
+	}
+	
+	instance.txReserve = (head + count >= instance.txSize) ? head + count - instance.txSize 
+														: head + count;
+	instance.txWriters++;
+	
+	__set_PRIMASK(primask);
+	
+	for (uint16_t i = 0; i < count; i++) {
+		instance.txBuffer[head] = buffer[i];
+		head = (head + 1 == instance.txSize) ? 0 : head + 1;
+	}
+	
+	primask = __get_PRIMASK();
+	__disable_irq();
+	
+	// The data has to be in the buffer before the interrupt handler can see the new head.
+	__asm volatile ("" ::: "memory");
+	if (--instance.txWriters == 0) {
+		instance.txHead = instance.txReserve;
+		
+		// (Re)start the transmission interrupt.
+		instance.regs->CR1 |= USART_CR1_TXEIE;
+	}
+	
+	__set_PRIMASK(primask);
+	
+	return count;
+}
+
+
+// --- TX DROPPED ---
+// Returns the number of bytes dropped by sendUart() because the TX buffer was full and could not
+// be drained, since the buffer was set.
+uint32_t USART::txDropped(USART_devices device) {
+	return devicesStatic[device].txDropped;
+}
+
+
+// --- FLUSH ---
+// Blocks until the TX buffer is empty and the last byte has left the transmitter.
+bool USART::flush(USART_devices device) {
+	USART_device &instance = devicesStatic[device];
+	if (!instance.active) { return false; }
+	
+	while (instance.txHead != instance.txTail) {}
+	
+#if defined __stm32f4 || defined __stm32f1
+	while (!(instance.regs->SR & USART_SR_TC)) {}
+#else
+	while (!(instance.regs->ISR & USART_ISR_TC)) {}
 #endif
+	
+	return true;
+}
+
+
+// Sends the next committed byte from the TX buffer by polling TXE, with interrupts disabled so
+// that the interrupt handler can't take it as well. Returns false if no byte is committed.
+static bool usartTxPoll(USART_device &instance) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	
+	if (instance.txTail == instance.txHead) {
+		__set_PRIMASK(primask);
+		return false;
+	}
+	
+#if defined __stm32f4 || defined __stm32f1
+	while (!(instance.regs->SR & USART_SR_TXE)) {}
+	instance.regs->DR = instance.txBuffer[instance.txTail];
+#else
+	while (!(instance.regs->ISR & USART_ISR_TXE)) {}
+	instance.regs->TDR = instance.txBuffer[instance.txTail];
+#endif
+	instance.txTail = (instance.txTail + 1 == instance.txSize) ? 0 : instance.txTail + 1;
+	
+	__set_PRIMASK(primask);
+	
+	return true;
+}
 
 
 // --- SEND UART ---
@@ -524,6 +909,22 @@ bool USART::sendUart(USART_devices device, char &ch) {
 	USART_device &instance = devicesStatic[device];
 	if (!instance.active) { return false; }
 	
+	// If a TX buffer is set, queue the character behind any pending data.
+	if (instance.txBuffer != 0) {
+		while (write(device, &ch, 1) == 0) {
+			// With interrupts masked, or from an interrupt handler which may block the USART
+			// interrupt, drain the buffer here. If nothing can be sent, drop the character.
+			if (__get_PRIMASK() != 0 || __get_IPSR() != 0) {
+				if (!usartTxPoll(instance)) {
+					instance.txDropped++;
+					return false;
+				}
+			}
+		}
+		
+		return true;
+	}
+	
 	// Copy bit to the device's transmission register.
 #if defined __stm32f0 || defined __stm32f3 || defined __stm32f7 || defined __stm32l4
 	while (!(instance.regs->ISR & USART_ISR_TXE)) {}; // TODO: add timeout.
@@ -544,8 +945,8 @@ bool USART::stopUart(USART_devices device) {
 	USART_device &instance = devicesStatic[device];
 	if (!instance.active) { return false; }
 	
-	// Disable interrupt.
-	instance.regs->CR1 &= ~USART_CR1_RXNEIE;
+	// Disable interrupts.
+	instance.regs->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_TXEIE | USART_CR1_IDLEIE);
 	NVIC_DisableIRQ(instance.irqType);
 	
 	// Disable USART & ativated ports.
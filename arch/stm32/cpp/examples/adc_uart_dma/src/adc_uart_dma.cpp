@@ -29,24 +29,25 @@ USART_def& ud = boardUSARTs[1];
 uint8_t 	led_pin;
 GPIO_ports 	led_port;
 
+// TX DMA queue. Holds up to three pending buffer halves.
+USART_tx_desc txQueue[4];
 
-void buffer_half_filled_cb() {
-	// Copy first half of the buffer to the USART with DMA.
-	DMA_callbacks cbs;
+
+void buffer_half_filled_cb(void* ctx) {
+	// Queue the first half of the buffer for sending to the USART with DMA.
 	GPIO::write(led_port, led_pin, GPIO_LEVEL_HIGH);
-	USART::configureDMAT(ud.usart, (uint32_t*) (&ADC_array), half_buf, cbs);
+	USART::queueTxDMA(ud.usart, (uint8_t*) ADC_array, half_buf * sizeof(uint16_t));
 }
 
 
-void buffer_end_filled_cb() {
-	// Copy second half of the buffer to the USART with DMA.
-	DMA_callbacks cbs;
+void buffer_end_filled_cb(void* ctx) {
+	// Queue the second half of the buffer for sending to the USART with DMA.
 	GPIO::write(led_port, led_pin, GPIO_LEVEL_LOW);
-	USART::configureDMAT(ud.usart, (uint32_t*) (&ADC_array) + half_buf, half_buf, cbs);
+	USART::queueTxDMA(ud.usart, (uint8_t*) (ADC_array + half_buf), half_buf * sizeof(uint16_t));
 }
 
 
-void buffer_error_cb() {
+void buffer_error_cb(void* ctx) {
 	// Handle a DMA error.
 	
 }
@@ -80,6 +81,13 @@ int main() {
 	char ch = '1';
 	USART::sendUart(ud.usart, ch);
 	
+	// Configure the USART TX DMA once. Buffer halves are queued from the ADC DMA callbacks.
+	if (!USART::startTxDMA(ud.usart, txQueue, 4)) {
+		ch = 'd';
+		USART::sendUart(ud.usart, ch);
+		while (1) { }
+	}
+	
 	// 2. Set up ADC & DMA.
 	// Configure for continuous mode, single pin/channel.
 	// STM32F042K6 (Nucleo-F042K6): PA0, PA1 => Ch0, Ch1
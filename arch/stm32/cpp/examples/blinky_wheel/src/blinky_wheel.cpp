@@ -0,0 +1,50 @@
+// Blinky example for Nodate's STM32 framework, using software timers instead of busy delays.
+
+#include <gpio.h>
+#include <core.h>
+#include <timer_wheel.h>
+
+
+//const uint8_t led_pin = 3; // Nucleo-f042k6: Port B, pin 3.
+//const GPIO_ports led_port = GPIO_PORT_B;
+//const uint8_t led_pin = 7; // Nucleo-F746ZG: Port B, pin 7 (blue)
+//const GPIO_ports led_port = GPIO_PORT_B;
+const uint8_t led_pin = 13;	// Blue Pill: Port C, pin 13.
+const GPIO_ports led_port = GPIO_PORT_C;
+
+bool led_on = false;
+
+
+void blink(void* arg) {
+	led_on = !led_on;
+	GPIO::write(led_port, led_pin, led_on ? GPIO_LEVEL_LOW : GPIO_LEVEL_HIGH);
+}
+
+
+void stopBlinking(void* arg) {
+	// Stop the blinking after a minute, leaving the LED off.
+	TimerWheel::cancel(*((uint32_t*) arg));
+	GPIO::write(led_port, led_pin, GPIO_LEVEL_HIGH);
+}
+
+
+int main () {
+	// Set the pin mode on the LED pin.
+	GPIO::set_output(led_port, led_pin, GPIO_PULL_UP);
+	GPIO::write(led_port, led_pin, GPIO_LEVEL_HIGH);
+	
+	// Run the callbacks from the main loop, and only wake up when a timer is due.
+	TimerWheel::init(WHEEL_RUN_DEFERRED);
+	McuCore::setTickless(true);
+	
+	uint32_t blinker, stopper;
+	TimerWheel::start(1000, blink, true, blinker);
+	TimerWheel::start(60000, stopBlinking, false, stopper, &blinker);
+	
+	while (1) {
+		TimerWheel::run();
+		TimerWheel::idle();
+	}
+	
+	return 0;
+}
@@ -73,7 +73,9 @@ int main () {
 	spins.mosi = { GPIO_PORT_A, 7, 0 };
 	spins.sclk = { GPIO_PORT_A, 5, 0 };
 	spins.nss = { GPIO_PORT_A, 4, 0 };
-	if (!SPI::startSPIMaster(SPI_1, spins)) {
+	SPI_config scfg;
+	scfg.frequency = 10000000;	// BME280 maximum SCK.
+	if (!SPI::startSPIMaster(SPI_1, spins, scfg)) {
 		// Handle error.
 		printf("SPI master init error.\n");
 		while (1) { }
@@ -62,7 +62,9 @@ int main() {
 	spins.mosi = { GPIO_PORT_A, 7, 5 };
 	spins.sclk = { GPIO_PORT_A, 5, 5 };
 	spins.nss = { GPIO_PORT_A, 4, 5 };
-	if (!SPI::startSPIMaster(SPI_1, spins)) {
+	SPI_config scfg;
+	scfg.frequency = 15000000;	// ST7735 maximum write clock (66 ns cycle).
+	if (!SPI::startSPIMaster(SPI_1, spins, scfg)) {
 		// Handle error.
 		printf("SPI master init error.\n");
 		while (1) { }
@@ -35,134 +35,60 @@ bool BME280::isReady() {
 // --- READ ID ---
 // Reads the sensor's fixed ID.
 bool BME280::readID(uint8_t &id) {
-	// Send register to read to the device.
-	uint8_t data = 0xd0;
-	/* I2C::setSlaveTarget(device, address);
-	I2C::sendToSlave(device, &data, 1); */
-	start();
-	send(&data, 1);
-    
-    // Initiate the read sequence
-	//return I2C::receiveFromSlave(device, 1, &id);
-	bool res = receive(&id, 1);
-	//bool res = transceive(&data, 1, &id, 1);
-	end();
-	
-	return res;
+	return readRegisters(0xd0, &id, 1);
 }
 
 
 bool BME280::initialize() {
-	// Set the configuration for the device.
+	// Set the configuration for the device. Humidity control only takes effect after the
+	// following write to the measurement control register.
 	uint8_t ctrl_meas_reg = (osrs_t << 5) | (osrs_p << 2) | BME280_OperationMode;
 	uint8_t ctrl_hum_reg  = osrs_h;
 	uint8_t config_reg    = (t_sb << 5) | (filter << 2) | spi3w_en;
 	
-	//I2C::setSlaveTarget(device, address);
-	start();
-
-	uint8_t data[2];
-	data[0] = controlHumidity;
-	data[1] = ctrl_hum_reg;
-	//if (!I2C::sendToSlave(device, data, 2)) { return false; }
-	if (!write(data, 2)) { return false; }
-	
-	data[0] = reg_Control;
-	data[1] = ctrl_meas_reg;
-	//if (!I2C::sendToSlave(device, data, 2)) { return false; }
-	if (!write(data, 2)) { return false; }
-	
-	data[0] = reg_Config;
-	data[1] = config_reg;
-	//if (!I2C::sendToSlave(device, data, 2)) { return false; }
-	if (!write(data, 2)) { return false; }
-	
-	end();
+	if (!writeRegister(controlHumidity, ctrl_hum_reg)) { return false; }
+	if (!writeRegister(reg_Control, ctrl_meas_reg)) { return false; }
+	if (!writeRegister(reg_Config, config_reg)) { return false; }
 
-	// Read calibration data from device and store it.
-	//I2C::sendToSlave(device, &reg_CalibrationTStart, 1);
-	start();
-	send(&reg_CalibrationTStart, 1);
+	// Read calibration data from device and store it. Temperature, pressure & H1 are in one
+	// block (0x88 - 0xA1), H2 - H6 in another (0xE1 - 0xE7).
 	uint8_t buffer[64];
-	//I2C::receiveFromSlave(device, reg_CalibrationTEnd - reg_CalibrationTStart + 1, buffer);
-	receive(buffer, reg_CalibrationTEnd - reg_CalibrationTStart + 1);
-	//transceive(&reg_CalibrationTStart, 1, buffer, reg_CalibrationTEnd - reg_CalibrationTStart + 1);
-	end();
+	if (!readRegisters(reg_CalibrationTStart, buffer, reg_H1 - reg_CalibrationTStart + 1)) {
+		return false;
+	}
 	
-	// This data is in Big Endian format from the BME280.
+	// This data is in Little Endian format from the BME280.
     dig_T1 = (buffer[1] << 8) | buffer[0];
     dig_T2 = (buffer[3] << 8) | buffer[2];
     dig_T3 = (buffer[5] << 8) | buffer[4];
 
-	//I2C::sendToSlave(device, &reg_CalibrationPStart, 1);
-	start();
-	send(&reg_CalibrationPStart, 1);
-	//I2C::receiveFromSlave(device, reg_CalibrationPEnd - reg_CalibrationPStart + 1, buffer);
-	receive(buffer, reg_CalibrationPEnd - reg_CalibrationPStart + 1);
-	//transceive(&reg_CalibrationPStart, 1, buffer, reg_CalibrationPEnd - reg_CalibrationPStart + 1);
-	end();
-
-    dig_P1 = (buffer[1] << 8) | buffer[0];
-    dig_P2 = (buffer[3] << 8) | buffer[2];
-    dig_P3 = (buffer[5] << 8) | buffer[4];
-    dig_P4 = (buffer[7] << 8) | buffer[6];
-    dig_P5 = (buffer[9] << 8) | buffer[8];
-    dig_P6 = (buffer[11] << 8) | buffer[10];
-    dig_P7 = (buffer[13] << 8) | buffer[12];
-    dig_P8 = (buffer[15] << 8) | buffer[14];
-	dig_P9 = (buffer[17] << 8) | buffer[16];
-
-	//I2C::sendToSlave(device, &reg_H1, 1);
-	start();
-	send(&reg_H1, 1);
-	//I2C::receiveFromSlave(device, 1, buffer);
-	receive(buffer, 1);
-	end();
-	//transceive(&reg_H1, 1, buffer, 1);
-	dig_H1 = buffer[0];
-	
-	//I2C::sendToSlave(device, &reg_H2, 1);
-	//I2C::receiveFromSlave(device, 2, buffer);
-	start();
-	send(&reg_H2, 1);
-	receive(buffer, 2);
-	end();
-	//transceive(&reg_H2, 1, buffer, 2);
-    dig_H2 = (buffer[1] << 8) | buffer[0];
+	uint8_t* p = buffer + (reg_CalibrationPStart - reg_CalibrationTStart);
+    dig_P1 = (p[1] << 8) | p[0];
+    dig_P2 = (p[3] << 8) | p[2];
+    dig_P3 = (p[5] << 8) | p[4];
+    dig_P4 = (p[7] << 8) | p[6];
+    dig_P5 = (p[9] << 8) | p[8];
+    dig_P6 = (p[11] << 8) | p[10];
+    dig_P7 = (p[13] << 8) | p[12];
+    dig_P8 = (p[15] << 8) | p[14];
+	dig_P9 = (p[17] << 8) | p[16];
 	
-	//I2C::sendToSlave(device, &reg_H3, 1);
-	//I2C::receiveFromSlave(device, 1, buffer);
-	start();
-	send(&reg_H3, 1);
-	receive(buffer, 1);
-	end();
-    dig_H3 = buffer[0];
+	dig_H1 = buffer[reg_H1 - reg_CalibrationTStart];
 	
-	//I2C::sendToSlave(device, &reg_H4, 1);
-	//I2C::receiveFromSlave(device, 4, buffer);
-	start();
-	send(&reg_H4, 1);
-	receive(buffer, 4);
-	//transceive(&reg_H4, 1, buffer, 4);
-	end();
-    dig_H4 = (buffer[0] << 4) | (buffer[1]&0x0F);
+	if (!readRegisters(reg_H2, buffer, reg_H6 - reg_H2 + 1)) { return false; }
 	
-    dig_H5 = (buffer[2]<<4) | ((buffer[1] & 0xF0)>>4);
-	dig_H6 = buffer[3];
+    dig_H2 = (buffer[1] << 8) | buffer[0];
+    dig_H3 = buffer[reg_H3 - reg_H2];
+    dig_H4 = (buffer[reg_H4 - reg_H2] << 4) | (buffer[reg_H4 - reg_H2 + 1] & 0x0F);
+    dig_H5 = (buffer[reg_H5 - reg_H2 + 1] << 4) | ((buffer[reg_H5 - reg_H2] & 0xF0) >> 4);
+	dig_H6 = buffer[reg_H6 - reg_H2];
 	
 	return true;
 }
 
 
 bool BME280::softReset() {
-	uint8_t data[] = { reg_SoftReset, softResetInstruction };
-	/* I2C::setSlaveTarget(device, address);
-	I2C::sendToSlave(device, data, 2); */
-	start();
-	send(data, 2);
-	end();
-	
-	return true;
+	return writeRegister(reg_SoftReset, softResetInstruction);
 }
 
 
@@ -189,22 +115,9 @@ float BME280::humidity() {
 
 
 bool BME280::rawTemperature(int32_t &t) {
-	// Send register to read to the device.
-	uint8_t data = 0xFA;
-	//I2C::setSlaveTarget(device, address);
-	//I2C::sendToSlave(device, &data, 1);
-	start();
-	send(&data, 1);
-    
-    // Initiate the read sequence
 	uint8_t buffer[3];
-    //if (!(I2C::receiveFromSlave(device, 3, buffer))) {
-    if (!(receive(buffer, 3))) {
-		end();
-        return false;
-    }
+	if (!readRegisters(0xFA, buffer, 3)) { return false; }
 	
-	end();
  	t = ((buffer[0] << 12) | (buffer[1] << 4) | (buffer[2] >> 4));
 
     return true;
@@ -223,6 +136,43 @@ float BME280::compensateTemperature(int32_t rawTemp) {
 }
 
 
+// --- READ REGISTERS ---
+// Reads 'len' bytes starting at register 'reg' in a single bus transaction. Over SPI the sensor
+// auto-increments the register address, over I2C a repeated START follows the register address.
+bool BME280::readRegisters(uint8_t reg, uint8_t* data, uint16_t len) {
+	if (spi) {
+		start();
+		bool res = send(&reg, 1) && receive(data, len);
+		end();
+		return res;
+	}
+	
+#ifdef NODATE_I2C_ENABLED
+	return I2C::readRegisters(i2c_device, address, reg, data, len);
+#else
+	return false;
+#endif
+}
+
+
+// --- WRITE REGISTER ---
+bool BME280::writeRegister(uint8_t reg, uint8_t value) {
+	if (spi) {
+		uint8_t data[2] = { reg, value };
+		start();
+		bool res = write(data, 2);
+		end();
+		return res;
+	}
+	
+#ifdef NODATE_I2C_ENABLED
+	return I2C::writeRegisters(i2c_device, address, reg, &value, 1);
+#else
+	return false;
+#endif
+}
+
+
 // --- START ---
 // Take any actions to enable communication with the device.
 bool BME280::start() {
@@ -80,6 +80,9 @@ class BME280 {
 	
 	int32_t t_fine;
 	
+	bool readRegisters(uint8_t reg, uint8_t* data, uint16_t len);
+	bool writeRegister(uint8_t reg, uint8_t value);
+	
 public:
 	BME280(I2C_devices device, uint8_t address);
 	BME280(SPI_devices device, GpioPinDef cs);
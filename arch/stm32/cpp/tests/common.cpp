@@ -3,6 +3,13 @@
 
 
 uint32_t SystemCoreClock = 8000000;
+const uint8_t APBPrescTable[8] = {0, 0, 0, 0, 1, 2, 3, 4};
+uint32_t mockPrimask = 0;
+
+#ifdef NODATE_TEST_COUNT_ACCESS
+uint32_t RegisterCount::reads = 0;
+uint32_t RegisterCount::writes = 0;
+#endif
 
 
 GPIO_TypeDef tGpioA;
@@ -110,3 +117,125 @@ USART_TypeDef tUsart2;
 USART_TypeDef* USART2 = & tUsart2;
 USART_TypeDef tUsart3;
 USART_TypeDef* USART3 = & tUsart3;
+
+
+SPI_TypeDef tSpi1;
+SPI_TypeDef* SPI1 = &tSpi1;
+
+uint32_t SpiModel::reads = 0;
+uint32_t SpiModel::writes = 0;
+uint32_t SpiModel::time = 0;
+uint32_t SpiModel::frames = 0;
+uint32_t SpiModel::overruns = 0;
+uint32_t SpiModel::frameTime = 4;
+uint8_t SpiModel::txFifo[4];
+uint8_t SpiModel::txLevel = 0;
+uint8_t SpiModel::rxFifo[4];
+uint8_t SpiModel::rxLevel = 0;
+uint8_t SpiModel::shifter = 0;
+bool SpiModel::shifting = false;
+uint32_t SpiModel::progress = 0;
+
+
+void SpiModel::reset() {
+	reads = 0;
+	writes = 0;
+	time = 0;
+	frames = 0;
+	overruns = 0;
+	txLevel = 0;
+	rxLevel = 0;
+	shifting = false;
+	progress = 0;
+}
+
+
+// FIFO (F0) or single buffer depth in frames.
+uint8_t SpiModel::capacity() {
+#ifdef STM32F0
+	return 4;
+#else
+	return 1;
+#endif
+}
+
+
+// Advances time by one unit. A completed frame moves to the RX FIFO, after which the next frame
+// is loaded from the TX FIFO.
+void SpiModel::tick() {
+	time++;
+	if (shifting && ++progress >= frameTime) {
+		if (rxLevel < capacity()) 	{ rxFifo[rxLevel++] = shifter; }
+		else 						{ overruns++; }
+		
+		frames++;
+		shifting = false;
+	}
+	
+	if (!shifting && txLevel > 0) {
+		shifter = txFifo[0];
+		for (uint8_t i = 1; i < txLevel; ++i) { txFifo[i - 1] = txFifo[i]; }
+		txLevel--;
+		shifting = true;
+		progress = 0;
+	}
+}
+
+
+uint32_t SpiModel::status() {
+	uint32_t sr = 0;
+#ifdef STM32F0
+	// TXE while the TX FIFO is at most half full, RXNE with at least one byte (FRXTH = 1).
+	if (txLevel <= 2) { sr |= SPI_SR_TXE; }
+	if (rxLevel >= 1) { sr |= SPI_SR_RXNE; }
+	sr |= (uint32_t) (rxLevel == 0 ? 0 : rxLevel == 1 ? 1 : rxLevel < 4 ? 2 : 3) << SPI_SR_FRLVL_Pos;
+	sr |= (uint32_t) (txLevel == 0 ? 0 : txLevel == 1 ? 1 : txLevel < 4 ? 2 : 3) << SPI_SR_FTLVL_Pos;
+#else
+	if (txLevel == 0) { sr |= SPI_SR_TXE; }
+	if (rxLevel > 0) { sr |= SPI_SR_RXNE; }
+#endif
+	if (shifting || txLevel > 0) { sr |= SPI_SR_BSY; }
+	if (overruns > 0) { sr |= SPI_SR_OVR; }
+	
+	return sr;
+}
+
+
+void SpiModel::push(uint8_t data) {
+	if (txLevel < capacity()) { txFifo[txLevel++] = data; }
+}
+
+
+uint8_t SpiModel::pop() {
+	if (rxLevel == 0) { return 0; }
+	
+	uint8_t data = rxFifo[0];
+	for (uint8_t i = 1; i < rxLevel; ++i) { rxFifo[i - 1] = rxFifo[i]; }
+	rxLevel--;
+	
+	return data;
+}
+
+
+SpiDataAccess::operator uint32_t() const {
+	SpiModel::reads++;
+	SpiModel::tick();
+	uint32_t data = SpiModel::pop();
+#ifdef STM32F0
+	if (width == 2) { data |= (uint32_t) SpiModel::pop() << 8; }
+#endif
+	
+	return data;
+}
+
+
+SpiDataAccess& SpiDataAccess::operator=(uint32_t v) {
+	SpiModel::writes++;
+	SpiModel::tick();
+	SpiModel::push((uint8_t) v);
+#ifdef STM32F0
+	if (width == 2) { SpiModel::push((uint8_t) (v >> 8)); }
+#endif
+	
+	return *this;
+}
@@ -11,33 +11,58 @@
 
 
 extern uint32_t SystemCoreClock;          /*!< System Clock Frequency (Core Clock) */
+extern const uint8_t APBPrescTable[8];    /*!< APB prescalers table values */
+
+
+// GPIO registers can be swapped for a type which counts each read & write, for benchmarking.
+#ifdef NODATE_TEST_COUNT_ACCESS
+struct RegisterCount {
+	static uint32_t reads;
+	static uint32_t writes;
+	static void reset() { reads = 0; writes = 0; }
+};
+
+class CountedRegister {
+	volatile uint32_t value;
+	
+public:
+	operator uint32_t() const { RegisterCount::reads++; return value; }
+	CountedRegister& operator=(uint32_t v) { RegisterCount::writes++; value = v; return *this; }
+	CountedRegister& operator|=(uint32_t v) { return *this = (uint32_t) *this | v; }
+	CountedRegister& operator&=(uint32_t v) { return *this = (uint32_t) *this & v; }
+};
+
+#define __GPIO_REG CountedRegister
+#else
+#define __GPIO_REG __IO uint32_t
+#endif
 
 
 #ifdef STM32F0
 // STM32F0
 struct GPIO_TypeDef {
-  __IO uint32_t MODER;        //!< GPIO port mode register,                     Address offset: 0x00      
-  __IO uint32_t OTYPER;       //!< GPIO port output type register,              Address offset: 0x04      
-  __IO uint32_t OSPEEDR;      //!< GPIO port output speed register,             Address offset: 0x08      
-  __IO uint32_t PUPDR;        //!< GPIO port pull-up/pull-down register,        Address offset: 0x0C      
-  __IO uint32_t IDR;          //!< GPIO port input data register,               Address offset: 0x10      
-  __IO uint32_t ODR;          //!< GPIO port output data register,              Address offset: 0x14      
-  __IO uint32_t BSRR;         //!< GPIO port bit set/reset register,      Address offset: 0x1A 
-  __IO uint32_t LCKR;         //!< GPIO port configuration lock register,       Address offset: 0x1C      
-  __IO uint32_t AFR[2];       //!< GPIO alternate function low register,  Address offset: 0x20-0x24 
-  __IO uint32_t BRR;          //!< GPIO bit reset register,                     Address offset: 0x28      
+  __GPIO_REG    MODER;        //!< GPIO port mode register,                     Address offset: 0x00      
+  __GPIO_REG    OTYPER;       //!< GPIO port output type register,              Address offset: 0x04      
+  __GPIO_REG    OSPEEDR;      //!< GPIO port output speed register,             Address offset: 0x08      
+  __GPIO_REG    PUPDR;        //!< GPIO port pull-up/pull-down register,        Address offset: 0x0C      
+  __GPIO_REG    IDR;          //!< GPIO port input data register,               Address offset: 0x10      
+  __GPIO_REG    ODR;          //!< GPIO port output data register,              Address offset: 0x14      
+  __GPIO_REG    BSRR;         //!< GPIO port bit set/reset register,      Address offset: 0x1A 
+  __GPIO_REG    LCKR;         //!< GPIO port configuration lock register,       Address offset: 0x1C      
+  __GPIO_REG    AFR[2];       //!< GPIO alternate function low register,  Address offset: 0x20-0x24 
+  __GPIO_REG    BRR;          //!< GPIO bit reset register,                     Address offset: 0x28      
 };
 
 #elif defined STM32F1
 // STM32F1
 struct GPIO_TypeDef {
-  __IO uint32_t CRL;
-  __IO uint32_t CRH;
-  __IO uint32_t IDR;
-  __IO uint32_t ODR;
-  __IO uint32_t BSRR;
-  __IO uint32_t BRR;
-  __IO uint32_t LCKR;
+  __GPIO_REG    CRL;
+  __GPIO_REG    CRH;
+  __GPIO_REG    IDR;
+  __GPIO_REG    ODR;
+  __GPIO_REG    BSRR;
+  __GPIO_REG    BRR;
+  __GPIO_REG    LCKR;
 };
 
 struct AFIO_TypeDef {
@@ -52,15 +77,15 @@ extern AFIO_TypeDef* AFIO;
 #else
 // STM32F4
 struct GPIO_TypeDef {
-  __IO uint32_t MODER;    /*!< GPIO port mode register,               Address offset: 0x00      */
-  __IO uint32_t OTYPER;   /*!< GPIO port output type register,        Address offset: 0x04      */
-  __IO uint32_t OSPEEDR;  /*!< GPIO port output speed register,       Address offset: 0x08      */
-  __IO uint32_t PUPDR;    /*!< GPIO port pull-up/pull-down register,  Address offset: 0x0C      */
-  __IO uint32_t IDR;      /*!< GPIO port input data register,         Address offset: 0x10      */
-  __IO uint32_t ODR;      /*!< GPIO port output data register,        Address offset: 0x14      */
-  __IO uint32_t BSRR;     /*!< GPIO port bit set/reset register,      Address offset: 0x18      */
-  __IO uint32_t LCKR;     /*!< GPIO port configuration lock register, Address offset: 0x1C      */
-  __IO uint32_t AFR[2];   /*!< GPIO alternate function registers,     Address offset: 0x20-0x24 */
+  __GPIO_REG    MODER;    /*!< GPIO port mode register,               Address offset: 0x00      */
+  __GPIO_REG    OTYPER;   /*!< GPIO port output type register,        Address offset: 0x04      */
+  __GPIO_REG    OSPEEDR;  /*!< GPIO port output speed register,       Address offset: 0x08      */
+  __GPIO_REG    PUPDR;    /*!< GPIO port pull-up/pull-down register,  Address offset: 0x0C      */
+  __GPIO_REG    IDR;      /*!< GPIO port input data register,         Address offset: 0x10      */
+  __GPIO_REG    ODR;      /*!< GPIO port output data register,        Address offset: 0x14      */
+  __GPIO_REG    BSRR;     /*!< GPIO port bit set/reset register,      Address offset: 0x18      */
+  __GPIO_REG    LCKR;     /*!< GPIO port configuration lock register, Address offset: 0x1C      */
+  __GPIO_REG    AFR[2];   /*!< GPIO alternate function registers,     Address offset: 0x20-0x24 */
 };
 
 #endif
@@ -322,6 +347,13 @@ uint32_t NVIC_EncodePriority (uint32_t PriorityGroup, uint32_t PreemptPriority,
 #endif
 }
 
+// Interrupt masking, tracked in a variable.
+extern uint32_t mockPrimask;
+inline uint32_t __get_PRIMASK() { return mockPrimask; }
+inline void __set_PRIMASK(uint32_t primask) { mockPrimask = primask; }
+inline void __disable_irq() { mockPrimask = 1; }
+inline void __enable_irq() { mockPrimask = 0; }
+
 
 // --- USART ---
 
@@ -375,6 +407,106 @@ extern USART_TypeDef* USART2;
 extern USART_TypeDef* USART3;
 
 
+// --- SPI ---
+// Model of the SPI data path, for benchmarking polled transfers with 8-bit frames. Each SR or DR
+// access advances time by one unit, and the shifter takes 'frameTime' units per frame. The
+// transmitted data is looped back into the receiver. F0 has 4-byte TX & RX FIFOs, the other
+// families a single frame buffer each way.
+struct SpiModel {
+	static uint32_t reads;
+	static uint32_t writes;
+	static uint32_t time;
+	static uint32_t frames;
+	static uint32_t overruns;
+	static uint32_t frameTime;
+	static uint8_t txFifo[4];
+	static uint8_t txLevel;
+	static uint8_t rxFifo[4];
+	static uint8_t rxLevel;
+	static uint8_t shifter;
+	static bool shifting;
+	static uint32_t progress;
+	
+	static void reset();
+	static void tick();
+	static uint8_t capacity();
+	static uint32_t status();
+	static void push(uint8_t data);
+	static uint8_t pop();
+};
+
+class SpiStatusRegister {
+public:
+	operator uint32_t() const { SpiModel::reads++; SpiModel::tick(); return SpiModel::status(); }
+	SpiStatusRegister& operator=(uint32_t) { SpiModel::writes++; SpiModel::tick(); return *this; }
+};
+
+// An 8- or 16-bit access to the data register. A 16-bit access moves two frames on F0.
+class SpiDataAccess {
+	uint8_t width;
+	
+public:
+	SpiDataAccess(uint8_t width) : width(width) { }
+	operator uint32_t() const;
+	SpiDataAccess& operator=(uint32_t v);
+};
+
+class SpiDataRegister {
+public:
+	SpiDataAccess access(uint8_t width) { return SpiDataAccess(width); }
+	operator uint32_t() const { return SpiDataAccess(1); }
+	SpiDataRegister& operator=(uint32_t v) { SpiDataAccess(1) = v; return *this; }
+};
+
+struct SPI_TypeDef {
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  SpiStatusRegister SR;
+  SpiDataRegister DR;
+  __IO uint32_t CRCPR;
+  __IO uint32_t RXCRCR;
+  __IO uint32_t TXCRCR;
+  __IO uint32_t I2SCFGR;
+  __IO uint32_t I2SPR;
+};
+
+#define SPI_DR8(regs) 	((regs)->DR.access(1))
+#define SPI_DR16(regs) 	((regs)->DR.access(2))
+
+extern SPI_TypeDef* SPI1;
+
+#define SPI_CR1_CPHA		(0x1UL << 0U)
+#define SPI_CR1_CPOL		(0x1UL << 1U)
+#define SPI_CR1_MSTR		(0x1UL << 2U)
+#define SPI_CR1_BR_Pos		(3U)
+#define SPI_CR1_BR			(0x7UL << SPI_CR1_BR_Pos)
+#define SPI_CR1_SPE			(0x1UL << 6U)
+#define SPI_CR1_LSBFIRST	(0x1UL << 7U)
+#define SPI_CR2_RXDMAEN		(0x1UL << 0U)
+#define SPI_CR2_TXDMAEN		(0x1UL << 1U)
+#define SPI_CR2_SSOE		(0x1UL << 2U)
+#define SPI_SR_RXNE			(0x1UL << 0U)
+#define SPI_SR_TXE			(0x1UL << 1U)
+#define SPI_SR_OVR			(0x1UL << 6U)
+#define SPI_SR_BSY			(0x1UL << 7U)
+
+#if defined STM32F0
+#define SPI_CR2_DS_Pos		(8U)
+#define SPI_CR2_DS			(0xFUL << SPI_CR2_DS_Pos)
+#define SPI_CR2_DS_0		(0x1UL << SPI_CR2_DS_Pos)
+#define SPI_CR2_DS_1		(0x2UL << SPI_CR2_DS_Pos)
+#define SPI_CR2_DS_2		(0x4UL << SPI_CR2_DS_Pos)
+#define SPI_CR2_FRXTH		(0x1UL << 12U)
+#define SPI_SR_FRLVL_Pos	(9U)
+#define SPI_SR_FRLVL		(0x3UL << SPI_SR_FRLVL_Pos)
+#define SPI_SR_FRLVL_1		(0x2UL << SPI_SR_FRLVL_Pos)
+#define SPI_SR_FTLVL_Pos	(11U)
+#define SPI_SR_FTLVL		(0x3UL << SPI_SR_FTLVL_Pos)
+#else
+#define SPI_CR1_DFF			(0x1UL << 11U)
+#endif
+
+
 // --- DEFINES ---
 
 #if defined STM32F0
@@ -390,6 +522,8 @@ extern USART_TypeDef* USART3;
 
 #define RCC_APB2ENR_SYSCFGCOMPEN_Pos 	(0U)
 #define RCC_APB2ENR_SYSCFGCOMPEN 	(0x1UL << RCC_APB2ENR_SYSCFGCOMPEN_Pos)
+#define RCC_APB2ENR_SPI1EN_Pos		(12U)
+#define RCC_APB2ENR_SPI1EN 			(0x1UL << RCC_APB2ENR_SPI1EN_Pos)
 
 #define RCC_APB2ENR_USART1EN_Pos                 (14U)                         
 #define RCC_APB2ENR_USART1EN_Msk                 (0x1UL << RCC_APB2ENR_USART1EN_Pos) /*!< 0x00004000 */
@@ -430,8 +564,51 @@ extern USART_TypeDef* USART3;
 #define USART_ISR_RXNE_Msk            (0x1UL << USART_ISR_RXNE_Pos)             /*!< 0x00000020 */
 #define USART_ISR_RXNE                USART_ISR_RXNE_Msk                       /*!< Read Data Register Not Empty */
 
+/********************  Bit definition for RCC_CFGR register  *****************/
+#define RCC_CFGR_HPRE_DIV1            (0x00000000U)                            /*!< SYSCLK not divided */
+#define RCC_CFGR_HPRE_DIV2            (0x00000080U)                            /*!< SYSCLK divided by 2 */
+#define RCC_CFGR_HPRE_DIV4            (0x00000090U)                            /*!< SYSCLK divided by 4 */
+#define RCC_CFGR_HPRE_DIV8            (0x000000A0U)                            /*!< SYSCLK divided by 8 */
+#define RCC_CFGR_HPRE_DIV16           (0x000000B0U)                            /*!< SYSCLK divided by 16 */
+#define RCC_CFGR_HPRE_DIV64           (0x000000C0U)                            /*!< SYSCLK divided by 64 */
+#define RCC_CFGR_HPRE_DIV128          (0x000000D0U)                            /*!< SYSCLK divided by 128 */
+#define RCC_CFGR_HPRE_DIV256          (0x000000E0U)                            /*!< SYSCLK divided by 256 */
+#define RCC_CFGR_HPRE_DIV512          (0x000000F0U)                            /*!< SYSCLK divided by 512 */
+#define RCC_CFGR_PPRE_Pos             (8U)                                     
+#define RCC_CFGR_PPRE_Msk             (0x7UL << RCC_CFGR_PPRE_Pos)              /*!< 0x00000700 */
+#define RCC_CFGR_PPRE_DIV1            (0x00000000U)                            /*!< HCLK not divided */
+#define RCC_CFGR_PPRE_DIV2            (0x00000400U)                            /*!< HCLK divided by 2 */
+#define RCC_CFGR_PPRE_DIV4            (0x00000500U)                            /*!< HCLK divided by 4 */
+#define RCC_CFGR_PPRE_DIV8            (0x00000600U)                            /*!< HCLK divided by 8 */
+#define RCC_CFGR_PPRE_DIV16           (0x00000700U)                            /*!< HCLK divided by 16 */
+
 #elif defined STM32F1
 // STM32F1
+/********************  Bit definition for RCC_CFGR register  *****************/
+#define RCC_CFGR_HPRE_DIV1                   0x00000000U                       /*!< SYSCLK not divided */
+#define RCC_CFGR_HPRE_DIV2                   0x00000080U                       /*!< SYSCLK divided by 2 */
+#define RCC_CFGR_HPRE_DIV4                   0x00000090U                       /*!< SYSCLK divided by 4 */
+#define RCC_CFGR_HPRE_DIV8                   0x000000A0U                       /*!< SYSCLK divided by 8 */
+#define RCC_CFGR_HPRE_DIV16                  0x000000B0U                       /*!< SYSCLK divided by 16 */
+#define RCC_CFGR_HPRE_DIV64                  0x000000C0U                       /*!< SYSCLK divided by 64 */
+#define RCC_CFGR_HPRE_DIV128                 0x000000D0U                       /*!< SYSCLK divided by 128 */
+#define RCC_CFGR_HPRE_DIV256                 0x000000E0U                       /*!< SYSCLK divided by 256 */
+#define RCC_CFGR_HPRE_DIV512                 0x000000F0U                       /*!< SYSCLK divided by 512 */
+#define RCC_CFGR_PPRE1_Pos                   (8U)                              
+#define RCC_CFGR_PPRE1_Msk                   (0x7UL << RCC_CFGR_PPRE1_Pos)      /*!< 0x00000700 */
+#define RCC_CFGR_PPRE1_DIV1                  0x00000000U                       /*!< HCLK not divided */
+#define RCC_CFGR_PPRE1_DIV2                  0x00000400U                       /*!< HCLK divided by 2 */
+#define RCC_CFGR_PPRE1_DIV4                  0x00000500U                       /*!< HCLK divided by 4 */
+#define RCC_CFGR_PPRE1_DIV8                  0x00000600U                       /*!< HCLK divided by 8 */
+#define RCC_CFGR_PPRE1_DIV16                 0x00000700U                       /*!< HCLK divided by 16 */
+#define RCC_CFGR_PPRE2_Pos                   (11U)                             
+#define RCC_CFGR_PPRE2_Msk                   (0x7UL << RCC_CFGR_PPRE2_Pos)      /*!< 0x00003800 */
+#define RCC_CFGR_PPRE2_DIV1                  0x00000000U                       /*!< HCLK not divided */
+#define RCC_CFGR_PPRE2_DIV2                  0x00002000U                       /*!< HCLK divided by 2 */
+#define RCC_CFGR_PPRE2_DIV4                  0x00002800U                       /*!< HCLK divided by 4 */
+#define RCC_CFGR_PPRE2_DIV8                  0x00003000U                       /*!< HCLK divided by 8 */
+#define RCC_CFGR_PPRE2_DIV16                 0x00003800U                       /*!< HCLK divided by 16 */
+
 #define RCC_APB2ENR_AFIOEN_Pos               (0U)                              
 #define RCC_APB2ENR_AFIOEN_Msk               (0x1UL << RCC_APB2ENR_AFIOEN_Pos)  /*!< 0x00000001 */
 #define RCC_APB2ENR_AFIOEN                   RCC_APB2ENR_AFIOEN_Msk            /*!< Alternate Function I/O clock enable */
@@ -0,0 +1,79 @@
+/*
+	gpio_bench.cpp - Counts the register accesses & time taken per GPIO::write() call.
+
+	Revision 0.
+
+	Build with NODATE_TEST_COUNT_ACCESS defined, so that the GPIO registers in the mock
+	header count each read & write.
+
+*/
+
+
+
+#include "../core/include/gpio.h"
+
+
+#include <iostream>
+#include <chrono>
+
+
+const uint32_t iterations = 100000;
+
+
+// Returns true if the RCC clock enable bit for GPIOA is set.
+bool portClockEnabled() {
+#ifdef STM32F1
+	return RCC->APB2ENR & RCC_APB2ENR_IOPAEN;
+#else
+	return RCC->AHBENR & RCC_AHBENR_GPIOAEN;
+#endif
+}
+
+
+// Clears the RCC clock enable bit for GPIOA, so that a subsequent enable can be detected.
+void clearPortClock() {
+#ifdef STM32F1
+	RCC->APB2ENR &= ~RCC_APB2ENR_IOPAEN;
+#else
+	RCC->AHBENR &= ~RCC_AHBENR_GPIOAEN;
+#endif
+}
+
+
+int main() {
+	std::cout << "Running GPIO write benchmark..." << std::endl;
+
+	if (!GPIO::set_output(GPIO_PORT_A, 3, GPIO_PULL_UP)) {
+		std::cout << "Set output failed." << std::endl;
+		return 1;
+	}
+
+	// Count the register accesses & RCC port enables for the write calls.
+	RegisterCount::reset();
+	uint32_t enables = 0;
+	for (uint32_t i = 0; i < iterations; ++i) {
+		clearPortClock();
+		GPIO::write(GPIO_PORT_A, 3, (i & 1) ? GPIO_LEVEL_HIGH : GPIO_LEVEL_LOW);
+		if (portClockEnabled()) { enables++; }
+	}
+
+	uint32_t reads = RegisterCount::reads;
+	uint32_t writes = RegisterCount::writes;
+
+	// Time the write calls.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		GPIO::write(GPIO_PORT_A, 3, (i & 1) ? GPIO_LEVEL_HIGH : GPIO_LEVEL_LOW);
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+	std::cout << "Iterations:\t\t" << iterations << std::endl;
+	std::cout << "GPIO reads per write:\t" << (double) reads / iterations << std::endl;
+	std::cout << "GPIO writes per write:\t" << (double) writes / iterations << std::endl;
+	std::cout << "RCC enables per write:\t" << (double) enables / iterations << std::endl;
+	std::cout << "Time per write (ns):\t" << ns / iterations << std::endl;
+
+	return 0;
+}
@@ -24,6 +24,7 @@ int main() {
 	if (gpio.write(GPIO_PORT_A, 3, GPIO_LEVEL_HIGH)) { std::cout << "Wrote HIGH." << std::endl; }
 	if (gpio.set_output(GPIO_PORT_B, 1, GPIO_PULL_UP)) { std::cout << "Set output." << std::endl; }
 	if (gpio.write(GPIO_PORT_B, 1, GPIO_LEVEL_HIGH)) { std::cout << "Wrote HIGH." << std::endl; }
+	if (gpio.writePort(GPIO_PORT_B, 0x00F0, 0x0002)) { std::cout << "Wrote port B." << std::endl; }
 	
 	if (gpio.set_input(GPIO_PORT_A, 1, GPIO_PULL_UP)) { std::cout << "Set input." << std::endl; }
 	if (gpio.set_input(GPIO_PORT_B, 3, GPIO_PULL_UP)) { std::cout << "Set input." << std::endl; }
@@ -58,6 +59,7 @@ int main() {
 	std::cout << "IDR:    \t" << std::bitset<32>(GPIOA->IDR) << std::endl;
 	std::cout << "ODR:    \t" << std::bitset<32>(GPIOA->ODR) << std::endl;
 #endif
+	std::cout << "BSRR:   \t" << std::bitset<32>(GPIOA->BSRR) << std::endl;
 	std::cout << std::endl;
 	
 #ifdef STM32F1
@@ -77,6 +79,7 @@ int main() {
 	std::cout << "IDR:    \t" << std::bitset<32>(GPIOB->IDR) << std::endl;
 	std::cout << "ODR:    \t" << std::bitset<32>(GPIOB->ODR) << std::endl;
 #endif
+	std::cout << "BSRR:   \t" << std::bitset<32>(GPIOB->BSRR) << std::endl;
 	std::cout << std::endl;
 	
 #ifdef STM32F1
@@ -96,6 +99,7 @@ int main() {
 	std::cout << "IDR:    \t" << std::bitset<32>(GPIOD->IDR) << std::endl;
 	std::cout << "ODR:    \t" << std::bitset<32>(GPIOD->ODR) << std::endl;
 #endif
+	std::cout << "BSRR:   \t" << std::bitset<32>(GPIOD->BSRR) << std::endl;
 	std::cout << std::endl;
 	
 	return 0;
@@ -0,0 +1,75 @@
+/*
+	i2c_timing_test.cpp - Tests the compile-time I2C timing calculation.
+
+	Revision 0.
+
+*/
+
+
+
+#include "../core/include/i2c_timing.h"
+
+
+#include <iostream>
+#include <iomanip>
+
+
+// The timing has to be resolvable at compile time.
+static_assert(I2C_timing::timingr(48000000, 400000) != 0, "No compile-time I2C timing.");
+static_assert(I2C_timing::ccr(36000000, 100000) != 0, "No compile-time I2C CCR.");
+
+
+const uint32_t clocks[] = { 4000000, 8000000, 16000000, 36000000, 48000000, 54000000, 80000000,
+							216000000 };
+const uint32_t frequencies[] = { 100000, 400000, 1000000 };
+
+
+int failures = 0;
+
+
+void check(const char* name, uint32_t actual, uint32_t expected) {
+	if (actual == expected) {
+		std::cout << "OK:  \t" << name << std::endl;
+	}
+	else {
+		std::cout << "FAIL:\t" << name << "\t0x" << std::hex << actual << " != 0x" << expected 
+					<< std::dec << std::endl;
+		failures++;
+	}
+}
+
+
+int main() {
+	std::cout << "Running I2C timing test..." << std::endl;
+
+	// 8 MHz, 100 kHz: PRESC 0, SCLDEL 2, SDADEL 0, SCLH 34, SCLL 40.
+	check("TIMINGR 8 MHz SM", I2C_timing::timingr(8000000, 100000), 0x00202228);
+	check("TIMINGR 4 MHz FM+", I2C_timing::timingr(4000000, 1000000), 0);
+	check("CCR 8 MHz SM", I2C_timing::ccr(8000000, 100000), 40);
+	check("CCR 8 MHz FM+", I2C_timing::ccr(8000000, 1000000), 0);
+	check("TRISE 36 MHz SM", I2C_timing::trise(36000000, 100000), 37);
+	check("TRISE 36 MHz FM", I2C_timing::trise(36000000, 400000), 11);
+
+	// The SCL frequency may not exceed the target, and should be within 1% of it.
+	for (uint32_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); ++i) {
+		for (uint32_t j = 0; j < sizeof(frequencies) / sizeof(frequencies[0]); ++j) {
+			uint32_t clock = clocks[i];
+			uint32_t target = frequencies[j];
+			uint32_t timing = I2C_timing::timingr(clock, target);
+			if (timing == 0) { continue; }
+			
+			uint32_t freq = I2C_timing::frequency(clock, timing);
+			std::cout << std::setw(10) << clock << std::setw(8) << target << "\t0x" << std::hex
+						<< std::setw(8) << std::setfill('0') << timing << std::dec << std::setfill(' ')
+						<< std::setw(8) << freq << std::endl;
+			if (freq > target || freq < target - target / 100) {
+				std::cout << "FAIL:\tSCL frequency out of range." << std::endl;
+				failures++;
+			}
+		}
+	}
+
+	std::cout << std::endl << failures << " failures." << std::endl;
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*
+	pin_test.cpp - Tests the compile-time Pin types.
+
+	Revision 0.
+
+*/
+
+
+
+#include "../core/include/gpio_pin.h"
+
+
+#include <iostream>
+#include <iomanip>
+#include <bitset>
+
+
+typedef Pin<GPIO_PORT_B, 3> Led;
+typedef Pin<GPIO_PORT_A, 0> Button;
+
+
+int failures = 0;
+
+
+void check(const char* name, uint32_t actual, uint32_t expected) {
+	if (actual == expected) {
+		std::cout << "OK:  \t" << name << std::endl;
+	}
+	else {
+		std::cout << "FAIL:\t" << name << "\t" << std::bitset<32>(actual) << " != "
+					<< std::bitset<32>(expected) << std::endl;
+		failures++;
+	}
+}
+
+
+int main() {
+	std::cout << "Running Pin test..." << std::endl;
+
+	check("Led regs", (uintptr_t) Led::regs(), (uintptr_t) GPIOB);
+	check("Led mask", Led::mask, 0x8);
+
+	if (!Led::output()) { std::cout << "Set output failed." << std::endl; return 1; }
+	if (!Button::input(GPIO_PULL_UP)) { std::cout << "Set input failed." << std::endl; return 1; }
+
+#ifdef STM32F1
+	check("Led CRL", GPIOB->CRL & (0xF << 12), 0x2 << 12);
+	check("Button CRL", GPIOA->CRL & 0xF, 0x8);
+#else
+	check("Led MODER", GPIOB->MODER & (0x3 << 6), 0x1 << 6);
+	check("Button MODER", GPIOA->MODER & 0x3, 0x0);
+	check("Button PUPDR", GPIOA->PUPDR & 0x3, 0x1);
+#endif
+
+	Led::set();
+	check("Led set", GPIOB->BSRR, 0x8);
+	Led::clear();
+	check("Led clear", GPIOB->BSRR, 0x8 << 16);
+	Led::write(true);
+	check("Led write", GPIOB->BSRR, 0x8);
+
+	// The mock has no hardware behind BSRR, so update ODR by hand for the toggle.
+	GPIOB->ODR = 0x8;
+	Led::toggle();
+	check("Led toggle high", GPIOB->BSRR, 0x8 << 16);
+	GPIOB->ODR = 0x0;
+	Led::toggle();
+	check("Led toggle low", GPIOB->BSRR, 0x8);
+
+	GPIOA->IDR = 0x1;
+	check("Button read high", Button::read(), 1);
+	GPIOA->IDR = 0x0;
+	check("Button read low", Button::read(), 0);
+
+	std::cout << std::endl << failures << " failures." << std::endl;
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/*
+	spi_bench.cpp - Compares register accesses & shifter use of the polled SPI transfers.
+	
+	Revision 0.
+	
+	Runs SPI::transceiveData() and the previous lockstep loop against the SPI model in the mock
+	header, which loops the transmitted data back into the receiver.
+
+*/
+
+
+
+#include "../core/include/spi.h"
+
+
+#include <iostream>
+
+
+const uint16_t count = 256;
+uint32_t sysTickCalls = 0;
+
+
+uint32_t McuCore::getSysTick() {
+	sysTickCalls++;
+	return 0;
+}
+
+
+// The previous implementation of SPI::transceiveData(), with one byte in flight.
+bool lockstepTransceive(SPI_TypeDef* regs, uint8_t* txdata, uint16_t txcount,
+											uint8_t* rxdata, uint16_t rxcount) {
+	bool txallowed = true;
+	uint32_t ts = McuCore::getSysTick();
+	uint32_t timeout = 400;
+	while (txcount > 0 && rxcount > 0) {
+		if (((regs->SR & SPI_SR_TXE) == SPI_SR_TXE) && txallowed) {
+			if (txcount > 0) {
+				regs->DR = *txdata++;
+				txallowed = false;
+				txcount--;
+			}
+			else {
+				regs->DR = 0x00;
+			}
+		}
+		
+		if (((regs->SR & SPI_SR_RXNE) == SPI_SR_RXNE) && rxcount > 0) {
+			*rxdata++ = (uint8_t) regs->DR;
+			txallowed = true;
+			rxcount--;
+		}
+		
+		if (((McuCore::getSysTick() - ts) > timeout) || timeout == 0) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
+void report(const char* name, uint16_t received) {
+	double ideal = (double) SpiModel::frames * SpiModel::frameTime;
+	std::cout << name << std::endl;
+	std::cout << "  Bytes received:\t" << received << " / " << count << std::endl;
+	std::cout << "  SR/DR reads per byte:\t" << (double) SpiModel::reads / count << std::endl;
+	std::cout << "  SR/DR writes per byte:\t" << (double) SpiModel::writes / count << std::endl;
+	std::cout << "  SysTick reads per byte:\t" << (double) sysTickCalls / count << std::endl;
+	std::cout << "  Shifter utilisation:\t" << (SpiModel::time ? 100.0 * ideal / SpiModel::time : 0)
+				<< " %" << std::endl;
+	std::cout << "  Overruns:\t\t" << SpiModel::overruns << std::endl;
+}
+
+
+// Counts the leading bytes received intact.
+uint16_t verify(uint8_t* tx, uint8_t* rx) {
+	uint16_t i = 0;
+	while (i < count && rx[i] == tx[i]) { i++; }
+	
+	return i;
+}
+
+
+int main() {
+	std::cout << "Running polled SPI transfer benchmark..." << std::endl;
+	
+	uint8_t tx[count];
+	uint8_t rx[count];
+	for (uint16_t i = 0; i < count; ++i) { tx[i] = (uint8_t) (i * 7 + 1); }
+	
+	// Lockstep loop.
+	SpiModel::reset();
+	sysTickCalls = 0;
+	for (uint16_t i = 0; i < count; ++i) { rx[i] = 0; }
+	lockstepTransceive(SPI1, tx, count, rx, count);
+	report("Lockstep:", verify(tx, rx));
+	
+	// Pipelined transfer.
+	SpiModel::reset();
+	sysTickCalls = 0;
+	for (uint16_t i = 0; i < count; ++i) { rx[i] = 0; }
+	bool ok = SPI::transceiveData(SPI_1, tx, count, rx, count);
+	uint16_t received = verify(tx, rx);
+	report("Pipelined:", received);
+	
+	if (!ok || received != count || SpiModel::overruns != 0) {
+		std::cout << "Pipelined transfer failed." << std::endl;
+		return 1;
+	}
+	
+	return 0;
+}
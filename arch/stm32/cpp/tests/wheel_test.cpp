@@ -0,0 +1,228 @@
+/*
+	wheel_test.cpp - Tests the software timer wheel.
+
+	Revision 0.
+
+*/
+
+
+
+#include "../core/include/timer_wheel.h"
+#include "../core/include/core.h"
+
+
+#include <iostream>
+#include <cstdlib>
+
+
+// --- CORE MOCK ---
+// The tick count is set by the test. The last requested tick is recorded for the tickless test.
+uint32_t now = 0xFFFF0000;	// Wraps during the test.
+uint32_t requested = 0;
+bool requestedSet = false;
+uint32_t idled = 0;
+
+
+bool McuCore::initSysTick(uint32_t tickPriority) { return true; }
+uint32_t McuCore::getSysTick() { return now; }
+void McuCore::setTickCallback(void (*cb)()) { }
+void McuCore::idle() { idled++; }
+
+void McuCore::requestTick(uint32_t tick) {
+	if (!requestedSet || (int32_t) (tick - requested) < 0 || (int32_t) (now - requested) >= 0) {
+		requested = tick;
+		requestedSet = true;
+	}
+}
+
+
+int failures = 0;
+
+
+void check(const char* name, uint32_t actual, uint32_t expected) {
+	if (actual == expected) {
+		std::cout << "OK:  \t" << name << std::endl;
+	}
+	else {
+		std::cout << "FAIL:\t" << name << "\t" << actual << " != " << expected << std::endl;
+		failures++;
+	}
+}
+
+
+struct Record {
+	uint32_t expires;		// Next expected tick.
+	uint32_t period;
+	uint32_t calls = 0;
+	uint32_t late = 0;		// Calls not at the expected tick.
+	uint32_t handle = 0;
+	uint32_t cancelAfter = 0;	// Cancel itself after this many calls, if not 0.
+};
+
+uint32_t masked = 0;	// Callbacks run with interrupts disabled.
+
+
+void callback(void* arg) {
+	Record &r = *((Record*) arg);
+	if (now != r.expires) { r.late++; }
+	if (mockPrimask != 0) { masked++; }
+
+	r.calls++;
+	r.expires += r.period;
+	if (r.cancelAfter != 0 && r.calls == r.cancelAfter) { TimerWheel::cancel(r.handle); }
+}
+
+
+bool start(Record &r, uint32_t ms, bool periodic) {
+	r.expires = now + ms;
+	r.period = periodic ? ms : 0;
+	return TimerWheel::start(ms, callback, periodic, r.handle, &r);
+}
+
+
+void runTicks(uint32_t ticks) {
+	for (uint32_t i = 0; i < ticks; i++) {
+		now++;
+		TimerWheel::run();
+	}
+}
+
+
+int main() {
+	std::cout << "Running timer wheel test..." << std::endl;
+
+	check("init", TimerWheel::init(), true);
+
+	// One-shot timers on each level and its boundaries, run every tick.
+	const uint32_t delays[] = { 0, 1, 2, 63, 64, 65, 127, 4095, 4096, 4097, 100000, 262143, 262144,
+								300000 };
+	const uint32_t count = sizeof(delays) / sizeof(delays[0]);
+	Record once[count];
+	for (uint32_t i = 0; i < count; i++) { start(once[i], delays[i], false); }
+
+	TimerWheel::run();
+	runTicks(300000);
+	uint32_t calls = 0, late = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		calls += once[i].calls;
+		late += once[i].late;
+	}
+
+	check("one-shot calls", calls, count);
+	check("one-shot late", late, 0);
+	check("one-shot inactive", TimerWheel::active(once[0].handle), false);
+	check("interrupts enabled in callback", masked, 0);
+	check("interrupts restored", mockPrimask, 0);
+
+	// Periodic timer, cancelled from its own callback.
+	Record periodic;
+	periodic.cancelAfter = 100;
+	start(periodic, 10, true);
+	check("periodic active", TimerWheel::active(periodic.handle), true);
+	runTicks(2000);
+	check("periodic calls", periodic.calls, 100);
+	check("periodic late", periodic.late, 0);
+	check("periodic cancelled", TimerWheel::active(periodic.handle), false);
+
+	// Cancel & stale handles.
+	Record cancelled;
+	start(cancelled, 50, false);
+	runTicks(20);
+	check("remaining", TimerWheel::remaining(cancelled.handle), 30);
+	check("cancel", TimerWheel::cancel(cancelled.handle), true);
+	check("cancel twice", TimerWheel::cancel(cancelled.handle), false);
+	Record reuse;
+	start(reuse, 5, false);
+	check("stale handle", TimerWheel::cancel(cancelled.handle), false);
+	runTicks(100);
+	check("cancelled calls", cancelled.calls, 0);
+	check("reused calls", reuse.calls, 1);
+
+	// Idle doesn't sleep with a timer due.
+	Record due;
+	start(due, 5, false);
+	now += 5;
+	TimerWheel::idle();
+	check("idle with timer due", idled, 0);
+	TimerWheel::run();
+	TimerWheel::idle();
+	check("idle", idled, 1);
+	check("idle interrupts enabled", mockPrimask, 0);
+	__disable_irq();
+	TimerWheel::idle();
+	check("idle keeps interrupts disabled", mockPrimask, 1);
+	__enable_irq();
+	check("due calls", due.calls, 1);
+
+	// Pool exhaustion.
+	Record pool[NODATE_WHEEL_TIMERS];
+	uint32_t started = 0;
+	for (uint32_t i = 0; i < NODATE_WHEEL_TIMERS; i++) {
+		if (start(pool[i], 1000 + i, false)) { started++; }
+	}
+
+	Record extra;
+	check("pool started", started, NODATE_WHEEL_TIMERS);
+	check("pool exhausted", start(extra, 10, false), false);
+	for (uint32_t i = 0; i < NODATE_WHEEL_TIMERS; i++) { TimerWheel::cancel(pool[i].handle); }
+	check("pool free", start(extra, 10, false), true);
+	runTicks(10);
+	check("pool extra calls", extra.calls, 1);
+
+	// Random timers with random cancels, run every tick.
+	srand(1);
+	Record random[NODATE_WHEEL_TIMERS];
+	for (uint32_t i = 0; i < NODATE_WHEEL_TIMERS; i++) {
+		bool periodic = (rand() % 4) == 0;
+		start(random[i], periodic ? 1 + rand() % 500 : rand() % 70000, periodic);
+	}
+
+	for (uint32_t t = 0; t < 70000; t++) {
+		uint32_t i = rand() % NODATE_WHEEL_TIMERS;
+		if ((rand() % 100) == 0 && TimerWheel::active(random[i].handle)) {
+			TimerWheel::cancel(random[i].handle);
+		}
+
+		runTicks(1);
+	}
+
+	late = 0;
+	for (uint32_t i = 0; i < NODATE_WHEEL_TIMERS; i++) {
+		late += random[i].late;
+		TimerWheel::cancel(random[i].handle);
+	}
+
+	check("random late", late, 0);
+
+	// Tickless: only run at the requested ticks, including a delay beyond the wheel's range.
+	const uint32_t far[] = { 3, 70, 5000, 300000, 20000000, 40000000 };
+	const uint32_t farCount = sizeof(far) / sizeof(far[0]);
+	Record sleepy[farCount];
+	for (uint32_t i = 0; i < farCount; i++) { start(sleepy[i], far[i], false); }
+
+	uint32_t wakes = 0;
+	while (requestedSet && (int32_t) (requested - now) > 0 && wakes < 1000) {
+		now = requested;
+		wakes++;
+		TimerWheel::run();
+	}
+
+	calls = 0;
+	late = 0;
+	for (uint32_t i = 0; i < farCount; i++) {
+		calls += sleepy[i].calls;
+		late += sleepy[i].late;
+	}
+
+	check("tickless calls", calls, farCount);
+	check("tickless late", late, 0);
+	std::cout << "Tickless wake-ups: " << wakes << std::endl;
+	if (wakes > 30) {
+		std::cout << "FAIL:\ttickless wake-ups" << std::endl;
+		failures++;
+	}
+
+	std::cout << std::endl << failures << " failures." << std::endl;
+
+	return failures == 0 ? 0 : 1;
+}
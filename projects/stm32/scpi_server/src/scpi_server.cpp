@@ -20,9 +20,12 @@ extern "C" {
 }
 
 
+uint8_t uartTxBuffer[256];
+
+
 void uartCallback(char ch) {
-	// Copy character into send buffer.
-	USART::sendUart(USART_3, ch);
+	// Copy character into send buffer. Called from the USART interrupt, so don't block.
+	USART::write(USART_3, &ch, 1);
 }
 
 //static void startThread(void const* argument);
@@ -41,6 +44,9 @@ int main() {
 	// USART3, (TX) PD8:7, (RX) PD9:7.
 	USART::startUart(USART_3, GPIO_PORT_D, 8, 7, GPIO_PORT_D, 9, 7, 9600, uartCallback);
 	
+	// Send output from the TX buffer via interrupts, so that logging does not block.
+	USART::setTxBuffer(USART_3, uartTxBuffer, sizeof(uartTxBuffer));
+	
 	// Set up stdout.
 	IO::setStdOutTarget(USART_3);
 	